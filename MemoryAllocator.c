@@ -4,6 +4,21 @@
 #include <stdlib.h>
 #include <math.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#endif
+
 #define BASE_ALIGN 8
 #define BASE_BUCKET 32
 
@@ -11,36 +26,277 @@
 #define MEM_MAX_SIZE ( 0x1 << 20 ) * 500 // 500 mb
 #endif
 
+#ifndef MEM_MIN_SIZE
+#define MEM_MIN_SIZE ( 0x1 << 16 ) // every partition gets at least a few bins
+#endif
+
+#ifndef MEM_COMMIT_SIZE
+#define MEM_COMMIT_SIZE ( 0x1 << 20 ) // partitions are committed in steps of this size
+#endif
+
+#define HUGE_PAGE_SIZE ( 0x1 << 21 ) // 2 mb
+
+#ifndef HEAP_LARGE_THRESHOLD
+#define HEAP_LARGE_THRESHOLD ( 0x1 << 16 ) // default size where requests stop using level 5 runs
+#endif
+
+#ifndef HEAP_LARGE_CACHE_SIZE
+#define HEAP_LARGE_CACHE_SIZE ( 0x1 << 26 ) // released large regions kept mapped per heap ( 64 mb )
+#endif
+
+#ifndef HEAP_SEGMENT_SIZE
+#define HEAP_SEGMENT_SIZE ( 0x1 << 25 ) // growth segments are this size && aligned to it ( 32 mb )
+#endif
+
+#ifndef HEAP_PURGE_MIN_SIZE
+#define HEAP_PURGE_MIN_SIZE ( 0x1 << 16 ) // smaller free extents keep their pages
+#endif
+
+#ifndef HEAP_LOCK_SPINS
+#define HEAP_LOCK_SPINS 256 // pauses before a waiting thread gives up its time slice
+#endif
+
+#ifndef HEAP_PURGE_DECAY
+#define HEAP_PURGE_DECAY 10000 // default ms before idle free extents get purged
+#endif
+
+#define HEAP_PURGE_INTERVAL 256 // tracker releases between reads of the clock
+#define HEAP_PURGE_BATCH    64  // free extents a decay purge visits per HEAP_PURGE_INTERVAL releases
+
+#ifndef HEAP_TRACE_BUFFER
+#define HEAP_TRACE_BUFFER 4096 // trace records written out at once
+#endif
+
+#ifdef HEAP_TRACE
+#define TRACE_RECORD( OP, DATA_PTR, BYTE_SIZE, EXTRA, THREAD_ID, HINTS, BLOCK_SIZE ) TraceRecord( OP, DATA_PTR, BYTE_SIZE, EXTRA, THREAD_ID, HINTS, BLOCK_SIZE )
+#else
+#define TRACE_RECORD( OP, DATA_PTR, BYTE_SIZE, EXTRA, THREAD_ID, HINTS, BLOCK_SIZE ) ( (void)0 )
+#endif // HEAP_TRACE
+
 #define SET_INDEX_PART( INDEX, PARTITION ) ( ( INDEX ) << k_HeapBlockIndexBitShift ) | PARTITION
 
 #define EXTRACT_IDX( BLOCK_IDX_PARTION ) ( BLOCK_IDX_PARTION >> k_HeapBlockIndexBitShift )
 
 #define EXTRACT_PART( BLOCK_IDX_PARTION ) ( BLOCK_IDX_PARTION & k_HeapBlockPartitionMask )
 
+#define INDEX_NONE 0xffffffff // empty link/head in the free extent index
+
 //static void*              s_MemBlockPtr;
 //static Heap::FreeList s_FreeList;
 
 struct MemoryData
 {
   void*               m_MemBlock;
+  uint64_t            m_MemSize;
   struct HeapFreeList m_FreeList;
+  bool                m_Valid;
+
+  void*               m_RemoteFrees; // lock-free stack of blocks released by other threads
+  uint32_t            m_NextThreadId; // link in the lists of heaps left by exited threads
+};
+
+// Front of every growth segment, followed by the tracker slice && the bins. Segments are aligned
+// to HEAP_SEGMENT_SIZE so a block can find it by masking its address
+struct HeapSegment
+{
+  struct MemoryData* m_Owner;
+  uint32_t           m_PartIdx;
 };
 
-#define MAX_MEM_THREADS 8
-static struct MemoryData s_MemoryDataThreads[MAX_MEM_THREADS];
-static bool              s_MemoryDataThreadValidFlag[MAX_MEM_THREADS];
+#define SEGMENT_HEADER_SIZE 64
 
-static struct HeapPartitionData GetPartition( const uint64_t total_size, uint16_t bin_size, float percentage );
+#if defined( __cplusplus )
+  #define HEAP_THREAD_LOCAL thread_local
+#elif defined( _MSC_VER )
+  #define HEAP_THREAD_LOCAL __declspec( thread )
+#else
+  #define HEAP_THREAD_LOCAL __thread
+#endif
+
+// Heaps are registered by thread id in lazily created chunks, so ids never move once handed out.
+// Ids below MAX_MEM_THREADS are left for callers that route heaps by hand, threads bound w/
+// k_HeapThreadAuto get the ids above
+#ifndef MAX_MEM_THREADS
+  #define MAX_MEM_THREADS 8
+#endif
+
+#ifndef HEAP_REGISTRY_CHUNK_SIZE
+  #define HEAP_REGISTRY_CHUNK_SIZE 64
+#endif
+#ifndef HEAP_REGISTRY_MAX_CHUNKS
+  #define HEAP_REGISTRY_MAX_CHUNKS 1024
+#endif
+
+// Base blocks start on a granule, so each granule of the address space belongs to at most one heap.
+// Granules map to their heap through lazily created leaves ( 48 bit addresses )
+#define OWNER_GRANULE_BITS 24 // 16 mb
+#define OWNER_LEAF_BITS    12
+#define OWNER_ROOT_SIZE    ( 0x1 << ( 48 - OWNER_GRANULE_BITS - OWNER_LEAF_BITS ) )
+
+static struct MemoryData* s_MemoryDataChunks[HEAP_REGISTRY_MAX_CHUNKS];
+static struct MemoryData** s_OwnerLeaves[OWNER_ROOT_SIZE];
+static uint32_t           s_NextAutoThreadId = MAX_MEM_THREADS;
+static uint64_t           s_AutoInitSize     = 0;
+static uint32_t           s_AutoInitFlags    = k_HeapInitNone;
+static struct HeapConfig  s_AutoInitConfig;
+static bool               s_AutoInitCustom   = false;
+
+// Ids of exited threads. Released heaps are re-initialized by the next thread, adopted ones still hold
+// blocks && are taken over as is
+static struct HeapLock s_ThreadIdLock;
+static uint32_t        s_ReleasedThreadIds = k_HeapThreadAuto;
+static uint32_t        s_AdoptedThreadIds  = k_HeapThreadAuto;
+
+#ifdef _WIN32
+static DWORD     s_ThreadExitKey  = FLS_OUT_OF_INDEXES;
+static INIT_ONCE s_ThreadExitOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_key_t  s_ThreadExitKey;
+static pthread_once_t s_ThreadExitOnce = PTHREAD_ONCE_INIT;
+#endif
+
+static HEAP_THREAD_LOCAL uint32_t s_BoundThreadId = k_HeapThreadAuto;
+
+#ifdef HEAP_TRACE
+// Records of every heap go through one buffer, s_TraceFile is only set while tracing
+static FILE*                  s_TraceFile;
+static struct HeapLock        s_TraceLock;
+static uint64_t               s_TraceStartNs;
+static uint32_t               s_TraceCount;
+static struct HeapTraceRecord s_TraceBuffer[HEAP_TRACE_BUFFER];
+
+static void TraceRecord( uint8_t op, const void* data_ptr, uint64_t byte_size, uint64_t extra, uint32_t thread_id, uint32_t hints, uint8_t block_size );
+static void TraceFlush( FILE* trace_file );
+static uint64_t GetTimeNs();
+#endif // HEAP_TRACE
+
+static struct MemoryData* FindMemoryData( uint32_t thread_id );
+static struct MemoryData* GetMemoryData( uint32_t thread_id );
+static uint32_t           ResolveThreadId( uint32_t thread_id );
+static uint32_t           BindThread( bool adopt );
+static void               UnbindThread( uint32_t thread_id );
+static void               RegisterThreadExit( uint32_t thread_id );
+static void               ReleaseHeap( struct MemoryData* mem_data );
+static struct MemoryData* FindOwner( const void* data_ptr );
+static void               MapOwner( const void* range_ptr, uint64_t range_size, struct MemoryData* owner );
+static bool               OwnsPointer( const struct MemoryData* mem_data, const void* data_ptr );
+
+// Heap... entry points w/o the trace records, for the ones built on top of each other
+static void*    Allocate( uint64_t byte_size, uint32_t bucket_hints, uint8_t block_size, uint64_t debug_hash, uint32_t thread_id );
+static void*    AllocateAligned( uint64_t byte_size, uint32_t alignment, uint64_t debug_hash, uint32_t thread_id );
+static bool     Release( void* data_ptr, uint32_t thread_id );
+static uint32_t AllocateBatch( uint64_t byte_size, uint32_t count, void* out_ptrs[], uint32_t thread_id );
+
+static void  ReleaseLocal( struct HeapFreeList* free_list, void* data_ptr );
+static void  ReleaseBlock( struct HeapFreeList* free_list, void* data_ptr );
+static void* UnshiftBlock( struct HeapFreeList* free_list, void* data_ptr );
+static int   CompareBlocks( const void* lhs, const void* rhs );
+static bool ResizeInPlace( struct HeapFreeList* free_list, void* data_ptr, uint64_t byte_size );
+static bool ResizeRun( struct HeapFreeList* free_list, void* data_ptr, uint64_t aligned_alloc );
+
+static unsigned char* GetBlockStart( struct HeapFreeList* free_list, const struct HeapBlockHeader* header );
+static unsigned char* GetBlockEnd( struct HeapFreeList* free_list, const struct HeapBlockHeader* header );
+
+static struct MemoryData* FindBlockOwner( struct MemoryData* mem_data, void* data_ptr );
+
+static bool     InitPartition( struct HeapFreeList* free_list, uint32_t part_idx, struct HeapBlockHeader* tracker_slice );
+static uint64_t* InitSlab( struct HeapFreeList* free_list, uint32_t level_idx, uint64_t* slab_words );
+static uint64_t LevelFindFit( struct HeapFreeList* free_list, uint32_t level_idx, uint64_t bin_count, uint32_t* part_idx );
+static bool     AddSegment( struct MemoryData* mem_data, uint32_t level_idx, uint64_t bin_count );
+static void     ReleaseSegment( struct HeapFreeList* free_list, uint32_t part_idx );
+static void     TrimSegments( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t keep_empty );
+
+static uint32_t FindSlabLevel( const struct HeapFreeList* free_list, const void* data_ptr );
+static void*    SlabAllocate( struct HeapFreeList* free_list, uint32_t level_idx );
+static void     SlabRelease( struct HeapFreeList* free_list, uint32_t level_idx, void* data_ptr );
+
+static bool                   IsLargeBlock( const void* data_ptr );
+static struct HeapLargeBlock* GetLargeBlock( void* data_ptr );
+static void*                  LargeAllocate( struct MemoryData* mem_data, uint64_t byte_size, uint32_t alignment, uint64_t debug_hash );
+static void                   LargeRelease( struct HeapFreeList* free_list, struct HeapLargeBlock* large );
+static void                   LargeCacheTrim( struct HeapLargeList* large_list, uint32_t max_count, uint64_t max_size );
+static void PushRemoteFree( struct MemoryData* owner, void* data_ptr );
+static void DrainRemoteFrees( struct MemoryData* mem_data );
+
+static uint32_t AtomicFetchAdd32( uint32_t* value, uint32_t add );
+static void*    AtomicLoadPtr( void** ptr );
+static bool     AtomicCasPtr( void** ptr, void* expected, void* desired );
+static void*    AtomicExchangePtr( void** ptr, void* desired );
+static uint32_t AtomicLoad32( uint32_t* value );
+static void     AtomicStore32( uint32_t* value, uint32_t desired );
+static void     CpuPause();
+static void     ThreadYield();
+
+static void TicketAcquire( struct HeapLock* lock );
+static void TicketRelease( struct HeapLock* lock );
+static void LockAcquire( struct HeapFreeList* free_list, struct HeapLock* lock );
+static void LockRelease( struct HeapFreeList* free_list, struct HeapLock* lock );
+
+static struct HeapPartitionData GetPartition( const uint64_t total_size, uint32_t bin_size, float percentage );
 static uint64_t CalcAllignedAllocSize( uint64_t input, uint32_t alignment );
 
-static const uint32_t s_BlockHeaderSize = (uint32_t)sizeof( struct HeapBlockHeader );
+static uint32_t SelectLevel( const struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t bucket_hint );
+static uint32_t LevelSize( const struct HeapFreeList* free_list, uint32_t level_idx );
+static uint32_t DefaultLevelSize( uint32_t level_idx );
+static uint32_t DefaultLevelShare( uint32_t level_idx );
+static uint32_t LevelCacheHighWater( uint32_t level_size );
+static uint64_t CalcBinCount( const struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t level_idx );
+
+static void*                  AllocateAtLevel( struct MemoryData* mem_data, uint64_t aligned_alloc, uint32_t level_idx, uint32_t bucket_hints, uint64_t debug_hash );
+static void*                  AllocateFromLevel( struct MemoryData* mem_data, uint64_t aligned_alloc, uint32_t level_idx, uint32_t bucket_hints, uint64_t debug_hash );
+static struct HeapQueryResult QueryLevel( struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t level_idx );
+
+static void  ReleaseToTracker( struct HeapFreeList* free_list, void* data_ptr );
+static void* CacheRefill( struct HeapFreeList* free_list, uint32_t level_idx );
+static void  CacheFlush( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t flush_count );
+
+static uint64_t FindTrackerSlot( const struct HeapBlockHeader tracker_data[], uint64_t tracked_count, uint64_t block_idx );
+
+static struct HeapFreeNode* GetFreeNode( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+static void     IndexMapping( uint64_t bin_count, uint32_t* fl_idx, uint32_t* sl_idx );
+static void     IndexInsert( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t bin_count, const struct HeapFreeNode* state );
+static const struct HeapFreeNode* LargestFreePart( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t left_idx, uint64_t left_bins, uint64_t right_idx, uint64_t right_bins, uint64_t slot_bins );
+static void     IndexRemove( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+static uint64_t IndexFindFit( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t bin_count );
 
-static uint16_t s_HeapBinSizes[k_HeapNumLvl] = { k_HeapLevel0,
-                                                 k_HeapLevel1,
-                                                 k_HeapLevel2,
-                                                 k_HeapLevel3,
-                                                 k_HeapLevel4,
-                                                 k_HeapLevel5 };
+static uint64_t TakeFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t selected_idx, uint64_t bin_count );
+static void     ReturnFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t bin_count );
+static void     ArrayReturnBlocks( struct HeapFreeList* free_list, uint32_t part_idx, void* blocks[], uint32_t block_count );
+static bool     NextFreeExtent( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t* cursor, uint64_t* block_idx, uint64_t* bin_count );
+static uint64_t SeekFreeExtent( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+
+static void     TreeInsert( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+static void     TreeRemove( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+static void     TreeReplace( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t old_idx, uint64_t new_idx );
+static void     TreeFindNeighbours( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t* left_idx, uint64_t* right_idx );
+static uint64_t TreeFirst( struct HeapFreeList* free_list, uint32_t part_idx );
+static uint64_t TreeNext( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx );
+
+static uint32_t BitScanLow32( uint32_t mask );
+static uint32_t BitScanLow64( uint64_t mask );
+static uint32_t BitScanHigh64( uint64_t mask );
+
+static uint64_t GetPageSize();
+static void*    VirtualReserve( uint64_t size );
+static void*    VirtualReserveAligned( uint64_t size, uint64_t alignment );
+static void*    VirtualAllocate( uint64_t size );
+static bool     VirtualCommit( void* ptr, uint64_t size );
+static bool     VirtualCommitHuge( void* ptr, uint64_t size, uint32_t* backing );
+static void     VirtualRelease( void* ptr, uint64_t size );
+static bool     CommitPartition( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t end_offset );
+static void     VirtualPurge( void* ptr, uint64_t size );
+
+static uint32_t GetTickMs();
+
+static void     StatsAlloc( struct HeapPartitionStats* stats, uint64_t block_count, uint64_t byte_size );
+static void     StatsRelease( struct HeapPartitionStats* stats, uint64_t block_count, uint64_t byte_size );
+static void     StatsFailed( struct HeapPartitionStats* stats, uint32_t query_status );
+static uint64_t BlockBytes( const struct HeapFreeList* free_list, const void* data_ptr );
+static uint64_t IndexLargestBins( const struct HeapFreeList* free_list, uint32_t part_idx );
+static uint64_t PurgeExtents( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t min_age, uint32_t* budget );
+static void     PurgeOnRelease( struct HeapFreeList* free_list, uint32_t level_idx );
+
+static const uint32_t s_BlockHeaderSize = (uint32_t)sizeof( struct HeapBlockHeader );
 
 // Memory layout                 Gap ( due to aligned memory ) ___
 //                                |                              |
@@ -55,84 +311,241 @@ static uint16_t s_HeapBinSizes[k_HeapNumLvl] = { k_HeapLevel0,
 
 void HeapInitBase( uint64_t alloc_size, uint32_t thread_id )
 {
-  struct HeapFreeList* free_list = &s_MemoryDataThreads[thread_id].m_FreeList;
-  void*                mem_block = s_MemoryDataThreads[thread_id].m_MemBlock;
+  HeapInitBaseEx( alloc_size, k_HeapInitNone, thread_id );
+}
+
+void HeapInitBaseEx( uint64_t alloc_size, uint32_t init_flags, uint32_t thread_id )
+{
+  HeapInitBaseConfig( alloc_size, init_flags, NULL, thread_id );
+}
+
+void HeapInitBaseConfig( uint64_t alloc_size, uint32_t init_flags, const struct HeapConfig* config, uint32_t thread_id )
+{
+  const bool bind_thread = thread_id == k_HeapThreadAuto;
+  if( bind_thread )
+  {
+    // bind w/o the default init, the caller's settings are applied below. Adopted heaps aren't
+    // taken, re-init would drop the blocks they still hold
+    thread_id = s_BoundThreadId == k_HeapThreadAuto ? BindThread( false ) : s_BoundThreadId;
+    RegisterThreadExit( thread_id );
+  }
+
+  struct MemoryData*   mem_data  = GetMemoryData( thread_id );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  // re-init drops every block of the old heap, segments && large mappings included
+  ReleaseHeap( mem_data );
 
   memset( free_list, 0, sizeof( struct HeapFreeList ) );
+  free_list->m_InitFlags         = init_flags;
+  free_list->m_Large.m_Threshold = HEAP_LARGE_THRESHOLD;
+  free_list->m_PurgeDecay        = HEAP_PURGE_DECAY;
+  free_list->m_PurgeTick         = GetTickMs();
+  free_list->m_LastPurgeTick     = free_list->m_PurgeTick;
+  for( uint32_t ilvl = 0; ilvl < k_HeapNumLvl; ilvl++ )
+  {
+    free_list->m_LevelPurgeTicks[ilvl] = free_list->m_PurgeTick;
+    free_list->m_PurgeParts[ilvl]      = INDEX_NONE;
+  }
+
+  uint32_t level_shares[k_HeapNumLvl];
+  if( config )
+  {
+    ASSERT_F( config->m_LevelCount && config->m_LevelCount <= k_HeapNumLvl, "Invalid level count : %u", config->m_LevelCount );
+    ASSERT_F( config->m_LevelSizes[0] >= BASE_BUCKET, "Smallest level below %u B : %u", BASE_BUCKET, config->m_LevelSizes[0] );
+
+    free_list->m_LevelCount   = config->m_LevelCount;
+    free_list->m_CustomLevels = true;
+    for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+    {
+      ASSERT_F( config->m_LevelSizes[ilvl] % BASE_ALIGN == 0 && ( ilvl == 0 || config->m_LevelSizes[ilvl] > config->m_LevelSizes[ilvl - 1] ), "Invalid size for level %u : %u", ilvl, config->m_LevelSizes[ilvl] );
+
+      free_list->m_LevelSizes[ilvl] = config->m_LevelSizes[ilvl];
+      level_shares[ilvl]            = config->m_LevelShares[ilvl];
+    }
+  }
+  else
+  {
+    free_list->m_LevelCount = k_HeapNumLvl;
+    for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+    {
+      free_list->m_LevelSizes[ilvl] = DefaultLevelSize( ilvl );
+      level_shares[ilvl]            = DefaultLevelShare( ilvl );
+    }
+  }
+
+  const uint32_t level_count = free_list->m_LevelCount;
+  for( uint32_t ilvl = 0; ilvl < level_count; ilvl++ )
+  {
+    free_list->m_Cache[ilvl].m_HighWater = LevelCacheHighWater( free_list->m_LevelSizes[ilvl] );
+  }
   /*
-  o Partition scheme :
-  ===============================================================================
-  |  k_Level0  |  k_Level1  |  k_Level2  |  k_Level3  |  k_Level4  |  k_Level5  |
-  |     5%     |    10%     |    15%     |    20%     |    25%     |    25%     |
-  ===============================================================================
+  o Partition scheme ( shares per power of two, split evenly between the classes of that range ) :
+  =======================================================================================
+  |   32 B   |  <= 64 B  |  <= 128 B  |  <= 256 B  |  <= 512 B  |  <= 1 kb  | ... <= max |
+  |    5     |    10     |     15     |     20     |     25     |    25    |  ...  25   |
+  =======================================================================================
   */
 
   alloc_size = alloc_size == 0 ? MEM_MAX_SIZE : alloc_size;
+  alloc_size = alloc_size < MEM_MIN_SIZE ? MEM_MIN_SIZE : alloc_size;
   
   // calculate partition stats per memory level
-  free_list->m_PartitionLvlDetails[0] = GetPartition( MEM_MAX_SIZE, k_HeapLevel0, 0.05f );
-  free_list->m_PartitionLvlDetails[1] = GetPartition( MEM_MAX_SIZE, k_HeapLevel1, 0.10f );
-  free_list->m_PartitionLvlDetails[2] = GetPartition( MEM_MAX_SIZE, k_HeapLevel2, 0.15f );
-  free_list->m_PartitionLvlDetails[3] = GetPartition( MEM_MAX_SIZE, k_HeapLevel3, 0.20f );
-  free_list->m_PartitionLvlDetails[4] = GetPartition( MEM_MAX_SIZE, k_HeapLevel4, 0.25f );
-  free_list->m_PartitionLvlDetails[5] = GetPartition( MEM_MAX_SIZE, k_HeapLevel5, 0.25f );
+  uint32_t total_share = 0;
+  for( uint32_t ilvl = 0; ilvl < level_count; ilvl++ )
+  {
+    total_share += level_shares[ilvl];
+  }
+  ASSERT_F( total_share, "Every level has a zero share" );
+
+  for( uint32_t ilvl = 0; ilvl < level_count; ilvl++ )
+  {
+    free_list->m_PartitionLvlDetails[ilvl] = GetPartition( alloc_size, free_list->m_LevelSizes[ilvl], (float)level_shares[ilvl] / (float)total_share );
+  }
+
+  // slab levels need neither headers nor tracker entries, so their share holds more slots
+  uint32_t slab_lvls = 0;
+  while( ( init_flags & k_HeapInitSlab ) && slab_lvls < k_HeapSlabLvls && slab_lvls < level_count && free_list->m_LevelSizes[slab_lvls] <= k_HeapSlabMaxSize )
+  {
+    slab_lvls++;
+  }
+  free_list->m_SlabLvls = slab_lvls;
+
+  uint64_t slab_meta_size = 0;
+  for( uint32_t ilvl = 0; ilvl < slab_lvls; ilvl++ )
+  {
+    struct HeapPartitionData* part_data  = &free_list->m_PartitionLvlDetails[ilvl];
+    struct HeapSlabData*      slab       = &free_list->m_Slab[ilvl];
+    const uint64_t            part_share = part_data->m_BinCount * ( part_data->m_BinSize + s_BlockHeaderSize );
 
-  for(uint32_t ibin = 0; ibin < k_HeapNumLvl; ibin++)
+    part_data->m_BinSize  = free_list->m_LevelSizes[ilvl];
+    part_data->m_BinCount = part_share / part_data->m_BinSize;
+    part_data->m_Size     = part_data->m_BinCount * part_data->m_BinSize;
+
+    slab->m_RunCount     = ( part_data->m_BinCount + k_HeapSlabRunSlots - 1 ) / k_HeapSlabRunSlots;
+    slab->m_FreeRunWords = (uint32_t)( ( slab->m_RunCount + 63 ) / 64 );
+    slab_meta_size      += ( slab->m_RunCount * k_HeapSlabRunWords + slab->m_FreeRunWords ) * sizeof( uint64_t );
+  }
+
+  for(uint32_t ibin = 0; ibin < level_count; ibin++)
   {
+    ASSERT_F( free_list->m_PartitionLvlDetails[ibin].m_BinCount < INDEX_NONE, "Partition %u exceeds free index limit : %" PRIu64 " bins", ibin, free_list->m_PartitionLvlDetails[ibin].m_BinCount );
+
     free_list->m_TotalPartitionSize += free_list->m_PartitionLvlDetails[ibin].m_Size;
-    free_list->m_TotalPartitionBins += free_list->m_PartitionLvlDetails[ibin].m_BinCount;
+    free_list->m_TotalPartitionBins += ibin < slab_lvls ? 0 : free_list->m_PartitionLvlDetails[ibin].m_BinCount;
   }
   uint64_t tracker_list_size = s_BlockHeaderSize * free_list->m_TotalPartitionBins;
+  uint64_t meta_size         = tracker_list_size + slab_meta_size;
 
-  // get heap memory from system for free list && partitions
-  ASSERT_F( CalcAllignedAllocSize( tracker_list_size + free_list->m_TotalPartitionSize, BASE_ALIGN ) < (uint32_t)-1, 
-            "Memory to alloc exceeds limit : %zu\n",
-            (uint32_t)-1 );
-  
-  mem_block = calloc( CalcAllignedAllocSize( tracker_list_size + free_list->m_TotalPartitionSize, BASE_ALIGN ), sizeof( unsigned char ) );
-  
-  ASSERT_F( mem_block, "Failed to initialize memory" );
+  // huge pages need every partition to start && end on a huge page boundary. Slab slots are aligned
+  // to their size, which takes partitions aligned to the largest slab slot
+  const uint32_t part_align = init_flags & k_HeapInitHugePages ? HUGE_PAGE_SIZE : ( slab_lvls ? k_HeapSlabMaxSize : BASE_ALIGN );
+  uint64_t       heap_size  = CalcAllignedAllocSize( meta_size, part_align ) + ( part_align == BASE_ALIGN ? 0 : part_align );
+
+  for(uint32_t ibin = 0; ibin < level_count; ibin++)
+  {
+    heap_size += CalcAllignedAllocSize( free_list->m_PartitionLvlDetails[ibin].m_Size, part_align );
+  }
+
+  // reserve address space for free list && partitions. Pages are committed as they're first used
+  // out of memory leaves the heap invalid, its allocations return NULL
+  void* mem_block = VirtualReserveAligned( heap_size, (uint64_t)1 << OWNER_GRANULE_BITS );
+  if( mem_block == NULL )
+  {
+    return;
+  }
+
+  mem_data->m_MemBlock    = mem_block;
+  mem_data->m_MemSize     = heap_size;
+  mem_data->m_RemoteFrees = NULL;
+  MapOwner( mem_block, heap_size, mem_data );
 
   // set addresses for memory tracker list & partitions
 
-  free_list->m_Tracker    = (struct HeapBlockHeader*)mem_block;
-  unsigned char* byte_ptr = (unsigned char*)mem_block;
+  unsigned char* byte_ptr = (unsigned char*)CalcAllignedAllocSize( (uintptr_t)mem_block, part_align );
+  free_list->m_Tracker    = (struct HeapBlockHeader*)byte_ptr;
+
+  // the tracker list is only used by the array tracker, slab bitmaps follow it
+  uint64_t*  slab_words = (uint64_t*)( byte_ptr + tracker_list_size );
+  const bool committed  = ( ( init_flags & k_HeapInitTreeTracker ) || VirtualCommit( byte_ptr, tracker_list_size ) ) && ( slab_meta_size == 0 || VirtualCommit( slab_words, slab_meta_size ) );
+  if( !committed )
+  {
+    ReleaseHeap( mem_data );
+    return;
+  }
   
-  free_list->m_PartitionLvls[0] = byte_ptr + tracker_list_size; // offset b/c tracker list is at front
-  free_list->m_PartitionLvls[1] = free_list->m_PartitionLvls[0] + free_list->m_PartitionLvlDetails[0].m_Size;
-  free_list->m_PartitionLvls[2] = free_list->m_PartitionLvls[1] + free_list->m_PartitionLvlDetails[1].m_Size;
-  free_list->m_PartitionLvls[3] = free_list->m_PartitionLvls[2] + free_list->m_PartitionLvlDetails[2].m_Size;
-  free_list->m_PartitionLvls[4] = free_list->m_PartitionLvls[3] + free_list->m_PartitionLvlDetails[3].m_Size;
-  free_list->m_PartitionLvls[5] = free_list->m_PartitionLvls[4] + free_list->m_PartitionLvlDetails[4].m_Size;
+  free_list->m_PartitionLvls[0] = byte_ptr + CalcAllignedAllocSize( meta_size, part_align ); // offset b/c tracker list is at front
+  for(uint32_t ibin = 1; ibin < level_count; ibin++)
+  {
+    free_list->m_PartitionLvls[ibin] = free_list->m_PartitionLvls[ibin - 1] + CalcAllignedAllocSize( free_list->m_PartitionLvlDetails[ibin - 1].m_Size, part_align );
+  }
   
-  ASSERT_F( ( free_list->m_PartitionLvls[5] + free_list->m_PartitionLvlDetails[5].m_Size ) == ( byte_ptr + tracker_list_size + free_list->m_TotalPartitionSize ), "Invalid buffer calculations {%p : %p}", free_list->m_PartitionLvls[5] + free_list->m_PartitionLvlDetails[5].m_Size, byte_ptr + tracker_list_size + free_list->m_TotalPartitionSize );
+  ASSERT_F( ( free_list->m_PartitionLvls[level_count - 1] + free_list->m_PartitionLvlDetails[level_count - 1].m_Size ) <= ( (unsigned char*)mem_block + heap_size ), "Invalid buffer calculations {%p : %p}", free_list->m_PartitionLvls[level_count - 1] + free_list->m_PartitionLvlDetails[level_count - 1].m_Size, (unsigned char*)mem_block + heap_size );
 
   // initialize tracker data for each memory partition
 
-  for( uint64_t ipart_idx = 0, tracker_offsets = 0; ipart_idx < k_HeapNumLvl; ipart_idx++)
+  for( uint64_t ipart_idx = 0, tracker_offsets = 0; ipart_idx < level_count; ipart_idx++)
   {
-    free_list->m_TrackerInfo[ipart_idx].m_HeadIdx      = 0;
-    free_list->m_TrackerInfo[ipart_idx].m_TrackedCount = 1;
+    free_list->m_PartitionLvlDetails[ipart_idx].m_Level = (uint32_t)ipart_idx;
+    free_list->m_TrackerInfo[ipart_idx].m_Backing       = init_flags & k_HeapInitHugePages ? 0 : k_HeapBackingPages;
 
-    struct HeapBlockHeader* mem_tag = &free_list->m_Tracker[tracker_offsets];
-    mem_tag->m_BHAllocCount         = free_list->m_PartitionLvlDetails[ipart_idx].m_BinCount;
-    mem_tag->m_BHIndexNPartition    = SET_INDEX_PART( 0, ipart_idx ); // partition index is encoded in lower 4 bits 
+    if( ipart_idx < slab_lvls )
+    {
+      slab_words = InitSlab( free_list, (uint32_t)ipart_idx, slab_words );
+      continue;
+    }
 
-    free_list->m_TrackerInfo[ipart_idx].m_BinOccupancy    = mem_tag->m_BHAllocCount; 
-    free_list->m_TrackerInfo[ipart_idx].m_PartitionOffset = tracker_offsets;
+    if( !InitPartition( free_list, (uint32_t)ipart_idx, free_list->m_Tracker + tracker_offsets ) )
+    {
+      ReleaseHeap( mem_data );
+      return;
+    }
 
     tracker_offsets += free_list->m_PartitionLvlDetails[ipart_idx].m_BinCount;
   }
 
-  s_MemoryDataThreadValidFlag[thread_id] = true;
+  mem_data->m_Valid = true;
 }
 
 bool HeapQueryBaseIsValid(uint32_t thread_id)
 {
-  return s_MemoryDataThreadValidFlag[thread_id];
+  if( thread_id == k_HeapThreadAuto )
+  {
+    thread_id = s_BoundThreadId;
+  }
+
+  struct MemoryData* mem_data = FindMemoryData( thread_id );
+  return mem_data && mem_data->m_Valid;
+}
+
+void HeapSetAutoInit( uint64_t alloc_size, uint32_t init_flags )
+{
+  s_AutoInitSize  = alloc_size;
+  s_AutoInitFlags = init_flags;
+}
+
+void HeapSetAutoConfig( const struct HeapConfig* config )
+{
+  s_AutoInitCustom = config != NULL;
+  if( config )
+  {
+    s_AutoInitConfig = *config;
+  }
+}
+
+uint32_t HeapGetThreadId()
+{
+  return ResolveThreadId( k_HeapThreadAuto );
 }
 
 void* HeapAllocate( uint64_t byte_size, uint32_t bucket_hints, uint8_t block_size, uint64_t debug_hash, uint32_t thread_id )
+{
+  void* data_ptr = Allocate( byte_size, bucket_hints, block_size, debug_hash, thread_id );
+  TRACE_RECORD( k_HeapTraceAlloc, data_ptr, byte_size, debug_hash, thread_id, bucket_hints, block_size );
+  return data_ptr;
+}
+
+static void* Allocate( uint64_t byte_size, uint32_t bucket_hints, uint8_t block_size, uint64_t debug_hash, uint32_t thread_id )
 {
   if ( byte_size == 0 )
   {
@@ -140,66 +553,182 @@ void* HeapAllocate( uint64_t byte_size, uint32_t bucket_hints, uint8_t block_siz
   }
 
   block_size = block_size ? block_size : 4;
+  thread_id  = ResolveThreadId( thread_id );
   
   uint64_t aligned_alloc = CalcAllignedAllocSize( byte_size, block_size );
 
-  struct HeapQueryResult request = HeapCalcAllocPartitionAndSize( aligned_alloc, bucket_hints, thread_id );
+  struct MemoryData*   mem_data  = GetMemoryData( thread_id );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
 
-  if( !( request.m_Status & k_QuerySuccess ) ) // maybe assert(?)
+  // heap init ran out of memory
+  if( !mem_data->m_Valid )
   {
-    if( bucket_hints & k_HeapHintStrictSize )
-    {
-      return NULL; // maybe assert(?)
-    }
-    return NULL; // maybe assert(?)
+    return NULL;
   }
 
-  // mark && assign memory
+  // blocks other threads released since the last allocation
+  if( AtomicLoadPtr( &mem_data->m_RemoteFrees ) )
+  {
+    DrainRemoteFrees( mem_data );
+  }
+
+  if( free_list->m_Large.m_Threshold && aligned_alloc >= free_list->m_Large.m_Threshold )
+  {
+    return LargeAllocate( mem_data, aligned_alloc, 0, debug_hash );
+  }
+
+  return AllocateAtLevel( mem_data, aligned_alloc, SelectLevel( free_list, CalcAllignedAllocSize( aligned_alloc, BASE_ALIGN ), bucket_hints ), bucket_hints, debug_hash );
+}
+
+void* HeapAllocateLevel( uint64_t byte_size, uint32_t level_idx, uint64_t debug_hash, uint32_t thread_id )
+{
+  if ( byte_size == 0 )
+  {
+    return NULL; // maybe trigger assert(?)
+  }
+
+  thread_id = ResolveThreadId( thread_id );
 
-  const uint32_t bin_size = ( request.m_Status & ~( k_QuerySuccess ) ) + s_BlockHeaderSize;
+  const uint64_t       aligned_alloc = CalcAllignedAllocSize( byte_size, BASE_ALIGN );
+  struct MemoryData*   mem_data      = GetMemoryData( thread_id );
+  struct HeapFreeList* free_list     = &mem_data->m_FreeList;
 
-  int32_t partition_idx = -1;
-  for(uint32_t ipartition = 0; ipartition < k_HeapNumLvl && partition_idx < 0; ipartition++)
+  if( !mem_data->m_Valid )
   {
-    partition_idx = s_HeapBinSizes[ipartition] == ( bin_size - s_BlockHeaderSize ) ? ipartition : -1;
+    return NULL;
   }
-  ASSERT_F( partition_idx >= 0, "Invalid bin size returned from CalcAllocPartitionAndSize()" );
-  
-  struct HeapFreeList* free_list = &s_MemoryDataThreads[thread_id].m_FreeList;
 
-  struct HeapTrackerData* free_part_info = &free_list->m_TrackerInfo[partition_idx];
-  struct HeapBlockHeader* free_slot      = free_list->m_Tracker + ( free_part_info->m_PartitionOffset + request.m_TrackerSelectedIdx );
-  
-  struct HeapBlockHeader* mem_marker = (struct HeapBlockHeader*)( free_list->m_PartitionLvls[partition_idx] + ( bin_size * EXTRACT_IDX( free_slot->m_BHIndexNPartition ) ) );
-  mem_marker->m_BHIndexNPartition    = free_slot->m_BHIndexNPartition;
-  mem_marker->m_BHAllocCount         = request.m_AllocBins;
+  ASSERT_F( level_idx < free_list->m_LevelCount, "Level %u isn't part of the heap's config ( %u levels )", level_idx, free_list->m_LevelCount );
 
-  // subtract & update || remove free slot from list
-  if( free_slot->m_BHAllocCount > request.m_AllocBins )
+  if( AtomicLoadPtr( &mem_data->m_RemoteFrees ) )
   {
-    free_slot->m_BHAllocCount -= request.m_AllocBins;
-    uint64_t index             = EXTRACT_IDX( free_slot->m_BHIndexNPartition );
-             index            += request.m_AllocBins;
+    DrainRemoteFrees( mem_data );
+  }
 
-    free_slot->m_BHIndexNPartition = SET_INDEX_PART( index, partition_idx );
+  void* data_ptr = NULL;
+  if( free_list->m_Large.m_Threshold && aligned_alloc >= free_list->m_Large.m_Threshold )
+  {
+    data_ptr = LargeAllocate( mem_data, aligned_alloc, 0, debug_hash );
   }
   else
   {
-    // find index of free_slot in the list
-    if( free_part_info->m_TrackedCount == 1 || ( request.m_TrackerSelectedIdx + 1 ) == free_part_info->m_TrackedCount )
+    data_ptr = AllocateAtLevel( mem_data, aligned_alloc, level_idx < free_list->m_LevelCount ? level_idx : free_list->m_LevelCount - 1, k_HeapHintStrictSize, debug_hash );
+  }
+
+  TRACE_RECORD( k_HeapTraceAllocLevel, data_ptr, byte_size, debug_hash, thread_id, level_idx, 0 );
+  return data_ptr;
+}
+
+static void* AllocateAtLevel( struct MemoryData* mem_data, uint64_t aligned_alloc, uint32_t level_idx, uint32_t bucket_hints, uint64_t debug_hash )
+{
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+  void* data = AllocateFromLevel( mem_data, aligned_alloc, level_idx, bucket_hints, debug_hash );
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+
+  return data;
+}
+
+// Slab, thread cache, then the tracker of the level && its segments
+static void* AllocateFromLevel( struct MemoryData* mem_data, uint64_t aligned_alloc, uint32_t level_idx, uint32_t bucket_hints, uint64_t debug_hash )
+{
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  // header-less slot of a small level, the segments behind it take over once the slab is full
+  if( level_idx < free_list->m_SlabLvls && aligned_alloc <= LevelSize( free_list, level_idx ) )
+  {
+    unsigned char* data = (unsigned char*)SlabAllocate( free_list, level_idx );
+    if( data )
     {
-      memset( free_slot, 0, s_BlockHeaderSize );
+      StatsAlloc( &free_list->m_Stats[level_idx], 1, LevelSize( free_list, level_idx ) );
+      data[0] = 1; // set value of 1st point to a number other than 0
+      return data;
+    }
+  }
+
+  // single bin requests are served from the thread cache w/o touching the tracker
+  if( free_list->m_Cache[level_idx].m_HighWater && CalcBinCount( free_list, CalcAllignedAllocSize( aligned_alloc, BASE_ALIGN ), level_idx ) == 1 )
+  {
+    struct HeapCacheBin* cache = &free_list->m_Cache[level_idx];
+
+    unsigned char* data = (unsigned char*)cache->m_Head;
+    if( data )
+    {
+      cache->m_Head = *(void**)data;
+      cache->m_Count--;
     }
     else
     {
-      memmove( free_slot, free_slot + 1, s_BlockHeaderSize * ( free_part_info->m_TrackedCount - ( request.m_TrackerSelectedIdx + 1 ) ) );
+      data = (unsigned char*)CacheRefill( free_list, level_idx );
+      if( data == NULL && AddSegment( mem_data, level_idx, 1 ) )
+      {
+        data = (unsigned char*)CacheRefill( free_list, level_idx );
+      }
+      if( data == NULL )
+      {
+        StatsFailed( &free_list->m_Stats[level_idx], k_QueryNoFreeSpace );
+        return NULL; // maybe assert(?)
+      }
     }
-    free_part_info->m_TrackedCount--;
+
+#ifdef TAG_MEMORY
+    ( (struct HeapBlockHeader*)( data - s_BlockHeaderSize ) )->m_BHTagHash = debug_hash;
+#endif // TAG_MEMORY
+
+    StatsAlloc( &free_list->m_Stats[level_idx], 1, BlockBytes( free_list, data ) );
+    data[0] = 1; // set value of 1st point to a number other than 0
+    return data;
+  }
+
+  struct HeapQueryResult request = QueryLevel( free_list, aligned_alloc, level_idx );
+
+  // cached blocks may be what splits the extent this request needs
+  if( !( request.m_Status & k_QuerySuccess ) && free_list->m_Cache[level_idx].m_Count )
+  {
+    CacheFlush( free_list, level_idx, free_list->m_Cache[level_idx].m_Count );
+    request = QueryLevel( free_list, aligned_alloc, level_idx );
+  }
+
+  // level is out of room : chain another segment to it
+  if( !( request.m_Status & k_QuerySuccess ) && AddSegment( mem_data, level_idx, request.m_AllocBins ) )
+  {
+    request = QueryLevel( free_list, aligned_alloc, level_idx );
+  }
+
+  if( !( request.m_Status & k_QuerySuccess ) ) // maybe assert(?)
+  {
+    StatsFailed( &free_list->m_Stats[level_idx], request.m_Status );
+    if( bucket_hints & k_HeapHintStrictSize )
+    {
+      return NULL; // maybe assert(?)
+    }
+    return NULL; // maybe assert(?)
+  }
+
+  // mark && assign memory
+
+  const uint32_t partition_idx = request.m_PartitionIdx;
+  const uint32_t bin_size      = free_list->m_PartitionLvlDetails[partition_idx].m_BinSize;
+
+  ASSERT_F( bin_size == ( request.m_Status & ~( k_QuerySuccess ) ) + s_BlockHeaderSize, "Invalid bin size returned from CalcAllocPartitionAndSize()" );
+
+  // index node lives where the header goes, so carve the bins out before the header is written
+  const uint64_t free_slot_idx = TakeFreeBins( free_list, partition_idx, request.m_TrackerSelectedIdx, request.m_AllocBins );
+  if( free_slot_idx == INDEX_NONE )
+  {
+    StatsFailed( &free_list->m_Stats[level_idx], k_QueryNoFreeSpace );
+    return NULL; // maybe assert(?)
   }
-  free_part_info->m_BinOccupancy -= request.m_AllocBins;
+
+  struct HeapBlockHeader* mem_marker = (struct HeapBlockHeader*)( free_list->m_PartitionLvls[partition_idx] + ( bin_size * free_slot_idx ) );
+  mem_marker->m_BHIndexNPartition    = SET_INDEX_PART( free_slot_idx, partition_idx );
+  mem_marker->m_BHAllocCount         = request.m_AllocBins;
+
+  StatsAlloc( &free_list->m_Stats[level_idx], 1, bin_size * request.m_AllocBins );
 
 #ifdef TAG_MEMORY
-  mem_marker->m_BHTagMesh = debug_hash;
+  mem_marker->m_BHTagHash = debug_hash;
 #else
   debug_hash = debug_hash;
 #endif // TAG_MEMORY
@@ -210,35 +739,16 @@ void* HeapAllocate( uint64_t byte_size, uint32_t bucket_hints, uint8_t block_siz
   return data; // return pointer to memory region after header
 }
 
-static void CoalesceSlot( struct HeapTrackerData* tracker_info, struct HeapBlockHeader tracker_data[], uint64_t tracker_idx, uint64_t base_idx, uint64_t coalesce_idx, uint64_t coalesce_bins )
+bool HeapRelease( void* data_ptr, uint32_t thread_id )
 {
-  tracker_data[tracker_idx].m_BHIndexNPartition  = SET_INDEX_PART( base_idx < coalesce_idx ? base_idx : coalesce_idx, EXTRACT_PART( tracker_data[tracker_idx].m_BHIndexNPartition ) );
-  tracker_data[tracker_idx].m_BHAllocCount      += coalesce_bins;
-  tracker_info->m_BinOccupancy                  += coalesce_bins;
-}
-
-static void InsertSlot( struct HeapTrackerData* tracker_info, struct HeapBlockHeader tracker_data[],  struct HeapBlockHeader* header, uint64_t tracker_idx, bool shift_right )
+  if( data_ptr )
   {
-    switch( (int)shift_right )
-    {
-      case 0: // append
-      {
-        tracker_data[tracker_idx] = *header;
-        break;
-      }
-      default: // shift then set
-      {
-        memmove( tracker_data + tracker_idx + 1, tracker_data + tracker_idx, s_BlockHeaderSize * ( tracker_info->m_TrackedCount - tracker_idx ) );
-        tracker_data[tracker_idx] = *header;
-        break;
-      }
-    }
-
-    tracker_info->m_BinOccupancy += header->m_BHAllocCount;
-    tracker_info->m_TrackedCount++;
-  };
+    TRACE_RECORD( k_HeapTraceRelease, data_ptr, 0, 0, thread_id, 0, 0 );
+  }
+  return Release( data_ptr, thread_id );
+}
 
-bool HeapRelease( void* data_ptr, uint32_t thread_id )
+static bool Release( void* data_ptr, uint32_t thread_id )
 {
   // This function will maintain the invariant : each free list partition is sorted incrementally by block index
 
@@ -247,223 +757,597 @@ bool HeapRelease( void* data_ptr, uint32_t thread_id )
     return false;
   }
 
-  struct HeapBlockHeader header       = *( (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize ) );
-  const uint64_t slot_idx  = EXTRACT_IDX( header.m_BHIndexNPartition );
-  const uint64_t part_idx  = EXTRACT_PART( header.m_BHIndexNPartition );
-  const uint64_t slot_bins = header.m_BHAllocCount;
+  struct MemoryData* mem_data = GetMemoryData( ResolveThreadId( thread_id ) );
 
-  // clear marker/data once copied
-  memset( (unsigned char*)data_ptr - s_BlockHeaderSize, 0, s_BlockHeaderSize + 1 );
-  
-  struct HeapFreeList* free_list = &s_MemoryDataThreads[thread_id].m_FreeList;
+  // block belongs to another thread's heap : queue it for the owner to release on its next allocation
+  struct MemoryData* owner = FindBlockOwner( mem_data, data_ptr );
 
-  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
-  struct HeapBlockHeader* tracker_data = free_list->m_Tracker + tracker_info->m_PartitionOffset;
-  
-  if( tracker_info->m_TrackedCount == 0 ) // if free list is empty, add new slot
+  ASSERT_F( owner, "Releasing memory not allocated by any heap : %p", data_ptr );
+  if( owner == NULL )
   {
-    tracker_data[0] = header;
-    tracker_info->m_TrackedCount++;
-    return true;
+    return false;
   }
 
-  if( tracker_info->m_TrackedCount == 1 ) // if free list has 1 slot, coalesce or insert
+  if( owner != mem_data )
   {
-    int64_t base_idx  = EXTRACT_IDX( tracker_data[0].m_BHIndexNPartition );
-    int64_t base_bins = tracker_data[0].m_BHAllocCount;
-    int64_t head_dist = base_idx - (int)( slot_idx + slot_bins );
-    int64_t tail_dist = (int)slot_idx - ( base_idx + base_bins );
-
-    if( head_dist == 0 || tail_dist == 0 )
+    PushRemoteFree( owner, data_ptr );
+    return true;
+  }
+
+  ReleaseLocal( &mem_data->m_FreeList, data_ptr );
+  return true;
+}
+
+bool HeapReleaseSized( void* data_ptr, uint64_t byte_size, uint32_t thread_id )
+{
+  if( data_ptr == NULL )
+  {
+    return false;
+  }
+
+  TRACE_RECORD( k_HeapTraceRelease, data_ptr, byte_size, 0, thread_id, 0, 0 );
+
+  struct MemoryData*   mem_data  = GetMemoryData( ResolveThreadId( thread_id ) );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  // padding for alignment only grows a request, so a size past the largest slab class never got a slot
+  const bool maybe_slab = free_list->m_SlabLvls && CalcAllignedAllocSize( byte_size, BASE_ALIGN ) <= LevelSize( free_list, free_list->m_SlabLvls - 1 );
+  if( maybe_slab || !OwnsPointer( mem_data, data_ptr ) )
+  {
+    return Release( data_ptr, thread_id );
+  }
+
+  ReleaseBlock( free_list, data_ptr );
+  return true;
+}
+
+void* HeapAllocateAligned( uint64_t byte_size, uint32_t alignment, uint64_t debug_hash, uint32_t thread_id )
+{
+  void* data_ptr = AllocateAligned( byte_size, alignment, debug_hash, thread_id );
+  TRACE_RECORD( k_HeapTraceAllocAligned, data_ptr, byte_size, debug_hash, thread_id, alignment, 0 );
+  return data_ptr;
+}
+
+static void* AllocateAligned( uint64_t byte_size, uint32_t alignment, uint64_t debug_hash, uint32_t thread_id )
+{
+  ASSERT_F( ( alignment & ( alignment - 1 ) ) == 0 && alignment <= GetPageSize(), "Invalid alignment : %u", alignment );
+
+  // every block starts 8 B aligned
+  if( alignment <= BASE_ALIGN )
+  {
+    return Allocate( byte_size, k_HeapHintNone, 0, debug_hash, thread_id );
+  }
+  if( byte_size == 0 )
+  {
+    return NULL;
+  }
+
+  thread_id = ResolveThreadId( thread_id );
+
+  struct MemoryData*   mem_data  = GetMemoryData( thread_id );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  if( !mem_data->m_Valid )
+  {
+    return NULL;
+  }
+
+  if( free_list->m_Large.m_Threshold && CalcAllignedAllocSize( byte_size, BASE_ALIGN ) + alignment >= free_list->m_Large.m_Threshold )
+  {
+    if( AtomicLoadPtr( &mem_data->m_RemoteFrees ) )
     {
-      CoalesceSlot( tracker_info, tracker_data, 0, base_idx, slot_idx, slot_bins );
+      DrainRemoteFrees( mem_data );
     }
-    else
+    return LargeAllocate( mem_data, CalcAllignedAllocSize( byte_size, BASE_ALIGN ), alignment, debug_hash );
+  }
+
+  // over allocate, then shift the pointer && put a copy of the header right in front of it
+  uint64_t padded_size = byte_size + alignment - BASE_ALIGN;
+
+  // slab slots have no header to copy. Only the power of two classes keep their slots aligned to the
+  // slot size, which covers the alignment since it's no larger than the padded request
+  if( free_list->m_SlabLvls && padded_size <= k_HeapSlabMaxSize )
+  {
+    padded_size = padded_size <= BASE_BUCKET ? BASE_BUCKET : (uint64_t)1 << ( BitScanHigh64( padded_size - 1 ) + 1 );
+  }
+
+  unsigned char* data = (unsigned char*)Allocate( padded_size, k_HeapHintNone, 0, debug_hash, thread_id );
+  if( data == NULL )
+  {
+    return NULL;
+  }
+
+  // a HeapConfig may lack the power of two class : retry on the 1st level w/ headers
+  const uint32_t slab_level = FindSlabLevel( free_list, data );
+  if( slab_level < k_HeapSlabLvls && (uintptr_t)data % alignment )
+  {
+    ReleaseLocal( free_list, data );
+    if( free_list->m_SlabLvls == free_list->m_LevelCount )
     {
-      if( head_dist > 0 )
-      {
-        InsertSlot( tracker_info, tracker_data, &header, 0, true ); // new head
-      }
-      else
-      {
-        InsertSlot( tracker_info, tracker_data, &header, 1, false ); // append
-      }
+      return LargeAllocate( mem_data, CalcAllignedAllocSize( byte_size, BASE_ALIGN ), alignment, debug_hash );
+    }
+
+    data = (unsigned char*)AllocateAtLevel( mem_data, padded_size, free_list->m_SlabLvls, k_HeapHintStrictSize, debug_hash );
+    if( data == NULL )
+    {
+      return NULL;
     }
-    return true;
   }
-  
-  // - use divide & conquer to find its spot in list
-  int64_t head = 0;
-  int64_t tail = tracker_info->m_TrackedCount - 1;
-  while( ( tail - head ) > 0 )
+
+  unsigned char* aligned_data = (unsigned char*)CalcAllignedAllocSize( (uintptr_t)data, alignment );
+  if( aligned_data != data )
+  {
+    memmove( aligned_data - s_BlockHeaderSize, data - s_BlockHeaderSize, s_BlockHeaderSize );
+  }
+  return aligned_data;
+}
+
+void* HeapReallocate( void* data_ptr, uint64_t byte_size, uint32_t thread_id )
+{
+  if( data_ptr == NULL )
+  {
+    void* new_ptr = Allocate( byte_size, k_HeapHintNone, 0, 0, thread_id );
+    TRACE_RECORD( k_HeapTraceRealloc, new_ptr, byte_size, 0, thread_id, 0, 0 );
+    return new_ptr;
+  }
+  if( byte_size == 0 )
+  {
+    TRACE_RECORD( k_HeapTraceRealloc, NULL, 0, (uintptr_t)data_ptr, thread_id, 0, 0 );
+    Release( data_ptr, thread_id );
+    return NULL;
+  }
+
+  thread_id = ResolveThreadId( thread_id );
+
+  struct MemoryData* mem_data = GetMemoryData( thread_id );
+  if( AtomicLoadPtr( &mem_data->m_RemoteFrees ) )
+  {
+    DrainRemoteFrees( mem_data );
+  }
+
+  // another thread's tracker can't be touched from here, so those blocks always move
+  if( FindBlockOwner( mem_data, data_ptr ) == mem_data && ResizeInPlace( &mem_data->m_FreeList, data_ptr, byte_size ) )
+  {
+    TRACE_RECORD( k_HeapTraceRealloc, data_ptr, byte_size, (uintptr_t)data_ptr, thread_id, 0, 0 );
+    return data_ptr;
+  }
+
+#ifdef TAG_MEMORY
+  const uint64_t debug_hash = FindSlabLevel( &mem_data->m_FreeList, data_ptr ) < k_HeapSlabLvls ? 0 : ( (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize ) )->m_BHTagHash;
+#else
+  const uint64_t debug_hash = 0;
+#endif // TAG_MEMORY
+
+  void* new_ptr = Allocate( byte_size, k_HeapHintNone, 0, debug_hash, thread_id );
+  TRACE_RECORD( k_HeapTraceRealloc, new_ptr, byte_size, (uintptr_t)data_ptr, thread_id, 0, 0 );
+  if( new_ptr == NULL )
+  {
+    return NULL; // old block stays valid
+  }
+
+  const uint64_t usable_size = HeapUsableSize( data_ptr );
+  memcpy( new_ptr, data_ptr, (size_t)( usable_size < byte_size ? usable_size : byte_size ) );
+
+  Release( data_ptr, thread_id );
+  return new_ptr;
+}
+
+uint64_t HeapUsableSize( void* data_ptr )
+{
+  if( data_ptr == NULL )
+  {
+    return 0;
+  }
+  struct MemoryData* mem_data = FindBlockOwner( NULL, data_ptr );
+
+  ASSERT_F( mem_data, "Querying memory not allocated by any heap : %p", data_ptr );
+  if( mem_data == NULL )
+  {
+    return 0;
+  }
+
+  const uint32_t slab_level = FindSlabLevel( &mem_data->m_FreeList, data_ptr );
+  if( slab_level < k_HeapSlabLvls )
+  {
+    return LevelSize( &mem_data->m_FreeList, slab_level );
+  }
+
+  if( IsLargeBlock( data_ptr ) )
   {
-    uint64_t pivot_idx = head + ( ( tail - head ) / 2 );
+    struct HeapLargeBlock* large = GetLargeBlock( data_ptr );
+    return large->m_MapSize - (uint64_t)( (unsigned char*)data_ptr - (unsigned char*)large );
+  }
+
+  const struct HeapBlockHeader* header = (const struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+  return GetBlockEnd( &mem_data->m_FreeList, header ) - (unsigned char*)data_ptr;
+}
+
+uint32_t HeapAllocateBatch( uint64_t byte_size, uint32_t count, void* out_ptrs[], uint32_t thread_id )
+{
+  const uint32_t alloc_count = AllocateBatch( byte_size, count, out_ptrs, thread_id );
+#ifdef HEAP_TRACE
+  for( uint32_t iptr = 0; iptr < alloc_count; iptr++ )
+  {
+    TraceRecord( k_HeapTraceAlloc, out_ptrs[iptr], byte_size, 0, thread_id, k_HeapHintNone, 0 );
+  }
+#endif // HEAP_TRACE
+  return alloc_count;
+}
+
+static uint32_t AllocateBatch( uint64_t byte_size, uint32_t count, void* out_ptrs[], uint32_t thread_id )
+{
+  if( byte_size == 0 )
+  {
+    return 0;
+  }
+
+  struct MemoryData*   mem_data  = GetMemoryData( ResolveThreadId( thread_id ) );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  if( !mem_data->m_Valid )
+  {
+    return 0;
+  }
 
-    int64_t left_idx        = EXTRACT_IDX( tracker_data[pivot_idx].m_BHIndexNPartition );
-    int64_t right_idx       = EXTRACT_IDX( tracker_data[pivot_idx + 1].m_BHIndexNPartition );
-    int64_t left_idx_offset = tracker_data[pivot_idx].m_BHAllocCount;
+  if( AtomicLoadPtr( &mem_data->m_RemoteFrees ) )
+  {
+    DrainRemoteFrees( mem_data );
+  }
 
-    int64_t left_dist  = (int)slot_idx - ( left_idx + left_idx_offset );
-    int64_t right_dist = right_idx - (int)( slot_idx + slot_bins );
+  const uint64_t aligned_alloc = CalcAllignedAllocSize( byte_size, BASE_ALIGN );
+  uint32_t       alloc_count   = 0;
 
-    if( left_dist >= 0 )
+  if( free_list->m_Large.m_Threshold && aligned_alloc >= free_list->m_Large.m_Threshold )
+  {
+    for( ; alloc_count < count; alloc_count++ )
     {
-      if( right_dist >= 0 )
-      {
-        if( left_dist == 0 && right_dist == 0 ) // coalesce both sides
-        {
-          CoalesceSlot( tracker_info, tracker_data, pivot_idx, left_idx, slot_idx, slot_bins );
-          tracker_data[pivot_idx].m_BHAllocCount += tracker_data[pivot_idx + 1].m_BHAllocCount;
-
-          memmove( tracker_data + pivot_idx + 1, tracker_data + pivot_idx + 2, s_BlockHeaderSize * ( tracker_info->m_TrackedCount - pivot_idx + 2 ) );
-          tracker_info->m_TrackedCount--;
-          return true;
-        }
-        else if( left_dist == 0 ) // coalesce left
-        {
-          CoalesceSlot( tracker_info, tracker_data, pivot_idx, left_idx, slot_idx, slot_bins );
-          return true;
-        }
-        else if( right_dist == 0 ) // coalesce right
-        {
-          CoalesceSlot( tracker_info, tracker_data, pivot_idx + 1, right_idx, slot_idx, slot_bins );
-          return true;
-        }
-
-        // insert between left & right
-        InsertSlot( tracker_info, tracker_data, &header, pivot_idx + 1, true );
-        return true;
-      }
-      else // left_idx < right_idx < slot_idx
+      out_ptrs[alloc_count] = LargeAllocate( mem_data, aligned_alloc, 0, 0 );
+      if( out_ptrs[alloc_count] == NULL )
       {
-        head = pivot_idx + 1;
+        break;
       }
     }
-    else // slot_idx < left_idx < right_idx
+    return alloc_count;
+  }
+
+  const uint32_t level_idx  = SelectLevel( free_list, aligned_alloc, k_HeapHintNone );
+  const uint64_t block_bins = CalcBinCount( free_list, aligned_alloc, level_idx );
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+
+  while( level_idx < free_list->m_SlabLvls && alloc_count < count )
+  {
+    unsigned char* data = (unsigned char*)SlabAllocate( free_list, level_idx );
+    if( data == NULL )
     {
-      tail = pivot_idx;
+      break;
     }
+    StatsAlloc( &free_list->m_Stats[level_idx], 1, LevelSize( free_list, level_idx ) );
+    data[0]                 = 1; // set value of 1st point to a number other than 0
+    out_ptrs[alloc_count++] = data;
   }
-  
-  if( head == 0 ) // merge/insert at head
+
+  // single bin blocks sitting in the cache go first
+  struct HeapCacheBin* cache = &free_list->m_Cache[level_idx];
+  while( block_bins == 1 && cache->m_HighWater && alloc_count < count && cache->m_Head )
   {
-    int64_t base_idx  = EXTRACT_IDX( tracker_data[0].m_BHIndexNPartition );
-    int64_t base_bins = tracker_data[0].m_BHAllocCount;
-    int64_t head_dist = base_idx - (int)( slot_idx + slot_bins );
-    int64_t tail_dist = (int)slot_idx - ( base_idx + base_bins );
+    unsigned char* data = (unsigned char*)cache->m_Head;
+    cache->m_Head       = *(void**)data;
+    cache->m_Count--;
+
+#ifdef TAG_MEMORY
+    ( (struct HeapBlockHeader*)( data - s_BlockHeaderSize ) )->m_BHTagHash = 0;
+#endif // TAG_MEMORY
+
+    StatsAlloc( &free_list->m_Stats[level_idx], 1, BlockBytes( free_list, data ) );
+    data[0]                 = 1; // set value of 1st point to a number other than 0
+    out_ptrs[alloc_count++] = data;
+  }
 
-    if( head_dist == 0 || tail_dist == 0 ) // merge/insert at tail
+  while( alloc_count < count )
+  {
+    // largest run of blocks a single extent can hold, halving from everything still missing
+    uint32_t part_idx   = level_idx;
+    uint64_t free_idx   = INDEX_NONE;
+    uint64_t run_blocks = count - alloc_count;
+    for( ; run_blocks; run_blocks /= 2 )
     {
-      CoalesceSlot( tracker_info, tracker_data, 0, base_idx, slot_idx, slot_bins );
-      return true;
+      free_idx = LevelFindFit( free_list, level_idx, run_blocks * block_bins, &part_idx );
+      if( free_idx != INDEX_NONE )
+      {
+        break;
+      }
     }
-    else
+
+    if( run_blocks == 0 )
     {
-      InsertSlot( tracker_info, tracker_data, &header, 0, true );
-      return true;
+      if( AddSegment( mem_data, level_idx, block_bins ) )
+      {
+        continue;
+      }
+      StatsFailed( &free_list->m_Stats[level_idx], QueryLevel( free_list, aligned_alloc, level_idx ).m_Status );
+      break; // maybe assert(?)
     }
-  }
-  else // merge/insert at tail
-  {
-    int64_t base_idx  = EXTRACT_IDX( tracker_data[tracker_info->m_TrackedCount - 1].m_BHIndexNPartition );
-    int64_t base_bins = tracker_data[ tracker_info->m_TrackedCount - 1 ].m_BHAllocCount;
-    int64_t head_dist = base_idx - (int)( slot_idx + slot_bins );
-    int64_t tail_dist = (int)slot_idx - ( base_idx + base_bins );
-    
-    if( head_dist == 0 || tail_dist == 0 )
+
+    struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+    const uint64_t          selected_idx = free_list->m_InitFlags & k_HeapInitTreeTracker ? free_idx : FindTrackerSlot( tracker_info->m_TrackerSlice, tracker_info->m_TrackedCount, free_idx );
+    const uint64_t          run_idx      = TakeFreeBins( free_list, part_idx, selected_idx, run_blocks * block_bins );
+    const uint32_t          bin_size     = free_list->m_PartitionLvlDetails[part_idx].m_BinSize;
+    if( run_idx == INDEX_NONE )
     {
-      CoalesceSlot( tracker_info, tracker_data, tracker_info->m_TrackedCount - 1, base_idx, slot_idx, slot_bins );
-      return true;
+      StatsFailed( &free_list->m_Stats[level_idx], k_QueryNoFreeSpace );
+      break; // maybe assert(?)
     }
-    else
+
+    StatsAlloc( &free_list->m_Stats[level_idx], run_blocks, run_blocks * block_bins * bin_size );
+    for( uint64_t iblock = 0; iblock < run_blocks; iblock++ )
     {
-      InsertSlot( tracker_info, tracker_data, &header, tracker_info->m_TrackedCount, false );
-      return true;
+      const uint64_t          block_idx  = run_idx + iblock * block_bins;
+      struct HeapBlockHeader* mem_marker = (struct HeapBlockHeader*)( free_list->m_PartitionLvls[part_idx] + bin_size * block_idx );
+
+      mem_marker->m_BHIndexNPartition = SET_INDEX_PART( block_idx, part_idx );
+      mem_marker->m_BHAllocCount      = block_bins;
+#ifdef TAG_MEMORY
+      mem_marker->m_BHTagHash = 0;
+#endif // TAG_MEMORY
+
+      unsigned char* data    = (unsigned char*)mem_marker + s_BlockHeaderSize;
+                     data[0] = 1; // set value of 1st point to a number other than 0
+
+      out_ptrs[alloc_count++] = data;
     }
   }
+
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+  return alloc_count;
 }
 
-struct HeapQueryResult HeapCalcAllocPartitionAndSize( uint64_t alloc_size, uint32_t bucket_hint, uint32_t thread_id )
+void HeapReleaseBatch( void* ptrs[], uint32_t count, uint32_t thread_id )
 {
-  struct HeapQueryResult result;
-  alloc_size = CalcAllignedAllocSize( alloc_size, BASE_ALIGN );
+#ifdef HEAP_TRACE
+  for( uint32_t iptr = 0; iptr < count; iptr++ )
+  {
+    if( ptrs[iptr] )
+    {
+      TraceRecord( k_HeapTraceRelease, ptrs[iptr], 0, 0, thread_id, 0, 0 );
+    }
+  }
+#endif // HEAP_TRACE
 
-  // Simple heuristic : find best-fit heap partition
-  uint32_t chosen_bucket           = k_HeapLevel0;
-  uint32_t chosen_bucket_idx       = 0;
-  uint64_t chosen_bucket_bin_count = 0;
+  struct MemoryData*   mem_data  = GetMemoryData( ResolveThreadId( thread_id ) );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
 
-  for( size_t i = 0; i < k_HeapNumLvl && chosen_bucket < s_HeapBinSizes[k_HeapNumLvl - 1]; i++ )
+  // foreign, large && cacheable blocks leave right away, the rest are packed to the front of ptrs
+  uint32_t tracked_count = 0;
+  for( uint32_t iptr = 0; iptr < count; iptr++ )
   {
-    if( alloc_size <= chosen_bucket )
+    void* data_ptr = ptrs[iptr];
+    if( data_ptr == NULL )
     {
-      break;
+      continue;
+    }
+
+    struct MemoryData* owner = FindBlockOwner( mem_data, data_ptr );
+
+    ASSERT_F( owner, "Releasing memory not allocated by any heap : %p", data_ptr );
+    if( owner == NULL )
+    {
+      continue;
+    }
+    if( owner != mem_data )
+    {
+      PushRemoteFree( owner, data_ptr );
+      continue;
+    }
+
+    if( FindSlabLevel( free_list, data_ptr ) < k_HeapSlabLvls || IsLargeBlock( data_ptr ) )
+    {
+      ReleaseLocal( free_list, data_ptr );
+      continue;
+    }
+
+    data_ptr = UnshiftBlock( free_list, data_ptr );
+
+    struct HeapBlockHeader* header    = (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+    const uint32_t          level_idx = free_list->m_PartitionLvlDetails[EXTRACT_PART( header->m_BHIndexNPartition )].m_Level;
+    struct HeapCacheBin*    cache     = &free_list->m_Cache[level_idx];
+
+    bool cached = false;
+    LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+    StatsRelease( &free_list->m_Stats[level_idx], 1, BlockBytes( free_list, data_ptr ) );
+    if( header->m_BHAllocCount == 1 && cache->m_Count < cache->m_HighWater )
+    {
+      *(void**)data_ptr = cache->m_Head;
+      cache->m_Head     = data_ptr;
+      cache->m_Count++;
+      cached = true;
+    }
+    LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+
+    if( !cached )
+    {
+      ptrs[tracked_count++] = data_ptr;
     }
-    chosen_bucket = chosen_bucket << 1;
-    chosen_bucket_idx++;
   }
 
-  // Strict heuristic : Attempt to allocate using specified heap buckets (choose largest of specified buckets)
-  if( bucket_hint & k_HeapHintStrictSize )
+  qsort( ptrs, tracked_count, sizeof( void* ), CompareBlocks );
+
+  for( uint32_t group_start = 0, group_end; group_start < tracked_count; group_start = group_end )
   {
-    uint32_t max_bucket = 0;
-    for( uint32_t ibin = 0; ibin < k_HeapNumLvl; ibin++ )
+    const uint32_t part_idx = (uint32_t)EXTRACT_PART( ( (struct HeapBlockHeader*)( (unsigned char*)ptrs[group_start] - s_BlockHeaderSize ) )->m_BHIndexNPartition );
+
+    const uint32_t level_idx = free_list->m_PartitionLvlDetails[part_idx].m_Level;
+
+    group_end = group_start + 1;
+    while( group_end < tracked_count && EXTRACT_PART( ( (struct HeapBlockHeader*)( (unsigned char*)ptrs[group_end] - s_BlockHeaderSize ) )->m_BHIndexNPartition ) == part_idx )
+    {
+      group_end++;
+    }
+
+    LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+    if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+    {
+      for( uint32_t iptr = group_start; iptr < group_end; iptr++ )
+      {
+        ReleaseToTracker( free_list, ptrs[iptr] );
+      }
+    }
+    else
     {
-      if( bucket_hint & s_HeapBinSizes[ibin] )
+      ArrayReturnBlocks( free_list, part_idx, ptrs + group_start, group_end - group_start );
+
+      if( part_idx >= k_HeapNumLvl && free_list->m_TrackerInfo[part_idx].m_BinOccupancy == free_list->m_PartitionLvlDetails[part_idx].m_BinCount )
       {
-        max_bucket        = s_HeapBinSizes[ibin];
-        chosen_bucket_idx = ibin;
+        TrimSegments( free_list, level_idx, 1 );
       }
+      PurgeOnRelease( free_list, level_idx );
     }
-    chosen_bucket = max_bucket ? max_bucket : chosen_bucket;
+    LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+  }
+}
+
+void HeapSetCacheLimit( uint32_t level_idx, uint32_t high_water, uint32_t thread_id )
+{
+  struct HeapFreeList* free_list = &GetMemoryData( ResolveThreadId( thread_id ) )->m_FreeList;
+  struct HeapCacheBin* cache     = &free_list->m_Cache[level_idx];
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+  if( cache->m_Count > high_water )
+  {
+    CacheFlush( free_list, level_idx, cache->m_Count - high_water );
+  }
+  cache->m_HighWater = high_water;
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+}
+
+void HeapFlushCache( uint32_t thread_id )
+{
+  struct MemoryData*   mem_data  = GetMemoryData( ResolveThreadId( thread_id ) );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  DrainRemoteFrees( mem_data );
+
+  for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+  {
+    LockAcquire( free_list, &free_list->m_LevelLocks[ilvl] );
+    CacheFlush( free_list, ilvl, free_list->m_Cache[ilvl].m_Count );
+    TrimSegments( free_list, ilvl, 0 );
+    LockRelease( free_list, &free_list->m_LevelLocks[ilvl] );
   }
 
-  // update results based on chosen_bucket
-  uint32_t heap_bin = s_HeapBinSizes[chosen_bucket_idx] + s_BlockHeaderSize;
-  chosen_bucket_bin_count  = alloc_size % heap_bin ? 1 : 0;
-  chosen_bucket_bin_count += alloc_size / heap_bin;
-  if( (int)( chosen_bucket_bin_count * heap_bin ) - s_BlockHeaderSize < 0 )
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  LargeCacheTrim( &free_list->m_Large, 0, 0 );
+  LockRelease( free_list, &free_list->m_LargeLock );
+}
+
+void HeapSetLargeThreshold( uint64_t threshold, uint32_t thread_id )
+{
+  GetMemoryData( ResolveThreadId( thread_id ) )->m_FreeList.m_Large.m_Threshold = threshold;
+}
+
+uint64_t HeapPurge( uint32_t thread_id )
+{
+  struct MemoryData*   mem_data  = GetMemoryData( ResolveThreadId( thread_id ) );
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  DrainRemoteFrees( mem_data );
+
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  uint64_t purged_size = free_list->m_Large.m_CacheSize;
+  LargeCacheTrim( &free_list->m_Large, 0, 0 );
+  LockRelease( free_list, &free_list->m_LargeLock );
+
+  const uint32_t tick = GetTickMs();
+  AtomicStore32( &free_list->m_PurgeTick, tick );
+  free_list->m_LastPurgeTick = tick;
+
+  for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
   {
-    chosen_bucket_bin_count += 1;  // make sure there's room for header
+    LockAcquire( free_list, &free_list->m_LevelLocks[ilvl] );
+    free_list->m_LevelPurgeTicks[ilvl] = tick;
+    purged_size                       += PurgeExtents( free_list, ilvl, 0, NULL );
+    LockRelease( free_list, &free_list->m_LevelLocks[ilvl] );
   }
+  return purged_size;
+}
+
+void HeapSetPurgeDecay( uint32_t decay_ms, uint32_t thread_id )
+{
+  GetMemoryData( ResolveThreadId( thread_id ) )->m_FreeList.m_PurgeDecay = decay_ms;
+}
+
+struct HeapQueryResult HeapCalcAllocPartitionAndSize( uint64_t alloc_size, uint32_t bucket_hint, uint32_t thread_id )
+{
+  struct HeapFreeList* free_list = &GetMemoryData( ResolveThreadId( thread_id ) )->m_FreeList;
+
+  // find best-fit heap partition, honouring strict size hints
+  const uint32_t level_idx = SelectLevel( free_list, CalcAllignedAllocSize( alloc_size, BASE_ALIGN ), bucket_hint );
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+  const struct HeapQueryResult result = QueryLevel( free_list, alloc_size, level_idx );
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+
+  return result;
+}
+
+// Free extent of the level ( || one of its segments ) that fits alloc_size
+static struct HeapQueryResult QueryLevel( struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t level_idx )
+{
+  struct HeapQueryResult result;
+  alloc_size = CalcAllignedAllocSize( alloc_size, BASE_ALIGN );
+
+  result.m_TrackerSelectedIdx = 0;
+  result.m_PartitionIdx       = 0;
+
+  const uint32_t chosen_bucket_idx       = level_idx;
+  const uint32_t chosen_bucket           = LevelSize( free_list, chosen_bucket_idx );
+  const uint64_t chosen_bucket_bin_count = CalcBinCount( free_list, alloc_size, chosen_bucket_idx );
 
   result.m_AllocBins = chosen_bucket_bin_count;
   result.m_Status    = chosen_bucket;
 
-  struct HeapFreeList* free_list = &s_MemoryDataThreads[thread_id].m_FreeList;
+  uint64_t level_free_bins = 0;
+  for( uint32_t ipart = chosen_bucket_idx; ipart != INDEX_NONE; ipart = free_list->m_TrackerInfo[ipart].m_NextSegment )
+  {
+    level_free_bins += free_list->m_TrackerInfo[ipart].m_BinOccupancy;
+  }
 
-  if( free_list->m_TrackerInfo[chosen_bucket_idx].m_BinOccupancy < chosen_bucket_bin_count )
+  if( level_free_bins < chosen_bucket_bin_count )
   {
     result.m_Status |= k_QueryNoFreeSpace;
     return result;
   }
 
-  int32_t                 free_bin_idx      = -1;
-  struct HeapTrackerData* tracked_bins_info = &free_list->m_TrackerInfo[chosen_bucket_idx];
-  struct HeapBlockHeader* tracked_bin       = free_list->m_Tracker + tracked_bins_info->m_PartitionOffset;
-
-  // find next available free space to allocate from
-  for( uint32_t ibin = 0; ibin < tracked_bins_info->m_TrackedCount && free_bin_idx < 0; ibin++, tracked_bin++ )
-  {
-    free_bin_idx = tracked_bin->m_BHAllocCount >= chosen_bucket_bin_count ? ibin : -1;
-  }
+  // find a free extent large enough to allocate from in the base partition || its segments
+  uint32_t       part_idx       = chosen_bucket_idx;
+  const uint64_t free_block_idx = LevelFindFit( free_list, chosen_bucket_idx, chosen_bucket_bin_count, &part_idx );
   
   // mark if partition exhibits too much fragmentation
-  if( free_bin_idx == -1 )
+  if( free_block_idx == INDEX_NONE )
   {
     result.m_Status |= k_QueryNoFreeSpace | k_QueryExcessFragmentation;
     return result;
   }
 
+  struct HeapTrackerData* tracked_bins_info = &free_list->m_TrackerInfo[part_idx];
+
   result.m_Status             |= k_QuerySuccess;
-  result.m_TrackerSelectedIdx  = free_bin_idx;
+  result.m_PartitionIdx        = part_idx;
+  result.m_TrackerSelectedIdx  = free_list->m_InitFlags & k_HeapInitTreeTracker ? free_block_idx : FindTrackerSlot( tracked_bins_info->m_TrackerSlice, tracked_bins_info->m_TrackedCount, free_block_idx );
 
   return result;
 }
 
 void HeapPrintStatus(uint32_t thread_id)
 {
-  struct HeapFreeList* free_list = &s_MemoryDataThreads[thread_id].m_FreeList;
+  struct HeapFreeList* free_list = &GetMemoryData( ResolveThreadId( thread_id ) )->m_FreeList;
+
+  // levels are always taken in ascending order, the large lock last
+  for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+  {
+    LockAcquire( free_list, &free_list->m_LevelLocks[ilvl] );
+  }
+  LockAcquire( free_list, &free_list->m_LargeLock );
 
   // Total allocated memory
   struct ByteFormat b_data = TranslateByteFormat( free_list->m_TotalPartitionSize + s_BlockHeaderSize * free_list->m_TotalPartitionBins, k_FormatByte );
@@ -472,17 +1356,32 @@ void HeapPrintStatus(uint32_t thread_id)
   printf( "  - Total partition sizes     : %10.3f %2s\n", b_data.m_Size, b_data.m_Type );
   b_data = TranslateByteFormat( s_BlockHeaderSize * free_list->m_TotalPartitionBins, k_FormatByte );
   printf( "  - Tracker list size         : %10.3f %2s\n", b_data.m_Size, b_data.m_Type );
+
+  // Large blocks mapped outside the partitions
+  struct HeapLargeList* large_list = &free_list->m_Large;
+  b_data                           = TranslateByteFormat( large_list->m_LiveSize, k_FormatByte );
+  struct ByteFormat b_cache        = TranslateByteFormat( large_list->m_CacheSize, k_FormatByte );
+  struct ByteFormat b_threshold    = TranslateByteFormat( large_list->m_Threshold, k_FormatByte );
+  printf( "o Large blocks (threshold %.3f %s) : %u live (%.3f %s), %u cached (%.3f %s)\n", b_threshold.m_Size, b_threshold.m_Type, large_list->m_LiveCount, b_data.m_Size, b_data.m_Type, large_list->m_CacheCount, b_cache.m_Size, b_cache.m_Type );
   
   // Partition characteristics
   printf( "o Partition Data:\n" );
-  for(uint32_t ipartition = 0; ipartition < k_HeapNumLvl; ipartition++)
+  for(uint32_t ipartition = 0; ipartition < k_HeapMaxPartitions; ipartition++)
   {
     struct HeapPartitionData* part_data = &free_list->m_PartitionLvlDetails[ipartition];
+    if( free_list->m_PartitionLvls[ipartition] == NULL )
+    {
+      continue;
+    }
 
     b_data                    = TranslateByteFormat( part_data->m_BinSize, k_FormatByte );
     struct ByteFormat b_data2 = TranslateByteFormat( part_data->m_BinCount * part_data->m_BinSize, k_FormatByte );
+    struct ByteFormat b_data3 = TranslateByteFormat( free_list->m_TrackerInfo[ipartition].m_CommittedSize, k_FormatByte );
     
-    printf( "  - Partition %u :: %10.3f %2s (bin size + %u B), %10" PRIu64 " (bin count), %10.3f %2s (partition size)\n", ipartition, b_data.m_Size, b_data.m_Type, s_BlockHeaderSize, part_data->m_BinCount, b_data2.m_Size, b_data2.m_Type );
+    const uint32_t    backing = free_list->m_TrackerInfo[ipartition].m_Backing;
+    
+    printf( "  - Partition %u :: %10.3f %2s (bin size + %u B), %10" PRIu64 " (bin count), %10.3f %2s (partition size), %10.3f %2s (committed,%s%s%s )\n", ipartition, b_data.m_Size, b_data.m_Type, FindSlabLevel( free_list, free_list->m_PartitionLvls[ipartition] ) < k_HeapSlabLvls ? 0 : s_BlockHeaderSize, part_data->m_BinCount, b_data2.m_Size, b_data2.m_Type, b_data3.m_Size, b_data3.m_Type,
+            backing & k_HeapBackingHugeTLB ? " hugetlb" : "", backing & k_HeapBackingTransparentHuge ? " thp" : "", backing & k_HeapBackingPages ? " default pages" : "" );
   }
   
   // For each partition: allocations && free memory (percentages), fragmentation(?)
@@ -490,36 +1389,190 @@ void HeapPrintStatus(uint32_t thread_id)
   
   char percent_str[51];
   
-  for(uint32_t ipartition = 0; ipartition < k_HeapNumLvl; ipartition++)
+  for(uint32_t ipartition = 0; ipartition < k_HeapMaxPartitions; ipartition++)
   {
-    printf( "  - Partition %u:\n", ipartition );
+    if( free_list->m_PartitionLvls[ipartition] == NULL )
+    {
+      continue;
+    }
+
+    if( ipartition < k_HeapNumLvl )
+    {
+      printf( "  - Partition %u:\n", ipartition );
+    }
+    else
+    {
+      printf( "  - Partition %u (segment of level %u):\n", ipartition, free_list->m_PartitionLvlDetails[ipartition].m_Level );
+    }
 
     struct HeapPartitionData* part_data    = &free_list->m_PartitionLvlDetails[ipartition];
     struct HeapTrackerData*   tracked_data = &free_list->m_TrackerInfo[ipartition];
 
-    float    mem_occupancy = (float)tracked_data->m_BinOccupancy / (float)part_data->m_BinCount;
+    // slabs track slots in bitmaps
+    const bool is_slab   = FindSlabLevel( free_list, free_list->m_PartitionLvls[ipartition] ) < k_HeapSlabLvls;
+    uint64_t   free_bins = is_slab ? free_list->m_Slab[ipartition].m_FreeSlots : tracked_data->m_BinOccupancy;
+
+    float    mem_occupancy = (float)free_bins / (float)part_data->m_BinCount;
     uint32_t bar_ticks     = (uint32_t)( ( sizeof( percent_str ) - 1 ) * ( 1.f - mem_occupancy ) );
 
     memset( percent_str, 0, sizeof( percent_str ) );
     memset( percent_str, '-', sizeof( percent_str ) - 1 );
     memset( percent_str, 'x', bar_ticks );
 
-    printf( "    [%-*s] (%.3f%% allocated, free slots %" PRIu64 ")\n", (int)sizeof( percent_str ) - 1, percent_str, ( 1.f - mem_occupancy ) * 100.f, tracked_data->m_TrackedCount );
+    if( is_slab )
+    {
+      printf( "    [%-*s] (%.3f%% allocated, slab w/ %" PRIu64 " free of %" PRIu64 " slots in %" PRIu64 " runs)\n", (int)sizeof( percent_str ) - 1, percent_str, ( 1.f - mem_occupancy ) * 100.f, free_bins, part_data->m_BinCount, free_list->m_Slab[ipartition].m_RunCount );
+      continue;
+    }
+
+    printf( "    [%-*s] (%.3f%% allocated, free slots %" PRIu64 ", cached blocks %u)\n", (int)sizeof( percent_str ) - 1, percent_str, ( 1.f - mem_occupancy ) * 100.f, tracked_data->m_TrackedCount, ipartition < k_HeapNumLvl ? free_list->m_Cache[ipartition].m_Count : 0 );
 
     uint64_t total_free_blocks = 0;
     uint64_t largest_block     = 0;
-    for(uint32_t itracker_idx = 0; itracker_idx < tracked_data->m_TrackedCount; itracker_idx++)
+    uint64_t cursor = INDEX_NONE, block_idx, block_count;
+    while( NextFreeExtent( free_list, ipartition, &cursor, &block_idx, &block_count ) )
     {
-      struct HeapBlockHeader* tracker = &free_list->m_Tracker[tracked_data->m_PartitionOffset + itracker_idx];
-      b_data                          = TranslateByteFormat( tracker->m_BHAllocCount * part_data->m_BinSize, k_FormatByte );
+      b_data = TranslateByteFormat( block_count * part_data->m_BinSize, k_FormatByte );
       
-      total_free_blocks += tracker->m_BHAllocCount;
-      largest_block      = tracker->m_BHAllocCount > largest_block ? tracker->m_BHAllocCount : largest_block;
+      total_free_blocks += block_count;
+      largest_block      = block_count > largest_block ? block_count : largest_block;
 
-      printf( "    | %10" PRIu64 ", %10" PRIu64 " (coalesced blocks), %10.5f %2s\n", EXTRACT_IDX( tracker->m_BHIndexNPartition ), tracker->m_BHAllocCount, b_data.m_Size, b_data.m_Type );
+      printf( "    | %10" PRIu64 ", %10" PRIu64 " (coalesced blocks), %10.5f %2s%s\n", block_idx, block_count, b_data.m_Size, b_data.m_Type, GetFreeNode( free_list, ipartition, block_idx )->m_Purged ? " (purged)" : "" );
     }
     printf( "    - fragmentation %10.5f%%\n", total_free_blocks == 0 ? 100.f : (double)( total_free_blocks - largest_block ) / (double)total_free_blocks );
   }
+
+  LockRelease( free_list, &free_list->m_LargeLock );
+  for( uint32_t ilvl = free_list->m_LevelCount; ilvl > 0; ilvl-- )
+  {
+    LockRelease( free_list, &free_list->m_LevelLocks[ilvl - 1] );
+  }
+}
+
+bool HeapGetStats( uint32_t thread_id, struct HeapStats* stats )
+{
+  struct MemoryData* mem_data = FindMemoryData( thread_id == k_HeapThreadAuto ? s_BoundThreadId : thread_id );
+  if( mem_data == NULL || !mem_data->m_Valid )
+  {
+    return false;
+  }
+
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  memset( stats, 0, sizeof( struct HeapStats ) );
+  stats->m_LevelCount = free_list->m_LevelCount;
+
+  // only the heap's own fields are read ( no extent nodes || large mappings ), so a segment || cached region
+  // going away under a reader is harmless
+  for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+  {
+    struct HeapPartitionStats* level_stats = &stats->m_Levels[ilvl];
+
+    LockAcquire( free_list, &free_list->m_LevelLocks[ilvl] );
+    *level_stats           = free_list->m_Stats[ilvl];
+    level_stats->m_BinSize = free_list->m_PartitionLvlDetails[ilvl].m_BinSize;
+
+    for( uint32_t ipart = ilvl; ipart != INDEX_NONE; ipart = free_list->m_TrackerInfo[ipart].m_NextSegment )
+    {
+      const uint64_t bin_size = free_list->m_PartitionLvlDetails[ipart].m_BinSize;
+
+      uint64_t largest_bins;
+      if( ipart < free_list->m_SlabLvls )
+      {
+        const uint64_t free_slots = free_list->m_Slab[ipart].m_FreeSlots;
+
+        level_stats->m_FreeBytes       += free_slots * bin_size;
+        level_stats->m_FreeExtentCount += free_slots;
+        largest_bins                    = free_slots ? 1 : 0;
+      }
+      else
+      {
+        const struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[ipart];
+
+        level_stats->m_FreeBytes       += tracker_info->m_BinOccupancy * bin_size;
+        level_stats->m_FreeExtentCount += tracker_info->m_TrackedCount;
+        largest_bins                    = IndexLargestBins( free_list, ipart );
+      }
+
+      level_stats->m_SegmentCount      += ipart != ilvl;
+      level_stats->m_LargestFreeExtent  = largest_bins * bin_size > level_stats->m_LargestFreeExtent ? largest_bins * bin_size : level_stats->m_LargestFreeExtent;
+    }
+
+    // cached blocks are single bins w/ a header ( slab levels cache the blocks of their segments )
+    const uint64_t cached_count = free_list->m_Cache[ilvl].m_Count;
+    const uint64_t cached_size  = LevelSize( free_list, ilvl ) + s_BlockHeaderSize;
+
+    level_stats->m_FreeBytes         += cached_count * cached_size;
+    level_stats->m_FreeExtentCount   += cached_count;
+    level_stats->m_LargestFreeExtent  = cached_count && cached_size > level_stats->m_LargestFreeExtent ? cached_size : level_stats->m_LargestFreeExtent;
+    LockRelease( free_list, &free_list->m_LevelLocks[ilvl] );
+  }
+
+  struct HeapLargeList* large_list = &free_list->m_Large;
+
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  stats->m_Large                   = free_list->m_LargeStats;
+  stats->m_Large.m_FreeBytes       = large_list->m_CacheSize;
+  stats->m_Large.m_FreeExtentCount = large_list->m_CacheCount;
+  for( uint32_t islot = 0; islot < large_list->m_CacheCount; islot++ )
+  {
+    const uint64_t map_size            = large_list->m_CacheSizes[islot];
+    stats->m_Large.m_LargestFreeExtent = map_size > stats->m_Large.m_LargestFreeExtent ? map_size : stats->m_Large.m_LargestFreeExtent;
+  }
+  LockRelease( free_list, &free_list->m_LargeLock );
+
+  return true;
+}
+
+bool HeapTraceStart( const char* path )
+{
+#ifdef HEAP_TRACE
+  HeapTraceStop();
+
+  FILE* trace_file = fopen( path, "wb" );
+  if( trace_file == NULL )
+  {
+    return false;
+  }
+
+  // records are buffered in s_TraceBuffer, so writing them out never needs the allocator
+  setvbuf( trace_file, NULL, _IONBF, 0 );
+
+  const struct HeapTraceHeader header = { k_HeapTraceMagic, k_HeapTraceVersion, (uint32_t)sizeof( struct HeapTraceRecord ), 0 };
+  if( fwrite( &header, sizeof( header ), 1, trace_file ) != 1 )
+  {
+    fclose( trace_file );
+    return false;
+  }
+
+  TicketAcquire( &s_TraceLock );
+  s_TraceStartNs = GetTimeNs();
+  s_TraceCount   = 0;
+  AtomicExchangePtr( (void**)&s_TraceFile, trace_file );
+  TicketRelease( &s_TraceLock );
+  return true;
+#else
+  (void)path;
+  return false;
+#endif // HEAP_TRACE
+}
+
+void HeapTraceStop()
+{
+#ifdef HEAP_TRACE
+  TicketAcquire( &s_TraceLock );
+  FILE* trace_file = (FILE*)AtomicExchangePtr( (void**)&s_TraceFile, NULL );
+  if( trace_file )
+  {
+    TraceFlush( trace_file );
+  }
+  TicketRelease( &s_TraceLock );
+
+  if( trace_file )
+  {
+    fclose( trace_file );
+  }
+#endif // HEAP_TRACE
 }
 
 struct ByteFormat TranslateByteFormat( uint64_t size, uint8_t byte_type )
@@ -528,13 +1581,13 @@ struct ByteFormat TranslateByteFormat( uint64_t size, uint8_t byte_type )
 
   if( byte_type == k_FormatByte )
   {
-    if( size > 1024 && size < 1048576 )
+    if( size >= 1024 && size < 1048576 )
     {
       bf.m_Size = size / 1024.f;
       bf.m_Type = "kB";
       return bf;
     }
-    else if( size > 1048576 )
+    else if( size >= 1048576 )
     {
       bf.m_Size = size / 1048576.f;
       bf.m_Type = "mB";
@@ -564,29 +1617,2527 @@ struct ByteFormat TranslateByteFormat( uint64_t size, uint8_t byte_type )
 //***********************************************************************************************
 //***********************************************************************************************
 
-// Size of partition is restricted by 2 factors: freelist tracker && block header
-// * Each bin in the partition must support a blockheader
-// * Each bin in the partition must be possibly represented by a tracker in the free list
-static struct HeapPartitionData GetPartition( const uint64_t total_size, uint16_t bin_size, float percentage )
+static struct MemoryData* FindMemoryData( uint32_t thread_id )
 {
-  struct HeapPartitionData part_output = { 0 };
+  if( thread_id / HEAP_REGISTRY_CHUNK_SIZE >= HEAP_REGISTRY_MAX_CHUNKS )
+  {
+    return NULL;
+  }
 
-  uint64_t fixed_part_size = CalcAllignedAllocSize( (uint32_t)( (double)total_size * (double)percentage ), BASE_ALIGN );
+  struct MemoryData* chunk = (struct MemoryData*)AtomicLoadPtr( (void**)&s_MemoryDataChunks[thread_id / HEAP_REGISTRY_CHUNK_SIZE] );
+  return chunk ? &chunk[thread_id % HEAP_REGISTRY_CHUNK_SIZE] : NULL;
+}
 
-  part_output.m_BinSize  = bin_size + s_BlockHeaderSize;
-  // m_BinCount calculation : s_BlockHeaderSize is added to the denominator because each bin needs
-  // a corresponding tracker in the free list. This calculation saves space for the resulting free
-  // list tracking array
-  part_output.m_BinCount = fixed_part_size / ( part_output.m_BinSize + s_BlockHeaderSize ); 
-  part_output.m_Size     = part_output.m_BinCount * part_output.m_BinSize;
+// Creates the registry chunk holding thread_id on first use
+static struct MemoryData* GetMemoryData( uint32_t thread_id )
+{
+  ASSERT_F( thread_id / HEAP_REGISTRY_CHUNK_SIZE < HEAP_REGISTRY_MAX_CHUNKS, "Thread id exceeds heap registry : %u", thread_id );
 
-  return part_output;
+  struct MemoryData** chunk_slot = &s_MemoryDataChunks[thread_id / HEAP_REGISTRY_CHUNK_SIZE];
+  struct MemoryData*  chunk      = (struct MemoryData*)AtomicLoadPtr( (void**)chunk_slot );
+
+  if( chunk == NULL )
+  {
+    struct MemoryData* new_chunk = (struct MemoryData*)VirtualAllocate( HEAP_REGISTRY_CHUNK_SIZE * sizeof( struct MemoryData ) );
+    ASSERT_F( new_chunk, "Failed to grow heap registry" );
+
+    if( AtomicCasPtr( (void**)chunk_slot, NULL, new_chunk ) )
+    {
+      chunk = new_chunk;
+    }
+    else // another thread published the chunk first
+    {
+      VirtualRelease( new_chunk, HEAP_REGISTRY_CHUNK_SIZE * sizeof( struct MemoryData ) );
+      chunk = (struct MemoryData*)AtomicLoadPtr( (void**)chunk_slot );
+    }
+  }
+  return &chunk[thread_id % HEAP_REGISTRY_CHUNK_SIZE];
 }
 
-static uint64_t CalcAllignedAllocSize( uint64_t input, uint32_t alignment )
+static bool OwnsPointer( const struct MemoryData* mem_data, const void* data_ptr )
 {
-  const uint32_t remainder = input % alignment;
-  input += remainder ? alignment : 0;
+  return (const unsigned char*)data_ptr >= (const unsigned char*)mem_data->m_MemBlock &&
+         (const unsigned char*)data_ptr <  (const unsigned char*)mem_data->m_MemBlock + mem_data->m_MemSize;
+}
 
-  return input;
+// Heap whose base block holds data_ptr ( NULL if none does ). The granule of a heap's last bytes may
+// also hold other mappings, hence the range check
+static struct MemoryData* FindOwner( const void* data_ptr )
+{
+  const uintptr_t granule = (uintptr_t)data_ptr >> OWNER_GRANULE_BITS;
+  if( ( granule >> OWNER_LEAF_BITS ) >= OWNER_ROOT_SIZE )
+  {
+    return NULL;
+  }
+
+  struct MemoryData** leaf  = (struct MemoryData**)AtomicLoadPtr( (void**)&s_OwnerLeaves[granule >> OWNER_LEAF_BITS] );
+  struct MemoryData*  owner = leaf ? (struct MemoryData*)AtomicLoadPtr( (void**)&leaf[granule & ( ( 0x1 << OWNER_LEAF_BITS ) - 1 )] ) : NULL;
+
+  return owner && owner->m_Valid && OwnsPointer( owner, data_ptr ) ? owner : NULL;
+}
+
+// Points every granule of the range at owner ( NULL clears them ), creating leaves on first use
+static void MapOwner( const void* range_ptr, uint64_t range_size, struct MemoryData* owner )
+{
+  const uintptr_t first_granule = (uintptr_t)range_ptr >> OWNER_GRANULE_BITS;
+  const uintptr_t last_granule  = ( (uintptr_t)range_ptr + range_size - 1 ) >> OWNER_GRANULE_BITS;
+
+  ASSERT_F( ( last_granule >> OWNER_LEAF_BITS ) < OWNER_ROOT_SIZE, "Heap past the owner map : %p", range_ptr );
+
+  for( uintptr_t igranule = first_granule; igranule <= last_granule && ( igranule >> OWNER_LEAF_BITS ) < OWNER_ROOT_SIZE; igranule++ )
+  {
+    struct MemoryData*** leaf_slot = &s_OwnerLeaves[igranule >> OWNER_LEAF_BITS];
+    struct MemoryData**  leaf      = (struct MemoryData**)AtomicLoadPtr( (void**)leaf_slot );
+
+    if( leaf == NULL )
+    {
+      struct MemoryData** new_leaf = (struct MemoryData**)VirtualAllocate( ( (uint64_t)0x1 << OWNER_LEAF_BITS ) * sizeof( struct MemoryData* ) );
+      ASSERT_F( new_leaf, "Failed to grow the owner map" );
+
+      if( AtomicCasPtr( (void**)leaf_slot, NULL, new_leaf ) )
+      {
+        leaf = new_leaf;
+      }
+      else // another heap published the leaf first
+      {
+        VirtualRelease( new_leaf, ( (uint64_t)0x1 << OWNER_LEAF_BITS ) * sizeof( struct MemoryData* ) );
+        leaf = (struct MemoryData**)AtomicLoadPtr( (void**)leaf_slot );
+      }
+    }
+    AtomicExchangePtr( (void**)&leaf[igranule & ( ( 0x1 << OWNER_LEAF_BITS ) - 1 )], owner );
+  }
+}
+
+// Heap that handed out data_ptr, mem_data is the calling heap ( || NULL ). Its own range covers most
+// releases && its slab slots. The header is only read once the owner map rules out other heaps' base
+// blocks, their slab slots have none ( && the bytes in front may not be committed )
+static struct MemoryData* FindBlockOwner( struct MemoryData* mem_data, void* data_ptr )
+{
+  if( mem_data && OwnsPointer( mem_data, data_ptr ) )
+  {
+    return mem_data;
+  }
+
+  struct MemoryData* base_owner = FindOwner( data_ptr );
+  if( base_owner )
+  {
+    return base_owner;
+  }
+
+  const uint32_t part_idx = (uint32_t)EXTRACT_PART( ( (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize ) )->m_BHIndexNPartition );
+
+  if( part_idx == k_HeapBlockPartitionMask )
+  {
+    return (struct MemoryData*)GetLargeBlock( data_ptr )->m_Owner;
+  }
+  if( part_idx >= k_HeapNumLvl )
+  {
+    return ( (struct HeapSegment*)( (uintptr_t)data_ptr & ~( (uintptr_t)HEAP_SEGMENT_SIZE - 1 ) ) )->m_Owner;
+  }
+  return NULL;
+}
+
+// k_HeapThreadAuto : calling thread gets its own heap (w/ HeapSetAutoInit() && HeapSetAutoConfig() settings) on first use
+static uint32_t ResolveThreadId( uint32_t thread_id )
+{
+  if( thread_id != k_HeapThreadAuto )
+  {
+    return thread_id;
+  }
+
+  if( s_BoundThreadId == k_HeapThreadAuto )
+  {
+    thread_id = BindThread( true );
+    if( !FindMemoryData( thread_id ) || !FindMemoryData( thread_id )->m_Valid )
+    {
+      HeapInitBaseConfig( s_AutoInitSize, s_AutoInitFlags, s_AutoInitCustom ? &s_AutoInitConfig : NULL, thread_id );
+    }
+    RegisterThreadExit( thread_id );
+  }
+  return s_BoundThreadId;
+}
+
+// Hands the calling thread the heap of an exited thread, || a new id once there's none left
+static uint32_t BindThread( bool adopt )
+{
+  TicketAcquire( &s_ThreadIdLock );
+  uint32_t* id_list   = adopt && s_AdoptedThreadIds != k_HeapThreadAuto ? &s_AdoptedThreadIds : &s_ReleasedThreadIds;
+  uint32_t  thread_id = *id_list;
+  if( thread_id != k_HeapThreadAuto )
+  {
+    *id_list = FindMemoryData( thread_id )->m_NextThreadId;
+  }
+  TicketRelease( &s_ThreadIdLock );
+
+  s_BoundThreadId = thread_id != k_HeapThreadAuto ? thread_id : AtomicFetchAdd32( &s_NextAutoThreadId, 1 );
+  return s_BoundThreadId;
+}
+
+// Thread exit hook of auto-bound heaps. A heap w/o blocks is released, one w/ blocks other threads
+// still hold is parked ( purged ) until the next thread adopts it, releases to it queue up meanwhile
+static void UnbindThread( uint32_t thread_id )
+{
+  struct MemoryData* mem_data = FindMemoryData( thread_id );
+  if( s_BoundThreadId != thread_id || mem_data == NULL )
+  {
+    return;
+  }
+  s_BoundThreadId = k_HeapThreadAuto; // requests made later in the thread's exit bind another heap
+
+  bool holds_blocks = false;
+  if( mem_data->m_Valid )
+  {
+    HeapFlushCache( thread_id );
+
+    const struct HeapFreeList* free_list = &mem_data->m_FreeList;
+    holds_blocks = free_list->m_LargeStats.m_Allocs != free_list->m_LargeStats.m_Frees;
+    for( uint32_t ilvl = 0; ilvl < free_list->m_LevelCount; ilvl++ )
+    {
+      holds_blocks = holds_blocks || free_list->m_Stats[ilvl].m_Allocs != free_list->m_Stats[ilvl].m_Frees;
+    }
+
+    if( holds_blocks )
+    {
+      HeapPurge( thread_id );
+    }
+    else
+    {
+      ReleaseHeap( mem_data );
+    }
+  }
+
+  TicketAcquire( &s_ThreadIdLock );
+  uint32_t* id_list        = holds_blocks ? &s_AdoptedThreadIds : &s_ReleasedThreadIds;
+  mem_data->m_NextThreadId = *id_list;
+  *id_list                 = thread_id;
+  TicketRelease( &s_ThreadIdLock );
+}
+
+#ifdef _WIN32
+static void WINAPI OnThreadExit( void* key_value )
+{
+  UnbindThread( (uint32_t)( (uintptr_t)key_value - 1 ) );
+}
+
+static BOOL WINAPI CreateThreadExitKey( INIT_ONCE* init_once, void* param, void** context )
+{
+  (void)init_once;
+  (void)param;
+  (void)context;
+  s_ThreadExitKey = FlsAlloc( OnThreadExit );
+  return TRUE;
+}
+#else
+static void OnThreadExit( void* key_value )
+{
+  UnbindThread( (uint32_t)( (uintptr_t)key_value - 1 ) );
+}
+
+static void CreateThreadExitKey()
+{
+  pthread_key_create( &s_ThreadExitKey, OnThreadExit );
+}
+#endif
+
+// Key value is the id + 1, a null value has no destructor call
+static void RegisterThreadExit( uint32_t thread_id )
+{
+#ifdef _WIN32
+  InitOnceExecuteOnce( &s_ThreadExitOnce, CreateThreadExitKey, NULL, NULL );
+  FlsSetValue( s_ThreadExitKey, (void*)( (uintptr_t)thread_id + 1 ) );
+#else
+  pthread_once( &s_ThreadExitOnce, CreateThreadExitKey );
+  pthread_setspecific( s_ThreadExitKey, (void*)( (uintptr_t)thread_id + 1 ) );
+#endif
+}
+
+// Unmaps the heap, segments && large mappings included
+static void ReleaseHeap( struct MemoryData* mem_data )
+{
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  mem_data->m_Valid = false;
+  for( uint32_t ipart = k_HeapNumLvl; ipart < k_HeapMaxPartitions; ipart++ )
+  {
+    if( free_list->m_PartitionLvls[ipart] )
+    {
+      VirtualRelease( (void*)( (uintptr_t)free_list->m_PartitionLvls[ipart] & ~( (uintptr_t)HEAP_SEGMENT_SIZE - 1 ) ), HEAP_SEGMENT_SIZE );
+      free_list->m_PartitionLvls[ipart] = NULL;
+    }
+  }
+
+  LargeCacheTrim( &free_list->m_Large, 0, 0 );
+  while( free_list->m_Large.m_Head )
+  {
+    struct HeapLargeBlock* large = free_list->m_Large.m_Head;
+    free_list->m_Large.m_Head    = large->m_Next;
+    VirtualRelease( large, large->m_MapSize );
+  }
+
+  if( mem_data->m_MemBlock )
+  {
+    MapOwner( mem_data->m_MemBlock, mem_data->m_MemSize, NULL );
+    VirtualRelease( mem_data->m_MemBlock, mem_data->m_MemSize );
+  }
+  mem_data->m_MemBlock    = NULL;
+  mem_data->m_MemSize     = 0;
+  mem_data->m_RemoteFrees = NULL;
+}
+
+// Simple heuristic : find best-fit heap partition
+// Strict heuristic : Attempt to allocate using specified heap buckets (choose largest of specified buckets)
+static uint32_t SelectLevel( const struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t bucket_hint )
+{
+  const uint32_t level_hints = bucket_hint & ( k_HeapLevel5 | ( k_HeapLevel5 - k_HeapLevel0 ) );
+  if( ( bucket_hint & k_HeapHintStrictSize ) && level_hints )
+  {
+    // level bits are power of two sizes, which always start a class
+    alloc_size = (uint64_t)1 << BitScanHigh64( level_hints );
+  }
+
+  uint32_t chosen_bucket_idx = 0;
+
+  if( free_list->m_CustomLevels )
+  {
+    // 1st level that holds alloc_size, the last one takes anything larger
+    uint32_t low  = 0;
+    uint32_t high = free_list->m_LevelCount - 1;
+    while( low < high )
+    {
+      const uint32_t mid = ( low + high ) / 2;
+      low  = free_list->m_LevelSizes[mid] < alloc_size ? mid + 1 : low;
+      high = free_list->m_LevelSizes[mid] < alloc_size ? high : mid;
+    }
+    chosen_bucket_idx = low;
+  }
+  else if( alloc_size > BASE_BUCKET )
+  {
+    // alloc_size is in ( 2^range, 2^(range + 1) ], the step picks one of the evenly spaced classes in it
+    const uint32_t range = BitScanHigh64( alloc_size - 1 );
+    const uint64_t step  = ( alloc_size - 1 - ( (uint64_t)1 << range ) ) >> ( range - k_HeapClassStepBits );
+
+    chosen_bucket_idx = range < HEAP_CLASS_MAX_LOG2 ? 1 + ( ( range - 5 ) << k_HeapClassStepBits ) + (uint32_t)step : k_HeapNumLvl - 1;
+  }
+  return chosen_bucket_idx;
+}
+
+// Bytes held by a bin of the level ( header excluded )
+static uint32_t LevelSize( const struct HeapFreeList* free_list, uint32_t level_idx )
+{
+  return free_list->m_LevelSizes[level_idx];
+}
+
+// Level sizes w/o a HeapConfig
+static uint32_t DefaultLevelSize( uint32_t level_idx )
+{
+  if( level_idx == 0 )
+  {
+    return BASE_BUCKET;
+  }
+
+  const uint32_t range = 5 + ( ( level_idx - 1 ) >> k_HeapClassStepBits );
+  const uint32_t step  = ( ( level_idx - 1 ) & ( ( 1 << k_HeapClassStepBits ) - 1 ) ) + 1;
+
+  return ( 1u << range ) + ( step << ( range - k_HeapClassStepBits ) );
+}
+
+// Weight of the level in the partition scheme. Each power of two range gets the weight the single level
+// used to have, split between its classes
+static uint32_t DefaultLevelShare( uint32_t level_idx )
+{
+  const uint32_t range  = level_idx == 0 ? 0 : 1 + ( ( level_idx - 1 ) >> k_HeapClassStepBits );
+  const uint32_t weight = 5 * ( range + 1 ) < 25 ? 5 * ( range + 1 ) : 25;
+
+  return level_idx == 0 ? weight * ( 1 << k_HeapClassStepBits ) : weight;
+}
+
+// Default thread cache high water mark, smaller classes keep more blocks
+static uint32_t LevelCacheHighWater( uint32_t level_size )
+{
+  return level_size <= 64 ? 128 : ( level_size <= 256 ? 64 : ( level_size <= 1024 ? 32 : 16 ) );
+}
+
+// Bins needed at a level, including room for the header
+static uint64_t CalcBinCount( const struct HeapFreeList* free_list, uint64_t alloc_size, uint32_t level_idx )
+{
+  const uint32_t heap_bin = LevelSize( free_list, level_idx ) + s_BlockHeaderSize;
+
+  return ( alloc_size + s_BlockHeaderSize ) / heap_bin + ( ( alloc_size + s_BlockHeaderSize ) % heap_bin ? 1 : 0 );
+}
+
+// Release a block owned by this heap. Single bin blocks go to the thread cache as is, older half is
+// flushed once the level is full
+static void ReleaseLocal( struct HeapFreeList* free_list, void* data_ptr )
+{
+  // slab slots have no header, check their address range before anything reads one
+  const uint32_t slab_level = FindSlabLevel( free_list, data_ptr );
+  if( slab_level < k_HeapSlabLvls )
+  {
+    LockAcquire( free_list, &free_list->m_LevelLocks[slab_level] );
+    StatsRelease( &free_list->m_Stats[slab_level], 1, LevelSize( free_list, slab_level ) );
+    SlabRelease( free_list, slab_level, data_ptr );
+    LockRelease( free_list, &free_list->m_LevelLocks[slab_level] );
+    return;
+  }
+
+  ReleaseBlock( free_list, data_ptr );
+}
+
+// Block w/ a header : large mapping, cache || tracker
+static void ReleaseBlock( struct HeapFreeList* free_list, void* data_ptr )
+{
+  if( IsLargeBlock( data_ptr ) )
+  {
+    LargeRelease( free_list, GetLargeBlock( data_ptr ) );
+    return;
+  }
+
+  data_ptr = UnshiftBlock( free_list, data_ptr );
+
+  struct HeapBlockHeader* header    = (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+  const uint32_t          level_idx = free_list->m_PartitionLvlDetails[EXTRACT_PART( header->m_BHIndexNPartition )].m_Level;
+  struct HeapCacheBin*    cache     = &free_list->m_Cache[level_idx];
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+  StatsRelease( &free_list->m_Stats[level_idx], 1, BlockBytes( free_list, data_ptr ) );
+  if( header->m_BHAllocCount == 1 && cache->m_HighWater )
+  {
+    if( cache->m_Count >= cache->m_HighWater )
+    {
+      CacheFlush( free_list, level_idx, cache->m_HighWater > 1 ? cache->m_HighWater / 2 : 1 );
+    }
+
+    *(void**)data_ptr = cache->m_Head;
+    cache->m_Head     = data_ptr;
+    cache->m_Count++;
+  }
+  else
+  {
+    ReleaseToTracker( free_list, data_ptr );
+  }
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+}
+
+// Grows the block into the free extent right after it || hands its tail back. Fails when the bins after it
+// are taken or the new size belongs to the other allocation path ( large vs partitions )
+static bool ResizeInPlace( struct HeapFreeList* free_list, void* data_ptr, uint64_t byte_size )
+{
+  const uint64_t aligned_alloc = CalcAllignedAllocSize( byte_size, BASE_ALIGN );
+  const bool     wants_large   = free_list->m_Large.m_Threshold && aligned_alloc >= free_list->m_Large.m_Threshold;
+
+  const uint32_t slab_level = FindSlabLevel( free_list, data_ptr );
+  if( slab_level < k_HeapSlabLvls )
+  {
+    return aligned_alloc <= LevelSize( free_list, slab_level );
+  }
+
+  if( IsLargeBlock( data_ptr ) )
+  {
+    // the mapping only shrinks, its slack is kept
+    return wants_large && aligned_alloc <= HeapUsableSize( data_ptr );
+  }
+  if( wants_large )
+  {
+    return false;
+  }
+
+  const struct HeapBlockHeader* header    = (const struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+  const uint32_t                level_idx = free_list->m_PartitionLvlDetails[EXTRACT_PART( header->m_BHIndexNPartition )].m_Level;
+
+  LockAcquire( free_list, &free_list->m_LevelLocks[level_idx] );
+  const bool resized = ResizeRun( free_list, data_ptr, aligned_alloc );
+  LockRelease( free_list, &free_list->m_LevelLocks[level_idx] );
+
+  return resized;
+}
+
+// Partition run of ResizeInPlace, level lock held
+static bool ResizeRun( struct HeapFreeList* free_list, void* data_ptr, uint64_t aligned_alloc )
+{
+  struct HeapBlockHeader* header    = (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+  const uint32_t          part_idx  = (uint32_t)EXTRACT_PART( header->m_BHIndexNPartition );
+  const uint64_t          block_idx = EXTRACT_IDX( header->m_BHIndexNPartition );
+  const uint64_t          bin_count = header->m_BHAllocCount;
+  const uint64_t          bin_size  = free_list->m_PartitionLvlDetails[part_idx].m_BinSize;
+
+  // aligned blocks start past the 1st header, those bytes stay part of the run
+  const uint64_t data_offset = (uint64_t)( (unsigned char*)data_ptr - GetBlockStart( free_list, header ) );
+  const uint64_t new_bins    = ( data_offset + aligned_alloc + bin_size - 1 ) / bin_size;
+
+  struct HeapPartitionStats* stats = &free_list->m_Stats[free_list->m_PartitionLvlDetails[part_idx].m_Level];
+  if( new_bins < bin_count )
+  {
+    StatsRelease( stats, 0, ( bin_count - new_bins ) * bin_size );
+    header->m_BHAllocCount = new_bins;
+    ReturnFreeBins( free_list, part_idx, block_idx + new_bins, bin_count - new_bins );
+    return true;
+  }
+  if( new_bins == bin_count )
+  {
+    return true;
+  }
+
+  // the free extent has to start right where the block ends
+  const uint64_t next_idx = block_idx + bin_count;
+  uint64_t       selected_idx;
+  uint64_t       free_bins;
+  if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+  {
+    uint64_t left_idx;
+    TreeFindNeighbours( free_list, part_idx, next_idx, &left_idx, &selected_idx );
+    if( selected_idx != next_idx )
+    {
+      return false;
+    }
+    free_bins = GetFreeNode( free_list, part_idx, selected_idx )->m_Bins;
+  }
+  else
+  {
+    struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+
+    selected_idx = FindTrackerSlot( tracker_info->m_TrackerSlice, tracker_info->m_TrackedCount, next_idx );
+    if( selected_idx == tracker_info->m_TrackedCount || EXTRACT_IDX( tracker_info->m_TrackerSlice[selected_idx].m_BHIndexNPartition ) != next_idx )
+    {
+      return false;
+    }
+    free_bins = tracker_info->m_TrackerSlice[selected_idx].m_BHAllocCount;
+  }
+
+  if( free_bins < new_bins - bin_count )
+  {
+    return false;
+  }
+
+  if( TakeFreeBins( free_list, part_idx, selected_idx, new_bins - bin_count ) == INDEX_NONE )
+  {
+    return false;
+  }
+  StatsAlloc( stats, 0, ( new_bins - bin_count ) * bin_size );
+  header->m_BHAllocCount = new_bins;
+  return true;
+}
+
+// Aligned blocks hand out a pointer past the bin start : move their header copy back in front of the run
+static void* UnshiftBlock( struct HeapFreeList* free_list, void* data_ptr )
+{
+  struct HeapBlockHeader* header     = (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize );
+  unsigned char*          block_data = GetBlockStart( free_list, header ) + s_BlockHeaderSize;
+
+  if( block_data != data_ptr )
+  {
+    memmove( block_data - s_BlockHeaderSize, header, s_BlockHeaderSize );
+  }
+  return block_data;
+}
+
+// Orders blocks by partition, then block index
+static int CompareBlocks( const void* lhs, const void* rhs )
+{
+  const uint64_t lhs_bits = ( (const struct HeapBlockHeader*)( *(unsigned char* const*)lhs - s_BlockHeaderSize ) )->m_BHIndexNPartition;
+  const uint64_t rhs_bits = ( (const struct HeapBlockHeader*)( *(unsigned char* const*)rhs - s_BlockHeaderSize ) )->m_BHIndexNPartition;
+
+  if( EXTRACT_PART( lhs_bits ) != EXTRACT_PART( rhs_bits ) )
+  {
+    return EXTRACT_PART( lhs_bits ) < EXTRACT_PART( rhs_bits ) ? -1 : 1;
+  }
+  return lhs_bits < rhs_bits ? -1 : ( lhs_bits > rhs_bits ? 1 : 0 );
+}
+
+static unsigned char* GetBlockStart( struct HeapFreeList* free_list, const struct HeapBlockHeader* header )
+{
+  const uint32_t part_idx = (uint32_t)EXTRACT_PART( header->m_BHIndexNPartition );
+  return free_list->m_PartitionLvls[part_idx] + EXTRACT_IDX( header->m_BHIndexNPartition ) * free_list->m_PartitionLvlDetails[part_idx].m_BinSize;
+}
+
+static unsigned char* GetBlockEnd( struct HeapFreeList* free_list, const struct HeapBlockHeader* header )
+{
+  const uint32_t part_idx = (uint32_t)EXTRACT_PART( header->m_BHIndexNPartition );
+  return GetBlockStart( free_list, header ) + header->m_BHAllocCount * free_list->m_PartitionLvlDetails[part_idx].m_BinSize;
+}
+
+// Multiple producers push, only the owner pops (by taking the whole stack) so there's no ABA hazard
+static void PushRemoteFree( struct MemoryData* owner, void* data_ptr )
+{
+  void* head;
+  do
+  {
+    head              = AtomicLoadPtr( &owner->m_RemoteFrees );
+    *(void**)data_ptr = head;
+  } while( !AtomicCasPtr( &owner->m_RemoteFrees, head, data_ptr ) );
+}
+
+static void DrainRemoteFrees( struct MemoryData* mem_data )
+{
+  void* data_ptr = AtomicExchangePtr( &mem_data->m_RemoteFrees, NULL );
+
+  while( data_ptr )
+  {
+    void* next_ptr = *(void**)data_ptr;
+    ReleaseLocal( &mem_data->m_FreeList, data_ptr );
+    data_ptr = next_ptr;
+  }
+}
+
+static void ReleaseToTracker( struct HeapFreeList* free_list, void* data_ptr )
+{
+  struct HeapBlockHeader header = *( (struct HeapBlockHeader*)( (unsigned char*)data_ptr - s_BlockHeaderSize ) );
+
+  // clear marker/data once copied
+  memset( (unsigned char*)data_ptr - s_BlockHeaderSize, 0, s_BlockHeaderSize + 1 );
+
+  const uint32_t part_idx = (uint32_t)EXTRACT_PART( header.m_BHIndexNPartition );
+  ReturnFreeBins( free_list, part_idx, EXTRACT_IDX( header.m_BHIndexNPartition ), header.m_BHAllocCount );
+
+  // keep a single empty segment per level around to absorb the next burst
+  const uint32_t level_idx = free_list->m_PartitionLvlDetails[part_idx].m_Level;
+  if( part_idx >= k_HeapNumLvl && free_list->m_TrackerInfo[part_idx].m_BinOccupancy == free_list->m_PartitionLvlDetails[part_idx].m_BinCount )
+  {
+    TrimSegments( free_list, level_idx, 1 );
+  }
+
+  PurgeOnRelease( free_list, level_idx );
+}
+
+// Carve up to half the high water mark of single bin blocks out of one free extent (a single tracker
+// update), cache all but the 1st
+static void* CacheRefill( struct HeapFreeList* free_list, uint32_t level_idx )
+{
+  struct HeapCacheBin* cache    = &free_list->m_Cache[level_idx];
+  uint32_t             part_idx = level_idx;
+  const uint64_t       free_idx = LevelFindFit( free_list, level_idx, 1, &part_idx );
+  const uint32_t       bin_size = free_list->m_PartitionLvlDetails[part_idx].m_BinSize;
+
+  if( free_idx == INDEX_NONE )
+  {
+    return NULL;
+  }
+
+  uint64_t refill_count = cache->m_HighWater > 1 ? cache->m_HighWater / 2 : 1;
+  uint64_t free_bins    = GetFreeNode( free_list, part_idx, free_idx )->m_Bins;
+  refill_count          = refill_count < free_bins ? refill_count : free_bins;
+
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  const uint64_t          selected_idx = free_list->m_InitFlags & k_HeapInitTreeTracker ? free_idx : FindTrackerSlot( tracker_info->m_TrackerSlice, tracker_info->m_TrackedCount, free_idx );
+
+  const uint64_t block_idx = TakeFreeBins( free_list, part_idx, selected_idx, refill_count );
+  if( block_idx == INDEX_NONE )
+  {
+    return NULL;
+  }
+
+  unsigned char* bin_ptr = free_list->m_PartitionLvls[part_idx] + block_idx * bin_size;
+  for( uint64_t ibin = 0; ibin < refill_count; ibin++, bin_ptr += bin_size )
+  {
+    struct HeapBlockHeader* mem_marker = (struct HeapBlockHeader*)bin_ptr;
+    mem_marker->m_BHIndexNPartition    = SET_INDEX_PART( block_idx + ibin, part_idx );
+    mem_marker->m_BHAllocCount         = 1;
+
+    if( ibin )
+    {
+      *(void**)( bin_ptr + s_BlockHeaderSize ) = cache->m_Head;
+      cache->m_Head                            = bin_ptr + s_BlockHeaderSize;
+      cache->m_Count++;
+    }
+  }
+  return free_list->m_PartitionLvls[part_idx] + block_idx * bin_size + s_BlockHeaderSize;
+}
+
+// Hand the flush_count least recently cached blocks back to the tracker
+static void CacheFlush( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t flush_count )
+{
+  struct HeapCacheBin* cache = &free_list->m_Cache[level_idx];
+
+  flush_count = flush_count < cache->m_Count ? flush_count : cache->m_Count;
+  if( flush_count == 0 )
+  {
+    return;
+  }
+
+  // oldest blocks sit at the bottom of the stack
+  void** link = &cache->m_Head;
+  for( uint32_t ikeep = cache->m_Count - flush_count; ikeep > 0; ikeep-- )
+  {
+    link = (void**)*link;
+  }
+
+  void* flush_ptr = *link;
+  *link           = NULL;
+  cache->m_Count -= flush_count;
+
+  while( flush_ptr )
+  {
+    void* next_ptr = *(void**)flush_ptr;
+    ReleaseToTracker( free_list, flush_ptr );
+    flush_ptr = next_ptr;
+  }
+}
+
+// HeapGetStats counters, level || large lock held
+static void StatsAlloc( struct HeapPartitionStats* stats, uint64_t block_count, uint64_t byte_size )
+{
+  stats->m_Allocs    += block_count;
+  stats->m_LiveBytes += byte_size;
+  stats->m_PeakBytes  = stats->m_LiveBytes > stats->m_PeakBytes ? stats->m_LiveBytes : stats->m_PeakBytes;
+}
+
+static void StatsRelease( struct HeapPartitionStats* stats, uint64_t block_count, uint64_t byte_size )
+{
+  stats->m_Frees     += block_count;
+  stats->m_LiveBytes -= byte_size;
+}
+
+// query_status is the k_Query... result of the failed request. Enough free bins w/o an extent to hold them counts as fragmentation
+static void StatsFailed( struct HeapPartitionStats* stats, uint32_t query_status )
+{
+  if( query_status & k_QueryExcessFragmentation )
+  {
+    stats->m_FailedFragmentation++;
+  }
+  else
+  {
+    stats->m_FailedNoFreeSpace++;
+  }
+}
+
+// Bins of a block w/ a header, header included
+static uint64_t BlockBytes( const struct HeapFreeList* free_list, const void* data_ptr )
+{
+  const struct HeapBlockHeader* header = (const struct HeapBlockHeader*)( (const unsigned char*)data_ptr - s_BlockHeaderSize );
+  return header->m_BHAllocCount * free_list->m_PartitionLvlDetails[EXTRACT_PART( header->m_BHIndexNPartition )].m_BinSize;
+}
+
+// Size of partition is restricted by 2 factors: freelist tracker && block header
+// * Each bin in the partition must support a blockheader
+// * Each bin in the partition must be possibly represented by a tracker in the free list
+static struct HeapPartitionData GetPartition( const uint64_t total_size, uint32_t bin_size, float percentage )
+{
+  struct HeapPartitionData part_output = { 0 };
+
+  uint64_t fixed_part_size = CalcAllignedAllocSize( (uint64_t)( (double)total_size * (double)percentage ), BASE_ALIGN );
+
+  part_output.m_BinSize  = bin_size + s_BlockHeaderSize;
+  // m_BinCount calculation : s_BlockHeaderSize is added to the denominator because each bin needs
+  // a corresponding tracker in the free list. This calculation saves space for the resulting free
+  // list tracking array
+  part_output.m_BinCount = fixed_part_size / ( part_output.m_BinSize + s_BlockHeaderSize ); 
+  part_output.m_BinCount = part_output.m_BinCount ? part_output.m_BinCount : 1; // small heaps still get a bin per class
+  part_output.m_Size     = part_output.m_BinCount * part_output.m_BinSize;
+
+  return part_output;
+}
+
+static uint64_t CalcAllignedAllocSize( uint64_t input, uint32_t alignment )
+{
+  const uint32_t remainder = input % alignment;
+  input += remainder ? alignment - remainder : 0;
+
+  return input;
+}
+
+static void CoalesceSlot( struct HeapFreeList* free_list, uint32_t part_idx, struct HeapBlockHeader tracker_data[], uint64_t tracker_idx, uint64_t coalesce_idx, uint64_t coalesce_bins, const struct HeapFreeNode* state )
+{
+  const uint64_t base_idx = EXTRACT_IDX( tracker_data[tracker_idx].m_BHIndexNPartition );
+
+  IndexRemove( free_list, part_idx, base_idx );
+
+  tracker_data[tracker_idx].m_BHIndexNPartition  = SET_INDEX_PART( base_idx < coalesce_idx ? base_idx : coalesce_idx, part_idx );
+  tracker_data[tracker_idx].m_BHAllocCount      += coalesce_bins;
+  free_list->m_TrackerInfo[part_idx].m_BinOccupancy += coalesce_bins;
+
+  IndexInsert( free_list, part_idx, EXTRACT_IDX( tracker_data[tracker_idx].m_BHIndexNPartition ), tracker_data[tracker_idx].m_BHAllocCount, state );
+}
+
+static void InsertSlot( struct HeapFreeList* free_list, uint32_t part_idx, struct HeapBlockHeader tracker_data[], struct HeapBlockHeader* header, uint64_t tracker_idx )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+
+  if( tracker_idx < tracker_info->m_TrackedCount ) // shift then set
+  {
+    memmove( tracker_data + tracker_idx + 1, tracker_data + tracker_idx, s_BlockHeaderSize * ( tracker_info->m_TrackedCount - tracker_idx ) );
+  }
+  tracker_data[tracker_idx] = *header;
+
+  tracker_info->m_BinOccupancy += header->m_BHAllocCount;
+  tracker_info->m_TrackedCount++;
+
+  IndexInsert( free_list, part_idx, EXTRACT_IDX( header->m_BHIndexNPartition ), header->m_BHAllocCount, NULL );
+}
+
+// Sorted tracker array : carve bin_count bins off the front of the extent at position selected_idx
+static uint64_t ArrayTakeFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t selected_idx, uint64_t bin_count )
+{
+  struct HeapTrackerData* free_part_info = &free_list->m_TrackerInfo[part_idx];
+  struct HeapBlockHeader* free_slot      = free_part_info->m_TrackerSlice + selected_idx;
+  const uint64_t          free_slot_idx  = EXTRACT_IDX( free_slot->m_BHIndexNPartition );
+  
+  IndexRemove( free_list, part_idx, free_slot_idx );
+
+  // subtract & update || remove free slot from list
+  if( free_slot->m_BHAllocCount > bin_count )
+  {
+    free_slot->m_BHAllocCount     -= bin_count;
+    free_slot->m_BHIndexNPartition = SET_INDEX_PART( free_slot_idx + bin_count, part_idx );
+
+    // the remainder sits inside the same purged/idle range, so it keeps the extent's state
+    IndexInsert( free_list, part_idx, free_slot_idx + bin_count, free_slot->m_BHAllocCount, GetFreeNode( free_list, part_idx, free_slot_idx ) );
+  }
+  else
+  {
+    // find index of free_slot in the list
+    if( free_part_info->m_TrackedCount == 1 || ( selected_idx + 1 ) == free_part_info->m_TrackedCount )
+    {
+      memset( free_slot, 0, s_BlockHeaderSize );
+    }
+    else
+    {
+      memmove( free_slot, free_slot + 1, s_BlockHeaderSize * ( free_part_info->m_TrackedCount - ( selected_idx + 1 ) ) );
+    }
+    free_part_info->m_TrackedCount--;
+  }
+  free_part_info->m_BinOccupancy -= bin_count;
+
+  return free_slot_idx;
+}
+
+// Sorted tracker array : insert the run in block index order && coalesce w/ the extents it touches
+static void ArrayReturnFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t slot_idx, uint64_t slot_bins )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  struct HeapBlockHeader* tracker_data = tracker_info->m_TrackerSlice;
+  
+  // - use divide & conquer to find its spot in list
+  const uint64_t insert_idx = FindTrackerSlot( tracker_data, tracker_info->m_TrackedCount, slot_idx );
+
+  const bool touches_left  = insert_idx > 0 && 
+                             EXTRACT_IDX( tracker_data[insert_idx - 1].m_BHIndexNPartition ) + tracker_data[insert_idx - 1].m_BHAllocCount == slot_idx;
+  const bool touches_right = insert_idx < tracker_info->m_TrackedCount && 
+                             EXTRACT_IDX( tracker_data[insert_idx].m_BHIndexNPartition ) == slot_idx + slot_bins;
+
+  const uint64_t             left_idx   = touches_left ? EXTRACT_IDX( tracker_data[insert_idx - 1].m_BHIndexNPartition ) : INDEX_NONE;
+  const uint64_t             left_bins  = touches_left ? tracker_data[insert_idx - 1].m_BHAllocCount : 0;
+  const uint64_t             right_bins = touches_right ? tracker_data[insert_idx].m_BHAllocCount : 0;
+  const struct HeapFreeNode* state      = LargestFreePart( free_list, part_idx, left_idx, left_bins, slot_idx + slot_bins, right_bins, slot_bins );
+
+  if( touches_left && touches_right ) // coalesce both sides
+  {
+    IndexRemove( free_list, part_idx, slot_idx + slot_bins );
+    tracker_info->m_BinOccupancy -= right_bins; // re-added by CoalesceSlot
+
+    memmove( tracker_data + insert_idx, tracker_data + insert_idx + 1, s_BlockHeaderSize * ( tracker_info->m_TrackedCount - ( insert_idx + 1 ) ) );
+    tracker_info->m_TrackedCount--;
+
+    CoalesceSlot( free_list, part_idx, tracker_data, insert_idx - 1, slot_idx, slot_bins + right_bins, state );
+  }
+  else if( touches_left ) // coalesce left
+  {
+    CoalesceSlot( free_list, part_idx, tracker_data, insert_idx - 1, slot_idx, slot_bins, state );
+  }
+  else if( touches_right ) // coalesce right
+  {
+    CoalesceSlot( free_list, part_idx, tracker_data, insert_idx, slot_idx, slot_bins, state );
+  }
+  else // insert between left & right
+  {
+    struct HeapBlockHeader header;
+    header.m_BHIndexNPartition = SET_INDEX_PART( slot_idx, part_idx );
+    header.m_BHAllocCount      = slot_bins;
+
+    InsertSlot( free_list, part_idx, tracker_data, &header, insert_idx );
+  }
+}
+
+// Sorted tracker array : merge blocks sorted by block index into the tracker in one pass from the back,
+// coalescing as entries meet. Only extents that changed are re-indexed
+static void ArrayReturnBlocks( struct HeapFreeList* free_list, uint32_t part_idx, void* blocks[], uint32_t block_count )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  struct HeapBlockHeader* tracker_data = tracker_info->m_TrackerSlice;
+
+  // free extents && released blocks never overlap, so both fit in the slice
+  const uint64_t merged_end  = tracker_info->m_TrackedCount + block_count;
+  uint64_t       tracked_idx = tracker_info->m_TrackedCount;
+  uint32_t       block_idx   = block_count;
+  uint64_t       out_idx     = merged_end;
+  bool           out_changed = false;
+  uint64_t       freed_bins  = 0;
+
+  // state the entry being built keeps, from its largest part ( see LargestFreePart() )
+  const struct HeapFreeNode* out_state = NULL;
+  uint64_t                   out_bins  = 0;
+
+  while( tracked_idx || block_idx )
+  {
+    struct HeapBlockHeader next;
+    bool                   next_released = false;
+
+    const uint64_t* block_bits = block_idx ? &( (struct HeapBlockHeader*)( (unsigned char*)blocks[block_idx - 1] - s_BlockHeaderSize ) )->m_BHIndexNPartition : NULL;
+    if( block_bits && ( tracked_idx == 0 || EXTRACT_IDX( *block_bits ) > EXTRACT_IDX( tracker_data[tracked_idx - 1].m_BHIndexNPartition ) ) )
+    {
+      struct HeapBlockHeader* header = (struct HeapBlockHeader*)( (unsigned char*)blocks[--block_idx] - s_BlockHeaderSize );
+
+      next          = *header;
+      next_released = true;
+      freed_bins   += next.m_BHAllocCount;
+
+      // clear marker/data once copied
+      memset( header, 0, s_BlockHeaderSize + 1 );
+    }
+    else
+    {
+      next = tracker_data[--tracked_idx];
+    }
+
+    const uint64_t next_idx = EXTRACT_IDX( next.m_BHIndexNPartition );
+
+    struct HeapBlockHeader* out = &tracker_data[out_idx];
+    if( out_idx < merged_end && next_idx + next.m_BHAllocCount == EXTRACT_IDX( out->m_BHIndexNPartition ) ) // coalesce w/ the entry on the right
+    {
+      if( !out_changed )
+      {
+        IndexRemove( free_list, part_idx, EXTRACT_IDX( out->m_BHIndexNPartition ) );
+      }
+      if( !next_released )
+      {
+        IndexRemove( free_list, part_idx, next_idx );
+      }
+      if( next.m_BHAllocCount > out_bins )
+      {
+        out_state = next_released ? NULL : GetFreeNode( free_list, part_idx, next_idx );
+        out_bins  = next.m_BHAllocCount;
+      }
+      out->m_BHIndexNPartition  = SET_INDEX_PART( next_idx, part_idx );
+      out->m_BHAllocCount      += next.m_BHAllocCount;
+      out_changed               = true;
+      continue;
+    }
+
+    if( out_idx < merged_end && out_changed )
+    {
+      IndexInsert( free_list, part_idx, EXTRACT_IDX( out->m_BHIndexNPartition ), out->m_BHAllocCount, out_state );
+    }
+
+    out_idx--;
+    tracker_data[out_idx].m_BHIndexNPartition = SET_INDEX_PART( next_idx, part_idx );
+    tracker_data[out_idx].m_BHAllocCount      = next.m_BHAllocCount;
+    out_changed                               = next_released;
+    out_state                                 = next_released ? NULL : GetFreeNode( free_list, part_idx, next_idx );
+    out_bins                                  = next.m_BHAllocCount;
+  }
+
+  if( out_idx < merged_end && out_changed )
+  {
+    IndexInsert( free_list, part_idx, EXTRACT_IDX( tracker_data[out_idx].m_BHIndexNPartition ), tracker_data[out_idx].m_BHAllocCount, out_state );
+  }
+
+  tracker_info->m_TrackedCount   = merged_end - out_idx;
+  tracker_info->m_BinOccupancy  += freed_bins;
+  memmove( tracker_data, tracker_data + out_idx, s_BlockHeaderSize * tracker_info->m_TrackedCount );
+}
+
+// Red-black tree : carve bin_count bins off the front of the extent starting at block selected_idx
+static uint64_t TreeTakeFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t selected_idx, uint64_t bin_count )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  const uint64_t          free_bins    = GetFreeNode( free_list, part_idx, selected_idx )->m_Bins;
+
+  IndexRemove( free_list, part_idx, selected_idx );
+
+  if( free_bins > bin_count )
+  {
+    // remainder keeps its place in address order, so the node only has to move
+    TreeReplace( free_list, part_idx, selected_idx, selected_idx + bin_count );
+    IndexInsert( free_list, part_idx, selected_idx + bin_count, free_bins - bin_count, GetFreeNode( free_list, part_idx, selected_idx ) );
+  }
+  else
+  {
+    TreeRemove( free_list, part_idx, selected_idx );
+    tracker_info->m_TrackedCount--;
+  }
+  tracker_info->m_BinOccupancy -= bin_count;
+
+  return selected_idx;
+}
+
+// Red-black tree : coalesce w/ the neighbouring extents in address order || insert a new extent
+static void TreeReturnFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t slot_idx, uint64_t slot_bins )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+
+  uint64_t left_idx, right_idx;
+  TreeFindNeighbours( free_list, part_idx, slot_idx, &left_idx, &right_idx );
+
+  const uint64_t left_bins     = left_idx  != INDEX_NONE ? GetFreeNode( free_list, part_idx, left_idx )->m_Bins : 0;
+  const uint64_t right_bins    = right_idx != INDEX_NONE ? GetFreeNode( free_list, part_idx, right_idx )->m_Bins : 0;
+  const bool     touches_left  = left_idx  != INDEX_NONE && left_idx + left_bins == slot_idx;
+  const bool     touches_right = right_idx != INDEX_NONE && right_idx == slot_idx + slot_bins;
+
+  const struct HeapFreeNode* state = LargestFreePart( free_list, part_idx, left_idx, touches_left ? left_bins : 0, right_idx, touches_right ? right_bins : 0, slot_bins );
+
+  if( touches_left && touches_right ) // coalesce both sides
+  {
+    IndexRemove( free_list, part_idx, right_idx );
+    TreeRemove( free_list, part_idx, right_idx );
+    tracker_info->m_TrackedCount--;
+
+    IndexRemove( free_list, part_idx, left_idx );
+    IndexInsert( free_list, part_idx, left_idx, left_bins + slot_bins + right_bins, state );
+  }
+  else if( touches_left ) // coalesce left
+  {
+    IndexRemove( free_list, part_idx, left_idx );
+    IndexInsert( free_list, part_idx, left_idx, left_bins + slot_bins, state );
+  }
+  else if( touches_right ) // coalesce right
+  {
+    IndexRemove( free_list, part_idx, right_idx );
+    TreeReplace( free_list, part_idx, right_idx, slot_idx );
+    IndexInsert( free_list, part_idx, slot_idx, slot_bins + right_bins, state );
+  }
+  else // insert between left & right
+  {
+    IndexInsert( free_list, part_idx, slot_idx, slot_bins, NULL );
+    TreeInsert( free_list, part_idx, slot_idx );
+    tracker_info->m_TrackedCount++;
+  }
+  tracker_info->m_BinOccupancy += slot_bins;
+}
+
+// Removes bins from the free extent chosen by HeapCalcAllocPartitionAndSize(), returns block index of the 1st bin
+// ( INDEX_NONE w/o memory to back them, the extent is left untouched )
+static uint64_t TakeFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t selected_idx, uint64_t bin_count )
+{
+  const bool     use_tree  = ( free_list->m_InitFlags & k_HeapInitTreeTracker ) != 0;
+  const uint64_t block_idx = use_tree ? selected_idx : EXTRACT_IDX( free_list->m_TrackerInfo[part_idx].m_TrackerSlice[selected_idx].m_BHIndexNPartition );
+
+  // carving is the only way to reach untouched bins : back the taken bins && the node of the remainder
+  if( !CommitPartition( free_list, part_idx, ( block_idx + bin_count ) * free_list->m_PartitionLvlDetails[part_idx].m_BinSize + sizeof( struct HeapFreeNode ) ) )
+  {
+    return INDEX_NONE;
+  }
+
+  return use_tree ? TreeTakeFreeBins( free_list, part_idx, selected_idx, bin_count ) : ArrayTakeFreeBins( free_list, part_idx, selected_idx, bin_count );
+}
+
+// Hands a run of bins back to the free extents of the partition
+static void ReturnFreeBins( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t bin_count )
+{
+  if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+  {
+    TreeReturnFreeBins( free_list, part_idx, block_idx, bin_count );
+    return;
+  }
+  ArrayReturnFreeBins( free_list, part_idx, block_idx, bin_count );
+}
+
+// Walks free extents in block index order. Start w/ *cursor == INDEX_NONE
+static bool NextFreeExtent( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t* cursor, uint64_t* block_idx, uint64_t* bin_count )
+{
+  if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+  {
+    *cursor = *cursor == INDEX_NONE ? TreeFirst( free_list, part_idx ) : TreeNext( free_list, part_idx, *cursor );
+    if( *cursor == INDEX_NONE )
+    {
+      return false;
+    }
+    *block_idx = *cursor;
+    *bin_count = GetFreeNode( free_list, part_idx, *cursor )->m_Bins;
+    return true;
+  }
+
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+
+  *cursor = *cursor == INDEX_NONE ? 0 : *cursor + 1;
+  if( *cursor >= tracker_info->m_TrackedCount )
+  {
+    return false;
+  }
+
+  struct HeapBlockHeader* tracker = &tracker_info->m_TrackerSlice[*cursor];
+  *block_idx = EXTRACT_IDX( tracker->m_BHIndexNPartition );
+  *bin_count = tracker->m_BHAllocCount;
+  return true;
+}
+
+// Cursor for NextFreeExtent() that continues w/ the 1st free extent starting at || after block_idx
+static uint64_t SeekFreeExtent( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+  {
+    uint64_t left_idx, right_idx;
+    TreeFindNeighbours( free_list, part_idx, block_idx, &left_idx, &right_idx );
+    return left_idx;
+  }
+
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+
+  const uint64_t tracker_idx = FindTrackerSlot( tracker_info->m_TrackerSlice, tracker_info->m_TrackedCount, block_idx );
+  return tracker_idx ? tracker_idx - 1 : INDEX_NONE;
+}
+
+// Lower bound : position of the 1st tracked extent that doesn't start before block_idx
+static uint64_t FindTrackerSlot( const struct HeapBlockHeader tracker_data[], uint64_t tracked_count, uint64_t block_idx )
+{
+  uint64_t head = 0;
+  uint64_t tail = tracked_count;
+  while( head < tail )
+  {
+    const uint64_t pivot_idx = head + ( ( tail - head ) / 2 );
+
+    if( EXTRACT_IDX( tracker_data[pivot_idx].m_BHIndexNPartition ) < block_idx )
+    {
+      head = pivot_idx + 1;
+    }
+    else
+    {
+      tail = pivot_idx;
+    }
+  }
+  return head;
+}
+
+static struct HeapFreeNode* GetFreeNode( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  return (struct HeapFreeNode*)( free_list->m_PartitionLvls[part_idx] + block_idx * free_list->m_PartitionLvlDetails[part_idx].m_BinSize );
+}
+
+// Extents below k_HeapIndexSLCount bins map linearly, larger extents map to their power of two (first
+// level) && one of k_HeapIndexSLCount equal steps within it (second level)
+static void IndexMapping( uint64_t bin_count, uint32_t* fl_idx, uint32_t* sl_idx )
+{
+  if( bin_count < k_HeapIndexSLCount )
+  {
+    *fl_idx = 0;
+    *sl_idx = (uint32_t)bin_count;
+    return;
+  }
+
+  const uint32_t high_bit = BitScanHigh64( bin_count );
+
+  *fl_idx = high_bit - k_HeapIndexSLLog2 + 1;
+  *sl_idx = (uint32_t)( bin_count >> ( high_bit - k_HeapIndexSLLog2 ) ) ^ k_HeapIndexSLCount;
+}
+
+// state : node whose purge state && free tick the extent keeps ( it may be the extent's own ), NULL for freed bins
+static void IndexInsert( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t bin_count, const struct HeapFreeNode* state )
+{
+  struct HeapFreeIndex* index = &free_list->m_FreeIndex[part_idx];
+  struct HeapFreeNode*  node  = GetFreeNode( free_list, part_idx, block_idx );
+
+  const uint32_t purged    = state ? state->m_Purged : 0;
+  const uint32_t free_tick = state ? state->m_FreeTick : AtomicLoad32( &free_list->m_PurgeTick );
+
+  uint32_t fl_idx, sl_idx;
+  IndexMapping( bin_count, &fl_idx, &sl_idx );
+
+  node->m_Bins     = bin_count;
+  node->m_Prev     = INDEX_NONE;
+  node->m_Next     = index->m_Heads[fl_idx][sl_idx];
+  node->m_Purged   = purged;
+  node->m_FreeTick = free_tick;
+
+  if( node->m_Next != INDEX_NONE )
+  {
+    GetFreeNode( free_list, part_idx, node->m_Next )->m_Prev = (uint32_t)block_idx;
+  }
+
+  index->m_Heads[fl_idx][sl_idx]  = (uint32_t)block_idx;
+  index->m_SLBitmap[fl_idx]      |= 1u << sl_idx;
+  index->m_FLBitmap              |= 1u << fl_idx;
+}
+
+// A merge keeps the state of its largest part, so a purged extent isn't purged again for a small freed
+// neighbour. NULL when the freed bins are the largest part
+static const struct HeapFreeNode* LargestFreePart( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t left_idx, uint64_t left_bins, uint64_t right_idx, uint64_t right_bins, uint64_t slot_bins )
+{
+  if( slot_bins >= left_bins && slot_bins >= right_bins )
+  {
+    return NULL;
+  }
+  return GetFreeNode( free_list, part_idx, left_bins >= right_bins ? left_idx : right_idx );
+}
+
+static void IndexRemove( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  struct HeapFreeIndex* index = &free_list->m_FreeIndex[part_idx];
+  struct HeapFreeNode*  node  = GetFreeNode( free_list, part_idx, block_idx );
+
+  uint32_t fl_idx, sl_idx;
+  IndexMapping( node->m_Bins, &fl_idx, &sl_idx );
+
+  if( node->m_Next != INDEX_NONE )
+  {
+    GetFreeNode( free_list, part_idx, node->m_Next )->m_Prev = node->m_Prev;
+  }
+
+  if( node->m_Prev != INDEX_NONE )
+  {
+    GetFreeNode( free_list, part_idx, node->m_Prev )->m_Next = node->m_Next;
+    return;
+  }
+
+  index->m_Heads[fl_idx][sl_idx] = node->m_Next;
+  if( node->m_Next == INDEX_NONE )
+  {
+    index->m_SLBitmap[fl_idx] &= ~( 1u << sl_idx );
+    if( index->m_SLBitmap[fl_idx] == 0 )
+    {
+      index->m_FLBitmap &= ~( 1u << fl_idx );
+    }
+  }
+}
+
+// Smallest size of the top size class holding a free extent : a lower bound of the largest extent, at most
+// 1/8 below it ( exact below k_HeapIndexSLCount bins )
+static uint64_t IndexLargestBins( const struct HeapFreeList* free_list, uint32_t part_idx )
+{
+  const struct HeapFreeIndex* index = &free_list->m_FreeIndex[part_idx];
+  if( index->m_FLBitmap == 0 )
+  {
+    return 0;
+  }
+
+  const uint32_t fl_idx = BitScanHigh64( index->m_FLBitmap );
+  const uint32_t sl_idx = BitScanHigh64( index->m_SLBitmap[fl_idx] );
+  return fl_idx == 0 ? sl_idx : (uint64_t)( k_HeapIndexSLCount | sl_idx ) << ( fl_idx - 1 );
+}
+
+// Good fit : round the request up to the next size class so any extent found there is large enough,
+// only walk a size class list when the rounded class has nothing to offer
+static uint64_t IndexFindFit( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t bin_count )
+{
+  struct HeapFreeIndex* index = &free_list->m_FreeIndex[part_idx];
+
+  uint64_t rounded_count = bin_count;
+  if( bin_count >= k_HeapIndexSLCount )
+  {
+    rounded_count += ( (uint64_t)1 << ( BitScanHigh64( bin_count ) - k_HeapIndexSLLog2 ) ) - 1;
+  }
+
+  uint32_t fl_idx, sl_idx;
+  IndexMapping( rounded_count, &fl_idx, &sl_idx );
+
+  if( fl_idx < k_HeapIndexFLCount )
+  {
+    uint32_t sl_map = index->m_SLBitmap[fl_idx] & ( ~0u << sl_idx );
+    if( sl_map == 0 )
+    {
+      const uint32_t fl_map = fl_idx + 1 < k_HeapIndexFLCount ? index->m_FLBitmap & ( ~0u << ( fl_idx + 1 ) ) : 0;
+      if( fl_map )
+      {
+        fl_idx = BitScanLow32( fl_map );
+        sl_map = index->m_SLBitmap[fl_idx];
+      }
+    }
+
+    if( sl_map )
+    {
+      return index->m_Heads[fl_idx][BitScanLow32( sl_map )];
+    }
+  }
+
+  // extents in the request's own size class may still be large enough
+  IndexMapping( bin_count, &fl_idx, &sl_idx );
+
+  for( uint32_t block_idx = index->m_Heads[fl_idx][sl_idx]; block_idx != INDEX_NONE; )
+  {
+    struct HeapFreeNode* node = GetFreeNode( free_list, part_idx, block_idx );
+    if( node->m_Bins >= bin_count )
+    {
+      return block_idx;
+    }
+    block_idx = node->m_Next;
+  }
+  return INDEX_NONE;
+}
+
+// Red-black tree over the free extents of a partition, keyed by block index. Links are block indices
+// && INDEX_NONE stands in for the (black) nil leaf
+
+#define TREE_NODE( BLOCK_IDX ) GetFreeNode( free_list, part_idx, BLOCK_IDX )
+
+#define TREE_IS_RED( BLOCK_IDX ) ( ( BLOCK_IDX ) != INDEX_NONE && TREE_NODE( BLOCK_IDX )->m_Red )
+
+static void TreeSetChild( struct HeapFreeList* free_list, uint32_t part_idx, uint32_t parent_idx, uint32_t old_child, uint32_t new_child )
+{
+  if( parent_idx == INDEX_NONE )
+  {
+    free_list->m_TrackerInfo[part_idx].m_TreeRoot = new_child;
+  }
+  else if( TREE_NODE( parent_idx )->m_Left == old_child )
+  {
+    TREE_NODE( parent_idx )->m_Left = new_child;
+  }
+  else
+  {
+    TREE_NODE( parent_idx )->m_Right = new_child;
+  }
+
+  if( new_child != INDEX_NONE )
+  {
+    TREE_NODE( new_child )->m_Parent = parent_idx;
+  }
+}
+
+static void TreeRotateLeft( struct HeapFreeList* free_list, uint32_t part_idx, uint32_t node_idx )
+{
+  struct HeapFreeNode* node      = TREE_NODE( node_idx );
+  const uint32_t       pivot_idx = node->m_Right;
+  struct HeapFreeNode* pivot     = TREE_NODE( pivot_idx );
+
+  node->m_Right = pivot->m_Left;
+  if( pivot->m_Left != INDEX_NONE )
+  {
+    TREE_NODE( pivot->m_Left )->m_Parent = node_idx;
+  }
+  TreeSetChild( free_list, part_idx, node->m_Parent, node_idx, pivot_idx );
+
+  pivot->m_Left  = node_idx;
+  node->m_Parent = pivot_idx;
+}
+
+static void TreeRotateRight( struct HeapFreeList* free_list, uint32_t part_idx, uint32_t node_idx )
+{
+  struct HeapFreeNode* node      = TREE_NODE( node_idx );
+  const uint32_t       pivot_idx = node->m_Left;
+  struct HeapFreeNode* pivot     = TREE_NODE( pivot_idx );
+
+  node->m_Left = pivot->m_Right;
+  if( pivot->m_Right != INDEX_NONE )
+  {
+    TREE_NODE( pivot->m_Right )->m_Parent = node_idx;
+  }
+  TreeSetChild( free_list, part_idx, node->m_Parent, node_idx, pivot_idx );
+
+  pivot->m_Right = node_idx;
+  node->m_Parent = pivot_idx;
+}
+
+static void TreeInsert( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  uint32_t node_idx   = (uint32_t)block_idx;
+  uint32_t parent_idx = INDEX_NONE;
+
+  for( uint32_t search_idx = (uint32_t)free_list->m_TrackerInfo[part_idx].m_TreeRoot; search_idx != INDEX_NONE; )
+  {
+    parent_idx = search_idx;
+    search_idx = node_idx < search_idx ? TREE_NODE( search_idx )->m_Left : TREE_NODE( search_idx )->m_Right;
+  }
+
+  struct HeapFreeNode* node = TREE_NODE( node_idx );
+  node->m_Left   = INDEX_NONE;
+  node->m_Right  = INDEX_NONE;
+  node->m_Parent = parent_idx;
+  node->m_Red    = 1;
+
+  if( parent_idx == INDEX_NONE )
+  {
+    free_list->m_TrackerInfo[part_idx].m_TreeRoot = node_idx;
+  }
+  else if( node_idx < parent_idx )
+  {
+    TREE_NODE( parent_idx )->m_Left = node_idx;
+  }
+  else
+  {
+    TREE_NODE( parent_idx )->m_Right = node_idx;
+  }
+
+  // restore red-black properties
+  while( TREE_IS_RED( TREE_NODE( node_idx )->m_Parent ) )
+  {
+    parent_idx                   = TREE_NODE( node_idx )->m_Parent;
+    const uint32_t grandpa_idx   = TREE_NODE( parent_idx )->m_Parent;
+    const bool     parent_left   = TREE_NODE( grandpa_idx )->m_Left == parent_idx;
+    const uint32_t uncle_idx     = parent_left ? TREE_NODE( grandpa_idx )->m_Right : TREE_NODE( grandpa_idx )->m_Left;
+
+    if( TREE_IS_RED( uncle_idx ) )
+    {
+      TREE_NODE( parent_idx )->m_Red  = 0;
+      TREE_NODE( uncle_idx )->m_Red   = 0;
+      TREE_NODE( grandpa_idx )->m_Red = 1;
+      node_idx = grandpa_idx;
+      continue;
+    }
+
+    if( parent_left )
+    {
+      if( TREE_NODE( parent_idx )->m_Right == node_idx )
+      {
+        TreeRotateLeft( free_list, part_idx, parent_idx );
+        parent_idx = node_idx;
+      }
+      TREE_NODE( parent_idx )->m_Red  = 0;
+      TREE_NODE( grandpa_idx )->m_Red = 1;
+      TreeRotateRight( free_list, part_idx, grandpa_idx );
+    }
+    else
+    {
+      if( TREE_NODE( parent_idx )->m_Left == node_idx )
+      {
+        TreeRotateRight( free_list, part_idx, parent_idx );
+        parent_idx = node_idx;
+      }
+      TREE_NODE( parent_idx )->m_Red  = 0;
+      TREE_NODE( grandpa_idx )->m_Red = 1;
+      TreeRotateLeft( free_list, part_idx, grandpa_idx );
+    }
+    break;
+  }
+  TREE_NODE( free_list->m_TrackerInfo[part_idx].m_TreeRoot )->m_Red = 0;
+}
+
+static void TreeRemove( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  const uint32_t       node_idx = (uint32_t)block_idx;
+  struct HeapFreeNode* node     = TREE_NODE( node_idx );
+
+  uint32_t fix_idx, fix_parent_idx;
+  bool     removed_red = node->m_Red != 0;
+
+  if( node->m_Left == INDEX_NONE || node->m_Right == INDEX_NONE )
+  {
+    fix_idx        = node->m_Left == INDEX_NONE ? node->m_Right : node->m_Left;
+    fix_parent_idx = node->m_Parent;
+    TreeSetChild( free_list, part_idx, node->m_Parent, node_idx, fix_idx );
+  }
+  else
+  {
+    // splice in the in-order successor
+    uint32_t succ_idx = node->m_Right;
+    while( TREE_NODE( succ_idx )->m_Left != INDEX_NONE )
+    {
+      succ_idx = TREE_NODE( succ_idx )->m_Left;
+    }
+    struct HeapFreeNode* succ = TREE_NODE( succ_idx );
+
+    removed_red = succ->m_Red != 0;
+    fix_idx     = succ->m_Right;
+
+    if( succ->m_Parent == node_idx )
+    {
+      fix_parent_idx = succ_idx;
+    }
+    else
+    {
+      fix_parent_idx = succ->m_Parent;
+      TreeSetChild( free_list, part_idx, succ->m_Parent, succ_idx, succ->m_Right );
+
+      succ->m_Right                        = node->m_Right;
+      TREE_NODE( succ->m_Right )->m_Parent = succ_idx;
+    }
+
+    TreeSetChild( free_list, part_idx, node->m_Parent, node_idx, succ_idx );
+    succ->m_Left                        = node->m_Left;
+    TREE_NODE( succ->m_Left )->m_Parent = succ_idx;
+    succ->m_Red                         = node->m_Red;
+  }
+
+  if( removed_red )
+  {
+    return;
+  }
+
+  // restore red-black properties ( fix_idx carries an extra black )
+  while( fix_idx != free_list->m_TrackerInfo[part_idx].m_TreeRoot && !TREE_IS_RED( fix_idx ) )
+  {
+    struct HeapFreeNode* parent = TREE_NODE( fix_parent_idx );
+
+    if( parent->m_Left == fix_idx )
+    {
+      uint32_t sibling_idx = parent->m_Right;
+      if( TREE_IS_RED( sibling_idx ) )
+      {
+        TREE_NODE( sibling_idx )->m_Red = 0;
+        parent->m_Red                   = 1;
+        TreeRotateLeft( free_list, part_idx, fix_parent_idx );
+        sibling_idx = parent->m_Right;
+      }
+
+      struct HeapFreeNode* sibling = TREE_NODE( sibling_idx );
+      if( !TREE_IS_RED( sibling->m_Left ) && !TREE_IS_RED( sibling->m_Right ) )
+      {
+        sibling->m_Red = 1;
+        fix_idx        = fix_parent_idx;
+        fix_parent_idx = parent->m_Parent;
+        continue;
+      }
+
+      if( !TREE_IS_RED( sibling->m_Right ) )
+      {
+        TREE_NODE( sibling->m_Left )->m_Red = 0;
+        sibling->m_Red                      = 1;
+        TreeRotateRight( free_list, part_idx, sibling_idx );
+        sibling_idx = parent->m_Right;
+        sibling     = TREE_NODE( sibling_idx );
+      }
+      sibling->m_Red                       = parent->m_Red;
+      parent->m_Red                        = 0;
+      TREE_NODE( sibling->m_Right )->m_Red = 0;
+      TreeRotateLeft( free_list, part_idx, fix_parent_idx );
+    }
+    else
+    {
+      uint32_t sibling_idx = parent->m_Left;
+      if( TREE_IS_RED( sibling_idx ) )
+      {
+        TREE_NODE( sibling_idx )->m_Red = 0;
+        parent->m_Red                   = 1;
+        TreeRotateRight( free_list, part_idx, fix_parent_idx );
+        sibling_idx = parent->m_Left;
+      }
+
+      struct HeapFreeNode* sibling = TREE_NODE( sibling_idx );
+      if( !TREE_IS_RED( sibling->m_Left ) && !TREE_IS_RED( sibling->m_Right ) )
+      {
+        sibling->m_Red = 1;
+        fix_idx        = fix_parent_idx;
+        fix_parent_idx = parent->m_Parent;
+        continue;
+      }
+
+      if( !TREE_IS_RED( sibling->m_Left ) )
+      {
+        TREE_NODE( sibling->m_Right )->m_Red = 0;
+        sibling->m_Red                       = 1;
+        TreeRotateLeft( free_list, part_idx, sibling_idx );
+        sibling_idx = parent->m_Left;
+        sibling     = TREE_NODE( sibling_idx );
+      }
+      sibling->m_Red                      = parent->m_Red;
+      parent->m_Red                       = 0;
+      TREE_NODE( sibling->m_Left )->m_Red = 0;
+      TreeRotateRight( free_list, part_idx, fix_parent_idx );
+    }
+    fix_idx = (uint32_t)free_list->m_TrackerInfo[part_idx].m_TreeRoot;
+  }
+
+  if( fix_idx != INDEX_NONE )
+  {
+    TREE_NODE( fix_idx )->m_Red = 0;
+  }
+}
+
+// Moves a node to another block without touching the tree shape. Only valid while the new block
+// index keeps the same position in address order ( extent grew/shrank at its front )
+static void TreeReplace( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t old_idx, uint64_t new_idx )
+{
+  struct HeapFreeNode* old_node = TREE_NODE( old_idx );
+  struct HeapFreeNode* new_node = TREE_NODE( new_idx );
+
+  new_node->m_Left   = old_node->m_Left;
+  new_node->m_Right  = old_node->m_Right;
+  new_node->m_Parent = old_node->m_Parent;
+  new_node->m_Red    = old_node->m_Red;
+
+  TreeSetChild( free_list, part_idx, new_node->m_Parent, (uint32_t)old_idx, (uint32_t)new_idx );
+  if( new_node->m_Left != INDEX_NONE )
+  {
+    TREE_NODE( new_node->m_Left )->m_Parent = (uint32_t)new_idx;
+  }
+  if( new_node->m_Right != INDEX_NONE )
+  {
+    TREE_NODE( new_node->m_Right )->m_Parent = (uint32_t)new_idx;
+  }
+}
+
+// Closest extents starting before && after block_idx ( INDEX_NONE when there are none )
+static void TreeFindNeighbours( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx, uint64_t* left_idx, uint64_t* right_idx )
+{
+  *left_idx  = INDEX_NONE;
+  *right_idx = INDEX_NONE;
+
+  for( uint32_t search_idx = (uint32_t)free_list->m_TrackerInfo[part_idx].m_TreeRoot; search_idx != INDEX_NONE; )
+  {
+    if( search_idx < block_idx )
+    {
+      *left_idx  = search_idx;
+      search_idx = TREE_NODE( search_idx )->m_Right;
+    }
+    else
+    {
+      *right_idx = search_idx;
+      search_idx = TREE_NODE( search_idx )->m_Left;
+    }
+  }
+}
+
+static uint64_t TreeFirst( struct HeapFreeList* free_list, uint32_t part_idx )
+{
+  uint32_t node_idx = (uint32_t)free_list->m_TrackerInfo[part_idx].m_TreeRoot;
+  while( node_idx != INDEX_NONE && TREE_NODE( node_idx )->m_Left != INDEX_NONE )
+  {
+    node_idx = TREE_NODE( node_idx )->m_Left;
+  }
+  return node_idx;
+}
+
+static uint64_t TreeNext( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t block_idx )
+{
+  uint32_t node_idx = (uint32_t)block_idx;
+
+  if( TREE_NODE( node_idx )->m_Right != INDEX_NONE )
+  {
+    node_idx = TREE_NODE( node_idx )->m_Right;
+    while( TREE_NODE( node_idx )->m_Left != INDEX_NONE )
+    {
+      node_idx = TREE_NODE( node_idx )->m_Left;
+    }
+    return node_idx;
+  }
+
+  uint32_t parent_idx = TREE_NODE( node_idx )->m_Parent;
+  while( parent_idx != INDEX_NONE && TREE_NODE( parent_idx )->m_Right == node_idx )
+  {
+    node_idx   = parent_idx;
+    parent_idx = TREE_NODE( parent_idx )->m_Parent;
+  }
+  return parent_idx;
+}
+
+#undef TREE_IS_RED
+#undef TREE_NODE
+
+static uint32_t AtomicFetchAdd32( uint32_t* value, uint32_t add )
+{
+#ifdef _MSC_VER
+  return (uint32_t)_InterlockedExchangeAdd( (volatile long*)value, (long)add );
+#else
+  return __atomic_fetch_add( value, add, __ATOMIC_RELAXED );
+#endif
+}
+
+static void* AtomicLoadPtr( void** ptr )
+{
+#ifdef _MSC_VER
+  return *(void* volatile*)ptr; // volatile reads have acquire semantics on msvc
+#else
+  return __atomic_load_n( ptr, __ATOMIC_ACQUIRE );
+#endif
+}
+
+static bool AtomicCasPtr( void** ptr, void* expected, void* desired )
+{
+#ifdef _MSC_VER
+  return _InterlockedCompareExchangePointer( ptr, desired, expected ) == expected;
+#else
+  return __atomic_compare_exchange_n( ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+#endif
+}
+
+static void* AtomicExchangePtr( void** ptr, void* desired )
+{
+#ifdef _MSC_VER
+  return _InterlockedExchangePointer( ptr, desired );
+#else
+  return __atomic_exchange_n( ptr, desired, __ATOMIC_ACQ_REL );
+#endif
+}
+
+static uint32_t AtomicLoad32( uint32_t* value )
+{
+#ifdef _MSC_VER
+  return *(volatile uint32_t*)value; // volatile reads have acquire semantics on msvc
+#else
+  return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+#endif
+}
+
+static void AtomicStore32( uint32_t* value, uint32_t desired )
+{
+#ifdef _MSC_VER
+  _InterlockedExchange( (volatile long*)value, (long)desired );
+#else
+  __atomic_store_n( value, desired, __ATOMIC_RELEASE );
+#endif
+}
+
+static void CpuPause()
+{
+#if defined( _MSC_VER )
+  YieldProcessor();
+#elif defined( __i386__ ) || defined( __x86_64__ )
+  __builtin_ia32_pause();
+#endif
+}
+
+static void ThreadYield()
+{
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+static void TicketAcquire( struct HeapLock* lock )
+{
+  // the holder || an earlier ticket may be descheduled, so stop burning the core after a while
+  const uint32_t ticket = AtomicFetchAdd32( &lock->m_Ticket, 1 );
+  for( uint32_t ispin = 0; AtomicLoad32( &lock->m_Serving ) != ticket; ispin++ )
+  {
+    if( ispin < HEAP_LOCK_SPINS )
+    {
+      CpuPause();
+    }
+    else
+    {
+      ThreadYield();
+    }
+  }
+}
+
+static void TicketRelease( struct HeapLock* lock )
+{
+  AtomicStore32( &lock->m_Serving, lock->m_Serving + 1 );
+}
+
+// Heap locks are only taken by k_HeapInitShared heaps
+static void LockAcquire( struct HeapFreeList* free_list, struct HeapLock* lock )
+{
+  if( free_list->m_InitFlags & k_HeapInitShared )
+  {
+    TicketAcquire( lock );
+  }
+}
+
+static void LockRelease( struct HeapFreeList* free_list, struct HeapLock* lock )
+{
+  if( free_list->m_InitFlags & k_HeapInitShared )
+  {
+    TicketRelease( lock );
+  }
+}
+
+static uint32_t BitScanLow32( uint32_t mask )
+{
+#ifdef _MSC_VER
+  unsigned long bit_idx;
+  _BitScanForward( &bit_idx, mask );
+  return (uint32_t)bit_idx;
+#else
+  return (uint32_t)__builtin_ctz( mask );
+#endif
+}
+
+static uint32_t BitScanLow64( uint64_t mask )
+{
+#ifdef _MSC_VER
+  unsigned long bit_idx;
+  _BitScanForward64( &bit_idx, mask );
+  return (uint32_t)bit_idx;
+#else
+  return (uint32_t)__builtin_ctzll( mask );
+#endif
+}
+
+static uint32_t BitScanHigh64( uint64_t mask )
+{
+#ifdef _MSC_VER
+  unsigned long bit_idx;
+  _BitScanReverse64( &bit_idx, mask );
+  return (uint32_t)bit_idx;
+#else
+  return 63 - (uint32_t)__builtin_clzll( mask );
+#endif
+}
+
+static uint64_t GetPageSize()
+{
+  static uint64_t page_size = 0;
+  if( page_size == 0 )
+  {
+#ifdef _WIN32
+    SYSTEM_INFO sys_info;
+    GetSystemInfo( &sys_info );
+    page_size = sys_info.dwPageSize;
+#else
+    page_size = (uint64_t)sysconf( _SC_PAGESIZE );
+#endif
+  }
+  return page_size;
+}
+
+static void* VirtualReserveAligned( uint64_t size, uint64_t alignment )
+{
+#ifdef _WIN32
+  // reserve a padded range to find an aligned address, then retake just that part
+  for( uint32_t iattempt = 0; iattempt < 8; iattempt++ )
+  {
+    void* padded = VirtualAlloc( NULL, (SIZE_T)( size + alignment ), MEM_RESERVE, PAGE_NOACCESS );
+    if( padded == NULL )
+    {
+      return NULL;
+    }
+    VirtualFree( padded, 0, MEM_RELEASE );
+
+    void* aligned = VirtualAlloc( (void*)CalcAllignedAllocSize( (uintptr_t)padded, (uint32_t)alignment ), (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS );
+    if( aligned )
+    {
+      return aligned;
+    }
+  }
+  return NULL;
+#else
+  size = CalcAllignedAllocSize( size, (uint32_t)GetPageSize() ); // munmap wants the tail to start on a page
+
+  unsigned char* padded = (unsigned char*)VirtualReserve( size + alignment );
+  if( padded == NULL )
+  {
+    return NULL;
+  }
+
+  // trim the unaligned head && the tail
+  unsigned char* aligned   = (unsigned char*)CalcAllignedAllocSize( (uintptr_t)padded, (uint32_t)alignment );
+  const uint64_t head_size = (uint64_t)( aligned - padded );
+  if( head_size )
+  {
+    munmap( padded, (size_t)head_size );
+  }
+  munmap( aligned + size, (size_t)( alignment - head_size ) );
+
+  return aligned;
+#endif
+}
+
+static void* VirtualReserve( uint64_t size )
+{
+#ifdef _WIN32
+  return VirtualAlloc( NULL, (SIZE_T)size, MEM_RESERVE, PAGE_NOACCESS );
+#else
+  void* ptr = mmap( NULL, (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+  return ptr == MAP_FAILED ? NULL : ptr;
+#endif
+}
+
+// Committed && zeroed, the heap's own bookkeeping comes from here rather than malloc ( which may be
+// the interposed one, see MemoryPreload.cpp )
+static void* VirtualAllocate( uint64_t size )
+{
+  void* ptr = VirtualReserve( size );
+  if( ptr && !VirtualCommit( ptr, size ) )
+  {
+    VirtualRelease( ptr, size );
+    ptr = NULL;
+  }
+  return ptr;
+}
+
+static bool VirtualCommit( void* ptr, uint64_t size )
+{
+#ifdef _WIN32
+  return VirtualAlloc( ptr, (SIZE_T)size, MEM_COMMIT, PAGE_READWRITE ) != NULL;
+#else
+  const uint64_t page_size = GetPageSize();
+
+  // mprotect wants a page aligned start
+  uintptr_t start = (uintptr_t)ptr & ~( page_size - 1 );
+  uintptr_t end   = ( (uintptr_t)ptr + size + page_size - 1 ) & ~( page_size - 1 );
+
+  return mprotect( (void*)start, (size_t)( end - start ), PROT_READ | PROT_WRITE ) == 0;
+#endif
+}
+
+static void VirtualRelease( void* ptr, uint64_t size )
+{
+#ifdef _WIN32
+  (void)size;
+  VirtualFree( ptr, 0, MEM_RELEASE );
+#else
+  munmap( ptr, (size_t)size );
+#endif
+}
+
+// Contents of the range are dropped but it stays accessible, touching it again faults in zeroed pages
+static void VirtualPurge( void* ptr, uint64_t size )
+{
+#ifdef _WIN32
+  VirtualAlloc( ptr, (SIZE_T)size, MEM_RESET, PAGE_READWRITE );
+#elif defined( MADV_DONTNEED )
+  madvise( ptr, (size_t)size, MADV_DONTNEED );
+#else
+  (void)ptr;
+  (void)size;
+#endif
+}
+
+// False once the system is out of memory, the committed range stays as it was
+static bool CommitPartition( struct HeapFreeList* free_list, uint32_t part_idx, uint64_t end_offset )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  const bool              huge_pages   = ( free_list->m_InitFlags & k_HeapInitHugePages ) != 0 && part_idx < k_HeapNumLvl;
+  const uint32_t          commit_step  = huge_pages ? HUGE_PAGE_SIZE : MEM_COMMIT_SIZE;
+  const uint64_t          part_size    = huge_pages ? CalcAllignedAllocSize( free_list->m_PartitionLvlDetails[part_idx].m_Size, HUGE_PAGE_SIZE ) : free_list->m_PartitionLvlDetails[part_idx].m_Size;
+
+  if( end_offset <= tracker_info->m_CommittedSize )
+  {
+    return true;
+  }
+  uint64_t commit_end = CalcAllignedAllocSize( end_offset, commit_step );
+  commit_end          = commit_end > part_size ? part_size : commit_end;
+
+  unsigned char* commit_ptr  = free_list->m_PartitionLvls[part_idx] + tracker_info->m_CommittedSize;
+  const uint64_t commit_size = commit_end - tracker_info->m_CommittedSize;
+
+  const bool committed = huge_pages ? VirtualCommitHuge( commit_ptr, commit_size, &tracker_info->m_Backing ) : VirtualCommit( commit_ptr, commit_size );
+  if( committed )
+  {
+    tracker_info->m_CommittedSize = commit_end;
+  }
+  return committed;
+}
+
+static bool VirtualCommitHuge( void* ptr, uint64_t size, uint32_t* backing )
+{
+#if defined( _WIN32 )
+  // large pages need SeLockMemoryPrivilege && can't be committed piecemeal from a reservation
+  *backing |= k_HeapBackingPages;
+  return VirtualCommit( ptr, size );
+#else
+#ifdef MAP_HUGETLB
+  // once the huge page pool runs dry the rest of the partition sticks w/ the fallback
+  if( ( *backing & ( k_HeapBackingPages | k_HeapBackingTransparentHuge ) ) == 0 )
+  {
+    if( mmap( ptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0 ) != MAP_FAILED )
+    {
+      *backing |= k_HeapBackingHugeTLB;
+      return true;
+    }
+    // restore the reservation in case the failed map dropped it
+    if( mmap( ptr, (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0 ) == MAP_FAILED )
+    {
+      return false;
+    }
+  }
+#endif
+  if( !VirtualCommit( ptr, size ) )
+  {
+    return false;
+  }
+#ifdef MADV_HUGEPAGE
+  *backing |= madvise( ptr, (size_t)size, MADV_HUGEPAGE ) == 0 ? k_HeapBackingTransparentHuge : k_HeapBackingPages;
+#else
+  *backing |= k_HeapBackingPages;
+#endif
+  return true;
+#endif
+}
+
+static bool IsLargeBlock( const void* data_ptr )
+{
+  const struct HeapBlockHeader* header = (const struct HeapBlockHeader*)( (const unsigned char*)data_ptr - s_BlockHeaderSize );
+  return EXTRACT_PART( header->m_BHIndexNPartition ) == k_HeapBlockPartitionMask;
+}
+
+// block sits at the start of the mapping && data never starts past its first page
+static struct HeapLargeBlock* GetLargeBlock( void* data_ptr )
+{
+  return (struct HeapLargeBlock*)( ( (uintptr_t)data_ptr - s_BlockHeaderSize ) & ~( (uintptr_t)GetPageSize() - 1 ) );
+}
+
+// alignment moves the data further into the first page, w/ a copy of the header in front of it
+static void* LargeAllocate( struct MemoryData* mem_data, uint64_t byte_size, uint32_t alignment, uint64_t debug_hash )
+{
+  struct HeapLargeList* large_list  = &mem_data->m_FreeList.m_Large;
+  const uint64_t        data_offset = CalcAllignedAllocSize( sizeof( struct HeapLargeBlock ), alignment > BASE_ALIGN ? alignment : BASE_ALIGN );
+  const uint64_t        map_size    = CalcAllignedAllocSize( byte_size + data_offset, (uint32_t)GetPageSize() );
+  
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  // smallest cached region that fits w/o wasting more than the request itself
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  uint32_t cache_idx = k_HeapLargeCacheSlots;
+  for( uint32_t islot = 0; islot < large_list->m_CacheCount; islot++ )
+  {
+    const uint64_t slot_size = large_list->m_CacheSizes[islot];
+    if( slot_size >= map_size && slot_size <= map_size * 2 && ( cache_idx == k_HeapLargeCacheSlots || slot_size < large_list->m_CacheSizes[cache_idx] ) )
+    {
+      cache_idx = islot;
+    }
+  }
+
+  struct HeapLargeBlock* large = NULL;
+  if( cache_idx < k_HeapLargeCacheSlots )
+  {
+    large = large_list->m_Cache[cache_idx];
+
+    large_list->m_CacheCount--;
+    large_list->m_CacheSize -= large_list->m_CacheSizes[cache_idx];
+    memmove( &large_list->m_Cache[cache_idx], &large_list->m_Cache[cache_idx + 1], sizeof( struct HeapLargeBlock* ) * ( large_list->m_CacheCount - cache_idx ) );
+    memmove( &large_list->m_CacheSizes[cache_idx], &large_list->m_CacheSizes[cache_idx + 1], sizeof( uint64_t ) * ( large_list->m_CacheCount - cache_idx ) );
+  }
+  LockRelease( free_list, &free_list->m_LargeLock );
+
+  if( large == NULL )
+  {
+    large = (struct HeapLargeBlock*)VirtualReserve( map_size );
+    if( large && !VirtualCommit( large, map_size ) )
+    {
+      VirtualRelease( large, map_size );
+      large = NULL;
+    }
+    if( large == NULL )
+    {
+      LockAcquire( free_list, &free_list->m_LargeLock );
+      StatsFailed( &free_list->m_LargeStats, k_QueryNoFreeSpace );
+      LockRelease( free_list, &free_list->m_LargeLock );
+      return NULL; // maybe assert(?)
+    }
+    large->m_MapSize = map_size;
+  }
+
+  large->m_Owner  = mem_data;
+  large->m_Prev   = NULL;
+
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  large->m_Next = large_list->m_Head;
+  if( large_list->m_Head )
+  {
+    large_list->m_Head->m_Prev = large;
+  }
+  large_list->m_Head = large;
+  large_list->m_LiveCount++;
+  large_list->m_LiveSize += large->m_MapSize;
+  StatsAlloc( &free_list->m_LargeStats, 1, large->m_MapSize );
+  LockRelease( free_list, &free_list->m_LargeLock );
+
+  large->m_Header.m_BHIndexNPartition = SET_INDEX_PART( 0, k_HeapBlockPartitionMask );
+  large->m_Header.m_BHAllocCount      = 1;
+#ifdef TAG_MEMORY
+  large->m_Header.m_BHTagHash = debug_hash;
+#else
+  debug_hash = debug_hash;
+#endif // TAG_MEMORY
+
+  unsigned char* data    = (unsigned char*)large + data_offset;
+                 data[0] = 1; // set value of 1st point to a number other than 0
+
+  *(struct HeapBlockHeader*)( data - s_BlockHeaderSize ) = large->m_Header;
+  
+  return data;
+}
+
+static void LargeRelease( struct HeapFreeList* free_list, struct HeapLargeBlock* large )
+{
+  struct HeapLargeList* large_list = &free_list->m_Large;
+
+  LockAcquire( free_list, &free_list->m_LargeLock );
+  if( large->m_Prev )
+  {
+    large->m_Prev->m_Next = large->m_Next;
+  }
+  else
+  {
+    large_list->m_Head = large->m_Next;
+  }
+  if( large->m_Next )
+  {
+    large->m_Next->m_Prev = large->m_Prev;
+  }
+  large_list->m_LiveCount--;
+  large_list->m_LiveSize -= large->m_MapSize;
+  StatsRelease( &free_list->m_LargeStats, 1, large->m_MapSize );
+
+  if( large->m_MapSize > HEAP_LARGE_CACHE_SIZE )
+  {
+    LockRelease( free_list, &free_list->m_LargeLock );
+    VirtualRelease( large, large->m_MapSize );
+    return;
+  }
+
+  // keep the region mapped, evicting the oldest to make room
+  LargeCacheTrim( large_list, k_HeapLargeCacheSlots - 1, HEAP_LARGE_CACHE_SIZE - large->m_MapSize );
+
+  large_list->m_Cache[large_list->m_CacheCount]      = large;
+  large_list->m_CacheSizes[large_list->m_CacheCount] = large->m_MapSize;
+  large_list->m_CacheCount++;
+  large_list->m_CacheSize += large->m_MapSize;
+  LockRelease( free_list, &free_list->m_LargeLock );
+}
+
+static void LargeCacheTrim( struct HeapLargeList* large_list, uint32_t max_count, uint64_t max_size )
+{
+  uint32_t evict_count = 0;
+  while( evict_count < large_list->m_CacheCount && ( large_list->m_CacheCount - evict_count > max_count || large_list->m_CacheSize > max_size ) )
+  {
+    large_list->m_CacheSize -= large_list->m_CacheSizes[evict_count];
+    VirtualRelease( large_list->m_Cache[evict_count], large_list->m_CacheSizes[evict_count] );
+    evict_count++;
+  }
+
+  large_list->m_CacheCount -= evict_count;
+  memmove( &large_list->m_Cache[0], &large_list->m_Cache[evict_count], sizeof( struct HeapLargeBlock* ) * large_list->m_CacheCount );
+  memmove( &large_list->m_CacheSizes[0], &large_list->m_CacheSizes[evict_count], sizeof( uint64_t ) * large_list->m_CacheCount );
+}
+
+// False when the node of the partition's single free extent can't be committed
+static bool InitPartition( struct HeapFreeList* free_list, uint32_t part_idx, struct HeapBlockHeader* tracker_slice )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[part_idx];
+  const uint64_t          part_bins    = free_list->m_PartitionLvlDetails[part_idx].m_BinCount;
+
+  if( !CommitPartition( free_list, part_idx, sizeof( struct HeapFreeNode ) ) )
+  {
+    return false;
+  }
+
+  tracker_info->m_HeadIdx      = 0;
+  tracker_info->m_TrackedCount = 1;
+  tracker_info->m_BinOccupancy = part_bins; 
+  tracker_info->m_TreeRoot     = INDEX_NONE;
+  tracker_info->m_NextSegment  = INDEX_NONE;
+  tracker_info->m_TrackerSlice = tracker_slice;
+
+  memset( &free_list->m_FreeIndex[part_idx], 0, sizeof( struct HeapFreeIndex ) );
+  memset( free_list->m_FreeIndex[part_idx].m_Heads, 0xff, sizeof( free_list->m_FreeIndex[part_idx].m_Heads ) );
+  IndexInsert( free_list, part_idx, 0, part_bins, NULL );
+
+  if( free_list->m_InitFlags & k_HeapInitTreeTracker )
+  {
+    TreeInsert( free_list, part_idx, 0 );
+  }
+  else
+  {
+    tracker_slice->m_BHAllocCount      = part_bins;
+    tracker_slice->m_BHIndexNPartition = SET_INDEX_PART( 0, part_idx ); // partition index is encoded in lower 4 bits 
+  }
+  return true;
+}
+
+// Slab partitions keep no free extents, so the tracker paths skip straight to the level's segments.
+// Returns the words past the slab's bitmaps
+static uint64_t* InitSlab( struct HeapFreeList* free_list, uint32_t level_idx, uint64_t* slab_words )
+{
+  struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[level_idx];
+  struct HeapSlabData*    slab         = &free_list->m_Slab[level_idx];
+  const uint64_t          slot_count   = free_list->m_PartitionLvlDetails[level_idx].m_BinCount;
+
+  tracker_info->m_TreeRoot    = INDEX_NONE;
+  tracker_info->m_NextSegment = INDEX_NONE;
+  memset( free_list->m_FreeIndex[level_idx].m_Heads, 0xff, sizeof( free_list->m_FreeIndex[level_idx].m_Heads ) );
+
+  slab->m_RunBits   = slab_words;
+  slab->m_FreeRuns  = slab_words + slab->m_RunCount * k_HeapSlabRunWords;
+  slab->m_FreeSlots = slot_count;
+  slab->m_HintWord  = 0;
+
+  // every slot starts free, bits past the last slot stay clear
+  memset( slab->m_RunBits, 0, slab->m_RunCount * k_HeapSlabRunWords * sizeof( uint64_t ) );
+  memset( slab->m_RunBits, 0xff, ( slot_count / 64 ) * sizeof( uint64_t ) );
+  if( slot_count % 64 )
+  {
+    slab->m_RunBits[slot_count / 64] = ( (uint64_t)1 << ( slot_count % 64 ) ) - 1;
+  }
+
+  memset( slab->m_FreeRuns, 0, slab->m_FreeRunWords * sizeof( uint64_t ) );
+  memset( slab->m_FreeRuns, 0xff, ( slab->m_RunCount / 64 ) * sizeof( uint64_t ) );
+  if( slab->m_RunCount % 64 )
+  {
+    slab->m_FreeRuns[slab->m_RunCount / 64] = ( (uint64_t)1 << ( slab->m_RunCount % 64 ) ) - 1;
+  }
+
+  return slab->m_FreeRuns + slab->m_FreeRunWords;
+}
+
+// Level of the slab holding data_ptr, k_HeapSlabLvls when it isn't a slab slot
+static uint32_t FindSlabLevel( const struct HeapFreeList* free_list, const void* data_ptr )
+{
+  if( free_list->m_InitFlags & k_HeapInitSlab )
+  {
+    for( uint32_t ilvl = 0; ilvl < free_list->m_SlabLvls; ilvl++ )
+    {
+      const unsigned char* part_start = free_list->m_PartitionLvls[ilvl];
+      if( (const unsigned char*)data_ptr >= part_start && (const unsigned char*)data_ptr < part_start + free_list->m_PartitionLvlDetails[ilvl].m_Size )
+      {
+        return ilvl;
+      }
+    }
+  }
+  return k_HeapSlabLvls;
+}
+
+// Lowest free slot : 1st run w/ a free slot from the summary bitmap, then its 1st free bit
+static void* SlabAllocate( struct HeapFreeList* free_list, uint32_t level_idx )
+{
+  struct HeapSlabData* slab = &free_list->m_Slab[level_idx];
+
+  uint32_t word_idx = slab->m_HintWord;
+  while( word_idx < slab->m_FreeRunWords && slab->m_FreeRuns[word_idx] == 0 )
+  {
+    word_idx++;
+  }
+  slab->m_HintWord = word_idx;
+  if( word_idx == slab->m_FreeRunWords )
+  {
+    return NULL;
+  }
+
+  const uint64_t run_idx  = (uint64_t)word_idx * 64 + BitScanLow64( slab->m_FreeRuns[word_idx] );
+  uint64_t*      run_bits = slab->m_RunBits + run_idx * k_HeapSlabRunWords;
+
+  uint32_t bits_idx = 0;
+  while( run_bits[bits_idx] == 0 )
+  {
+    bits_idx++;
+  }
+
+  // runs are handed out lowest first, so committing whole runs keeps the high-water mark tight
+  const uint64_t slot_idx  = run_idx * k_HeapSlabRunSlots + bits_idx * 64 + BitScanLow64( run_bits[bits_idx] );
+  const uint32_t slot_size = LevelSize( free_list, level_idx );
+  if( ( slot_idx + 1 ) * slot_size > free_list->m_TrackerInfo[level_idx].m_CommittedSize && !CommitPartition( free_list, level_idx, ( run_idx + 1 ) * k_HeapSlabRunSlots * slot_size ) )
+  {
+    return NULL;
+  }
+
+  run_bits[bits_idx] &= run_bits[bits_idx] - 1;
+  slab->m_FreeSlots--;
+
+  uint64_t run_free = 0;
+  for( uint32_t iword = 0; iword < k_HeapSlabRunWords; iword++ )
+  {
+    run_free |= run_bits[iword];
+  }
+  if( run_free == 0 )
+  {
+    slab->m_FreeRuns[word_idx] &= ~( (uint64_t)1 << ( run_idx % 64 ) );
+  }
+
+  return free_list->m_PartitionLvls[level_idx] + slot_idx * slot_size;
+}
+
+static void SlabRelease( struct HeapFreeList* free_list, uint32_t level_idx, void* data_ptr )
+{
+  struct HeapSlabData* slab        = &free_list->m_Slab[level_idx];
+  const uint64_t       slot_offset = (uint64_t)( (unsigned char*)data_ptr - free_list->m_PartitionLvls[level_idx] );
+  const uint64_t       slot_idx    = slot_offset / LevelSize( free_list, level_idx );
+  const uint64_t       run_idx     = slot_idx / k_HeapSlabRunSlots;
+  const uint64_t       slot_bit    = (uint64_t)1 << ( slot_idx % 64 );
+
+  ASSERT_F( slot_offset % LevelSize( free_list, level_idx ) == 0, "Releasing a pointer inside a slab slot : %p", data_ptr );
+  ASSERT_F( ( slab->m_RunBits[slot_idx / 64] & slot_bit ) == 0, "Slab slot released twice : %p", data_ptr );
+
+  slab->m_RunBits[slot_idx / 64]  |= slot_bit;
+  slab->m_FreeRuns[run_idx / 64]  |= (uint64_t)1 << ( run_idx % 64 );
+  slab->m_FreeSlots++;
+
+  slab->m_HintWord = (uint32_t)( run_idx / 64 ) < slab->m_HintWord ? (uint32_t)( run_idx / 64 ) : slab->m_HintWord;
+}
+
+static uint64_t LevelFindFit( struct HeapFreeList* free_list, uint32_t level_idx, uint64_t bin_count, uint32_t* part_idx )
+{
+  for( uint32_t ipart = level_idx; ipart != INDEX_NONE; ipart = free_list->m_TrackerInfo[ipart].m_NextSegment )
+  {
+    if( free_list->m_TrackerInfo[ipart].m_BinOccupancy < bin_count )
+    {
+      continue;
+    }
+
+    const uint64_t free_idx = IndexFindFit( free_list, ipart, bin_count );
+    if( free_idx != INDEX_NONE )
+    {
+      *part_idx = ipart;
+      return free_idx;
+    }
+  }
+  return INDEX_NONE;
+}
+
+static bool AddSegment( struct MemoryData* mem_data, uint32_t level_idx, uint64_t bin_count )
+{
+  struct HeapFreeList* free_list = &mem_data->m_FreeList;
+
+  const uint32_t bin_size  = LevelSize( free_list, level_idx ) + s_BlockHeaderSize;
+  const uint64_t part_bins = ( HEAP_SEGMENT_SIZE - SEGMENT_HEADER_SIZE ) / ( bin_size + s_BlockHeaderSize );
+  if( ( free_list->m_InitFlags & k_HeapInitFixedSize ) || bin_count > part_bins )
+  {
+    return false;
+  }
+
+  unsigned char* segment = (unsigned char*)VirtualReserveAligned( HEAP_SEGMENT_SIZE, HEAP_SEGMENT_SIZE );
+  if( segment == NULL )
+  {
+    return false;
+  }
+
+  // tracker slice is only used by the array tracker, the bins are committed as they're carved
+  const uint64_t tracker_size = ( free_list->m_InitFlags & k_HeapInitTreeTracker ) ? 0 : part_bins * s_BlockHeaderSize;
+  if( !VirtualCommit( segment, SEGMENT_HEADER_SIZE + tracker_size ) )
+  {
+    VirtualRelease( segment, HEAP_SEGMENT_SIZE );
+    return false;
+  }
+
+  // claim a partition slot, other levels may be growing at the same time
+  LockAcquire( free_list, &free_list->m_SegmentLock );
+  uint32_t part_idx = k_HeapNumLvl;
+  while( part_idx < k_HeapMaxPartitions && free_list->m_PartitionLvls[part_idx] )
+  {
+    part_idx++;
+  }
+  if( part_idx < k_HeapMaxPartitions )
+  {
+    free_list->m_PartitionLvls[part_idx] = segment + SEGMENT_HEADER_SIZE + part_bins * s_BlockHeaderSize;
+    free_list->m_TotalPartitionSize     += part_bins * bin_size;
+    free_list->m_TotalPartitionBins     += part_bins;
+  }
+  LockRelease( free_list, &free_list->m_SegmentLock );
+
+  if( part_idx == k_HeapMaxPartitions )
+  {
+    VirtualRelease( segment, HEAP_SEGMENT_SIZE );
+    return false;
+  }
+
+  struct HeapSegment* segment_header = (struct HeapSegment*)segment;
+  segment_header->m_Owner            = mem_data;
+  segment_header->m_PartIdx          = part_idx;
+
+  struct HeapPartitionData* part_data = &free_list->m_PartitionLvlDetails[part_idx];
+  part_data->m_BinSize                = bin_size;
+  part_data->m_BinCount               = part_bins;
+  part_data->m_Size                   = part_bins * bin_size;
+  part_data->m_Level                  = level_idx;
+
+  free_list->m_TrackerInfo[part_idx].m_CommittedSize = 0;
+  free_list->m_TrackerInfo[part_idx].m_Backing       = k_HeapBackingPages;
+
+  if( !InitPartition( free_list, part_idx, (struct HeapBlockHeader*)( segment + SEGMENT_HEADER_SIZE ) ) )
+  {
+    LockAcquire( free_list, &free_list->m_SegmentLock );
+    free_list->m_PartitionLvls[part_idx]  = NULL;
+    free_list->m_TotalPartitionSize     -= part_bins * bin_size;
+    free_list->m_TotalPartitionBins     -= part_bins;
+    LockRelease( free_list, &free_list->m_SegmentLock );
+
+    VirtualRelease( segment, HEAP_SEGMENT_SIZE );
+    return false;
+  }
+
+  // append to the level's chain
+  uint32_t last_idx = level_idx;
+  while( free_list->m_TrackerInfo[last_idx].m_NextSegment != INDEX_NONE )
+  {
+    last_idx = free_list->m_TrackerInfo[last_idx].m_NextSegment;
+  }
+  free_list->m_TrackerInfo[last_idx].m_NextSegment = part_idx;
+
+  return true;
+}
+
+static void ReleaseSegment( struct HeapFreeList* free_list, uint32_t part_idx )
+{
+  struct HeapPartitionData* part_data = &free_list->m_PartitionLvlDetails[part_idx];
+
+  uint32_t prev_idx = part_data->m_Level;
+  while( free_list->m_TrackerInfo[prev_idx].m_NextSegment != part_idx )
+  {
+    prev_idx = free_list->m_TrackerInfo[prev_idx].m_NextSegment;
+  }
+  free_list->m_TrackerInfo[prev_idx].m_NextSegment = free_list->m_TrackerInfo[part_idx].m_NextSegment;
+
+  // a decay purge stopped inside the segment goes on w/ the next one
+  if( free_list->m_PurgeParts[part_data->m_Level] == part_idx )
+  {
+    free_list->m_PurgeParts[part_data->m_Level]  = free_list->m_TrackerInfo[part_idx].m_NextSegment;
+    free_list->m_PurgeBlocks[part_data->m_Level] = 0;
+  }
+
+  VirtualRelease( (void*)( (uintptr_t)free_list->m_PartitionLvls[part_idx] & ~( (uintptr_t)HEAP_SEGMENT_SIZE - 1 ) ), HEAP_SEGMENT_SIZE );
+
+  const uint64_t part_size = part_data->m_Size;
+  const uint64_t part_bins = part_data->m_BinCount;
+  memset( part_data, 0, sizeof( struct HeapPartitionData ) );
+  memset( &free_list->m_TrackerInfo[part_idx], 0, sizeof( struct HeapTrackerData ) );
+
+  // the slot goes back last, AddSegment may hand it out right away
+  LockAcquire( free_list, &free_list->m_SegmentLock );
+  free_list->m_TotalPartitionSize     -= part_size;
+  free_list->m_TotalPartitionBins     -= part_bins;
+  free_list->m_PartitionLvls[part_idx] = NULL;
+  LockRelease( free_list, &free_list->m_SegmentLock );
+}
+
+static void TrimSegments( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t keep_empty )
+{
+  uint32_t part_idx = free_list->m_TrackerInfo[level_idx].m_NextSegment;
+  while( part_idx != INDEX_NONE )
+  {
+    const uint32_t next_idx = free_list->m_TrackerInfo[part_idx].m_NextSegment;
+
+    if( free_list->m_TrackerInfo[part_idx].m_BinOccupancy == free_list->m_PartitionLvlDetails[part_idx].m_BinCount )
+    {
+      if( keep_empty )
+      {
+        keep_empty--;
+      }
+      else
+      {
+        ReleaseSegment( free_list, part_idx );
+      }
+    }
+    part_idx = next_idx;
+  }
+}
+
+static uint32_t GetTickMs()
+{
+#ifdef _WIN32
+  return (uint32_t)GetTickCount64();
+#else
+  struct timespec time_spec;
+  clock_gettime( CLOCK_MONOTONIC, &time_spec );
+  return (uint32_t)( (uint64_t)time_spec.tv_sec * 1000 + (uint64_t)time_spec.tv_nsec / 1000000 );
+#endif
+}
+
+#ifdef HEAP_TRACE
+static uint64_t GetTimeNs()
+{
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter( &counter );
+  QueryPerformanceFrequency( &frequency );
+  return (uint64_t)( (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart );
+#else
+  struct timespec time_spec;
+  clock_gettime( CLOCK_MONOTONIC, &time_spec );
+  return (uint64_t)time_spec.tv_sec * 1000000000 + (uint64_t)time_spec.tv_nsec;
+#endif
+}
+
+// Appends a record to the shared buffer, writing it out once full. Threads racing HeapTraceStop drop theirs
+static void TraceRecord( uint8_t op, const void* data_ptr, uint64_t byte_size, uint64_t extra, uint32_t thread_id, uint32_t hints, uint8_t block_size )
+{
+  if( AtomicLoadPtr( (void**)&s_TraceFile ) == NULL )
+  {
+    return;
+  }
+
+  struct HeapTraceRecord record;
+  record.m_Ptr       = (uintptr_t)data_ptr;
+  record.m_Size      = byte_size;
+  record.m_Extra     = extra;
+  record.m_ThreadId  = ResolveThreadId( thread_id );
+  record.m_Hints     = hints;
+  record.m_Op        = op;
+  record.m_BlockSize = block_size;
+  record.m_Pad       = 0;
+
+  TicketAcquire( &s_TraceLock );
+  if( s_TraceFile )
+  {
+    // stamped under the lock so times ascend through the file
+    record.m_TimeNs               = GetTimeNs() - s_TraceStartNs;
+    s_TraceBuffer[s_TraceCount++] = record;
+    if( s_TraceCount == HEAP_TRACE_BUFFER )
+    {
+      TraceFlush( s_TraceFile );
+    }
+  }
+  TicketRelease( &s_TraceLock );
+}
+
+static void TraceFlush( FILE* trace_file )
+{
+  const size_t written = fwrite( s_TraceBuffer, sizeof( struct HeapTraceRecord ), s_TraceCount, trace_file );
+  ASSERT_F( written == s_TraceCount, "Trace write failed : %zu of %u records", written, s_TraceCount );
+  (void)written;
+
+  s_TraceCount = 0;
+}
+#endif // HEAP_TRACE
+
+// Drops the pages of the level's free extents that have been idle for at least min_age ms. The page holding
+// the extent node stays resident, the rest of the extent up to the committed size goes back to the OS.
+// W/ a budget the sweep visits at most that many extents, resuming where the last call of the level stopped
+static uint64_t PurgeExtents( struct HeapFreeList* free_list, uint32_t level_idx, uint32_t min_age, uint32_t* budget )
+{
+  const uint32_t purge_tick  = AtomicLoad32( &free_list->m_PurgeTick );
+  uint64_t       purged_size = 0;
+  uint64_t       start_idx   = budget ? free_list->m_PurgeBlocks[level_idx] : 0;
+  for( uint32_t ipart = budget ? free_list->m_PurgeParts[level_idx] : level_idx; ipart != INDEX_NONE; ipart = free_list->m_TrackerInfo[ipart].m_NextSegment, start_idx = 0 )
+  {
+    if( level_idx < free_list->m_SlabLvls )
+    {
+      break; // slab slots aren't tracked
+    }
+
+    struct HeapTrackerData* tracker_info = &free_list->m_TrackerInfo[ipart];
+
+    // hugetlb pages can only be dropped whole
+    const uint64_t  page_size     = tracker_info->m_Backing & k_HeapBackingHugeTLB ? HUGE_PAGE_SIZE : GetPageSize();
+    const uint64_t  bin_size      = free_list->m_PartitionLvlDetails[ipart].m_BinSize;
+    const uintptr_t committed_end = (uintptr_t)free_list->m_PartitionLvls[ipart] + tracker_info->m_CommittedSize;
+
+    uint64_t cursor = SeekFreeExtent( free_list, ipart, start_idx ), block_idx, bin_count;
+    while( NextFreeExtent( free_list, ipart, &cursor, &block_idx, &bin_count ) )
+    {
+      if( budget && ( *budget )-- == 0 )
+      {
+        *budget                              = 0;
+        free_list->m_PurgeParts[level_idx]  = ipart;
+        free_list->m_PurgeBlocks[level_idx] = block_idx;
+        return purged_size;
+      }
+
+      struct HeapFreeNode* node = GetFreeNode( free_list, ipart, block_idx );
+      if( node->m_Purged || bin_count * bin_size < HEAP_PURGE_MIN_SIZE || purge_tick - node->m_FreeTick < min_age )
+      {
+        continue;
+      }
+
+      const uintptr_t extent_end  = (uintptr_t)node + bin_count * bin_size;
+      const uintptr_t purge_start = (uintptr_t)CalcAllignedAllocSize( (uintptr_t)node + sizeof( struct HeapFreeNode ), (uint32_t)page_size );
+      const uintptr_t purge_end   = ( extent_end < committed_end ? extent_end : committed_end ) & ~( (uintptr_t)page_size - 1 );
+
+      if( purge_end > purge_start )
+      {
+        VirtualPurge( (void*)purge_start, purge_end - purge_start );
+        purged_size += purge_end - purge_start;
+      }
+      node->m_Purged = 1;
+    }
+  }
+
+  if( budget )
+  {
+    free_list->m_PurgeParts[level_idx] = INDEX_NONE;
+  }
+  return purged_size;
+}
+
+// Decay driven purge : the clock is only read every HEAP_PURGE_INTERVAL tracker releases && extents are
+// stamped w/ that tick, so ages are coarse. Once the decay passes the levels are swept HEAP_PURGE_BATCH
+// extents at a time, which keeps the cost of a single release bounded. Shared heaps only sweep the level
+// the caller holds
+static void PurgeOnRelease( struct HeapFreeList* free_list, uint32_t level_idx )
+{
+  const bool     shared   = ( free_list->m_InitFlags & k_HeapInitShared ) != 0;
+  const uint32_t releases = shared ? AtomicFetchAdd32( &free_list->m_PurgeReleases, 1 ) + 1 : ++free_list->m_PurgeReleases;
+  if( free_list->m_PurgeDecay == 0 || releases % HEAP_PURGE_INTERVAL )
+  {
+    return;
+  }
+
+  const uint32_t tick = GetTickMs();
+  AtomicStore32( &free_list->m_PurgeTick, tick );
+
+  const uint32_t first_lvl = shared ? level_idx : 0;
+  const uint32_t end_lvl   = shared ? level_idx + 1 : free_list->m_LevelCount;
+
+  uint32_t* last_tick = shared ? &free_list->m_LevelPurgeTicks[level_idx] : &free_list->m_LastPurgeTick;
+  if( tick - *last_tick >= free_list->m_PurgeDecay )
+  {
+    *last_tick = tick;
+    for( uint32_t ilvl = first_lvl; ilvl < end_lvl; ilvl++ )
+    {
+      free_list->m_PurgeParts[ilvl]  = ilvl;
+      free_list->m_PurgeBlocks[ilvl] = 0;
+    }
+  }
+
+  uint32_t budget = HEAP_PURGE_BATCH;
+  for( uint32_t ilvl = first_lvl; ilvl < end_lvl && budget; ilvl++ )
+  {
+    PurgeExtents( free_list, ilvl, free_list->m_PurgeDecay, &budget );
+  }
 }
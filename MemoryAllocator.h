@@ -9,10 +9,18 @@ extern "C"
 #include <stdbool.h>
 #include "DebugLib.h"
 
+#ifndef HEAP_CLASS_STEPS
+#define HEAP_CLASS_STEPS 4 // size classes per doubling past the smallest class ( 1, 2 || 4 )
+#endif
+
+#ifndef HEAP_CLASS_MAX_LOG2
+#define HEAP_CLASS_MAX_LOG2 16 // largest size class is 1 << HEAP_CLASS_MAX_LOG2 ( 6 <= value <= 16 )
+#endif
+
 enum
 {
-  k_HeapBlockPartitionMask = 0xf,
-  k_HeapBlockIndexBitShift = 4,   // How far to shift m_BHIndexNPartition to get index (based on k_PartitionMask )
+  k_HeapBlockPartitionMask = 0xff,
+  k_HeapBlockIndexBitShift = 8,   // How far to shift m_BHIndexNPartition to get index (based on k_PartitionMask )
 };
 
 // Used to track allocated blocks of memory
@@ -32,6 +40,7 @@ struct HeapPartitionData
   uint64_t m_Size;
   uint64_t m_BinCount;
   uint32_t m_BinSize;
+  uint32_t m_Level;   // size level served ( growth segments share their level's bin size )
 };
 
 // Runtime information on partitioned memory
@@ -39,8 +48,46 @@ struct HeapTrackerData
 {
   uint64_t m_HeadIdx;
   uint64_t m_TrackedCount;
-  uint64_t m_PartitionOffset;
   uint64_t m_BinOccupancy;
+  uint64_t m_TreeRoot;      // block index of the root free extent ( k_HeapInitTreeTracker )
+  uint64_t m_CommittedSize; // bytes from the partition start backed by committed pages
+  uint32_t m_Backing;       // k_HeapBacking... flags of every committed range
+  uint32_t m_NextSegment;   // next partition of the same level, 0xffffffff ends the chain
+
+  struct HeapBlockHeader* m_TrackerSlice; // sorted free extents of the partition
+};
+
+enum // free extent index dimensions
+{
+  k_HeapIndexSLLog2  = 3,
+  k_HeapIndexSLCount = 1 << k_HeapIndexSLLog2, // linear steps per power of two
+  k_HeapIndexFLCount = 32,                     // power of two classes (extents are < 2^32 bins)
+};
+
+// Written into the 1st bin of every free extent. Links extents of the same size class together
+// && (with k_HeapInitTreeTracker) all extents of the partition into an address ordered red-black tree
+struct HeapFreeNode
+{
+  uint64_t m_Bins;
+  uint32_t m_Prev;
+  uint32_t m_Next;
+
+  uint32_t m_Left;
+  uint32_t m_Right;
+  uint32_t m_Parent;
+  uint32_t m_Red;
+
+  uint32_t m_Purged;   // pages past the node were handed back to the OS ( HeapPurge )
+  uint32_t m_FreeTick; // coarse ms tick when the extent last changed
+};
+
+// Two-level segregated index (TLSF style) of the free extents in a partition, keyed by extent
+// size in bins. Heads store the block index of the 1st extent in each size class
+struct HeapFreeIndex
+{
+  uint32_t m_FLBitmap;
+  uint32_t m_SLBitmap[k_HeapIndexFLCount];
+  uint32_t m_Heads[k_HeapIndexFLCount][k_HeapIndexSLCount];
 };
 
 enum // sizes of fixed allocation BucketFlags
@@ -48,8 +95,11 @@ enum // sizes of fixed allocation BucketFlags
   k_HeapHintNone        = 0,
   k_HeapHintStrictSize  = 0x1,
 
-  k_HeapNumLvl          = 6,
+  // class 0 is 32 B, every doubling after it is split into HEAP_CLASS_STEPS evenly spaced classes
+  k_HeapClassStepBits   = HEAP_CLASS_STEPS == 4 ? 2 : ( HEAP_CLASS_STEPS == 2 ? 1 : 0 ),
+  k_HeapNumLvl          = 1 + ( HEAP_CLASS_MAX_LOG2 - 5 ) * ( 1 << k_HeapClassStepBits ),
 
+  // strict hints pick the class of the highest level bit set
   k_HeapLevel0          = 0x20,
   k_HeapLevel1          = k_HeapLevel0 << 1,
   k_HeapLevel2          = k_HeapLevel1 << 1,
@@ -58,19 +108,171 @@ enum // sizes of fixed allocation BucketFlags
   k_HeapLevel5          = k_HeapLevel4 << 1,
 };
 
+enum
+{
+  // k_HeapNumLvl base partitions followed by growth segments. The partition mask itself marks large blocks
+  k_HeapMaxSegments   = 32,
+  k_HeapMaxPartitions = k_HeapNumLvl + k_HeapMaxSegments,
+};
+
+// Stack of recently released single bin blocks (headers left intact). Links are stored in the
+// block data
+struct HeapCacheBin
+{
+  void*    m_Head;
+  uint32_t m_Count;
+  uint32_t m_HighWater; // 0 disables caching for the level
+};
+
+enum
+{
+  k_HeapLargeCacheSlots = 8,
+};
+
+// Requests at || above the large threshold get a mapping of their own. The header sits at the front
+// of the page aligned region, right before the data
+struct HeapLargeBlock
+{
+  struct HeapLargeBlock* m_Prev;
+  struct HeapLargeBlock* m_Next;
+  void*                  m_Owner;   // heap that mapped the block
+  uint64_t               m_MapSize;
+  struct HeapBlockHeader m_Header;  // partition bits are k_HeapBlockPartitionMask
+};
+
+// Live large blocks && released regions kept mapped for reuse (oldest first)
+struct HeapLargeList
+{
+  struct HeapLargeBlock* m_Head;
+  struct HeapLargeBlock* m_Cache[k_HeapLargeCacheSlots];
+  uint64_t               m_CacheSizes[k_HeapLargeCacheSlots]; // map size of each cached region, read w/o touching it
+
+  uint64_t m_Threshold; // 0 keeps every request in the partitions
+  uint64_t m_LiveSize;
+  uint64_t m_CacheSize;
+  uint32_t m_LiveCount;
+  uint32_t m_CacheCount;
+};
+
+enum // slab mode dimensions ( k_HeapInitSlab )
+{
+  k_HeapSlabMaxSize  = 64,                               // largest class served from header-less slots
+  k_HeapSlabLvls     = 1 + ( 1 << k_HeapClassStepBits ), // most levels a heap can serve from slabs
+  k_HeapSlabRunWords = 8,                                // bitmap words per run
+  k_HeapSlabRunSlots = k_HeapSlabRunWords * 64,
+};
+
+// Header-less slots of a small level. Slots are grouped in runs of k_HeapSlabRunSlots, set bits are free
+struct HeapSlabData
+{
+  uint64_t* m_RunBits;      // k_HeapSlabRunWords per run
+  uint64_t* m_FreeRuns;     // one bit per run w/ a free slot
+  uint64_t  m_RunCount;
+  uint64_t  m_FreeSlots;
+  uint32_t  m_FreeRunWords;
+  uint32_t  m_HintWord;     // no m_FreeRuns word below this one has a set bit
+};
+
+// Ticket lock of a shared heap ( k_HeapInitShared ), padded so locks of neighbouring levels don't
+// share a cache line
+struct HeapLock
+{
+  uint32_t m_Ticket;
+  uint32_t m_Serving;
+  uint32_t m_Pad[14];
+};
+
+// Counters of a level ( growth segments included ) || of the large blocks. Requests, failures && live bytes
+// are kept up to date by every allocation && release, the free extent fields are filled in by HeapGetStats
+struct HeapPartitionStats
+{
+  uint64_t m_Allocs;
+  uint64_t m_Frees;
+  uint64_t m_FailedNoFreeSpace;   // k_QueryNoFreeSpace : fewer free bins than the request
+  uint64_t m_FailedFragmentation; // k_QueryExcessFragmentation : enough free bins, no extent to hold them
+  uint64_t m_LiveBytes;           // bins held by live blocks, headers included
+  uint64_t m_PeakBytes;
+
+  uint64_t m_FreeBytes;           // free bins, cached blocks included
+  uint64_t m_LargestFreeExtent;   // bytes, rounded down to the size class of the extent ( within 1/8 )
+  uint64_t m_FreeExtentCount;
+  uint32_t m_BinSize;             // bytes per bin, header included ( 0 for the large blocks )
+  uint32_t m_SegmentCount;        // growth segments of the level
+};
+
 // Data structure contains information on current state of managed memory allocations
 struct HeapFreeList
 {
 
-  unsigned char*            m_PartitionLvls[k_HeapNumLvl];
-  struct HeapPartitionData  m_PartitionLvlDetails[k_HeapNumLvl];
+  unsigned char*            m_PartitionLvls[k_HeapMaxPartitions]; // NULL for unused segment slots
+  struct HeapPartitionData  m_PartitionLvlDetails[k_HeapMaxPartitions];
     
   struct HeapBlockHeader*   m_Tracker;
   struct HeapBlockHeader    m_LargestAlloc[k_HeapNumLvl];
-  struct HeapTrackerData    m_TrackerInfo[k_HeapNumLvl];
+  struct HeapTrackerData    m_TrackerInfo[k_HeapMaxPartitions];
+  struct HeapFreeIndex      m_FreeIndex[k_HeapMaxPartitions];
+  struct HeapCacheBin       m_Cache[k_HeapNumLvl];
+  struct HeapLargeList      m_Large;
+  struct HeapSlabData       m_Slab[k_HeapSlabLvls];
 
   uint64_t       m_TotalPartitionSize;
   uint64_t       m_TotalPartitionBins;
+  uint32_t       m_InitFlags;
+
+  uint32_t       m_LevelSizes[k_HeapNumLvl]; // bytes per bin of each level, header excluded
+  uint32_t       m_LevelCount;
+  uint32_t       m_SlabLvls;                 // leading levels served from slabs ( k_HeapInitSlab )
+  bool           m_CustomLevels;             // levels came from a HeapConfig, sizes are looked up
+
+  uint32_t       m_PurgeDecay;     // ms a free extent stays resident before releases purge it, 0 disables
+  uint32_t       m_PurgeTick;      // coarse ms clock, refreshed every few tracker releases
+  uint32_t       m_LastPurgeTick;
+  uint32_t       m_PurgeReleases;  // tracker releases, the clock is read every HEAP_PURGE_INTERVAL of them
+
+  // k_HeapInitShared : a level's partitions, segments, cache && slab are only touched under its lock
+  struct HeapLock m_LevelLocks[k_HeapNumLvl];
+  struct HeapLock m_SegmentLock;                   // growth segment slots && heap totals
+  struct HeapLock m_LargeLock;                     // large block list && cache
+  uint32_t        m_LevelPurgeTicks[k_HeapNumLvl]; // last decay purge of each level
+  uint32_t        m_PurgeParts[k_HeapNumLvl];      // partition a level's decay purge resumes in, 0xffffffff once swept
+  uint64_t        m_PurgeBlocks[k_HeapNumLvl];     // block index it resumes at
+
+  // HeapGetStats counters, updated under the level ( || large ) lock
+  struct HeapPartitionStats m_Stats[k_HeapNumLvl];
+  struct HeapPartitionStats m_LargeStats;
+};
+
+enum // heap creation options
+{
+  k_HeapInitNone        = 0,
+  k_HeapInitTreeTracker = 0x1, // track free extents in a red-black tree instead of the sorted tracker array
+  k_HeapInitHugePages   = 0x2, // 2 mB align partitions && back them w/ huge pages ( tracker stays on normal pages )
+  k_HeapInitFixedSize   = 0x4, // never chain growth segments to an exhausted level
+  k_HeapInitSlab        = 0x8, // serve the classes up to 64 B from header-less bitmap slabs ( no TAG_MEMORY tags )
+  k_HeapInitShared      = 0x10, // several threads use the heap through its thread_id, w/ a lock per size class
+};
+
+// Size classes && partition split of a heap. Sizes ascend, are multiples of 8 B && start at 32 B or more.
+// Sizes that are all multiples of 16 B hand out 16 B aligned blocks ( w/o TAG_MEMORY's larger header )
+struct HeapConfig
+{
+  uint32_t m_LevelCount;                // 1 -> k_HeapNumLvl
+  uint32_t m_LevelSizes[k_HeapNumLvl];
+  uint32_t m_LevelShares[k_HeapNumLvl]; // relative weight of each level's partition
+};
+
+enum // backing a partition got from the system ( flags, a partition can end up w/ several )
+{
+  k_HeapBackingPages           = 0x1,
+  k_HeapBackingHugeTLB         = 0x2, // MAP_HUGETLB
+  k_HeapBackingTransparentHuge = 0x4, // madvise( MADV_HUGEPAGE ) fallback
+};
+
+enum
+{
+  // Pass as thread_id to use the calling thread's own heap, created on first use. Once the thread
+  // exits the heap is released, || handed to the next thread as is while other threads hold its blocks
+  k_HeapThreadAuto = 0x7fffffff,
 };
 
 // Over estimate size. Current calculations reduce available size due to the need to
@@ -78,13 +280,74 @@ struct HeapFreeList
 // Passing in zero to both parameters means set to default size && thread
 void HeapInitBase( uint64_t alloc_size /* = 0 */, uint32_t thread_id /* = 0 */ );
 
-// Query the status of the heap contained in the thread ( 0 means main thread )
+// init_flags are an enum : k_HeapInit...
+void HeapInitBaseEx( uint64_t alloc_size /* = 0 */, uint32_t init_flags /* = k_HeapInitNone */, uint32_t thread_id /* = 0 */ );
+
+// Heap w/ its own size classes ( NULL config uses the HEAP_CLASS_... layout ). See Heap::Config for
+// tables generated at compile time
+void HeapInitBaseConfig( uint64_t alloc_size, uint32_t init_flags, const struct HeapConfig* config, uint32_t thread_id );
+
+// Query the status of the heap contained in the thread ( 0 means main thread ). A heap whose init ran
+// out of memory stays invalid, its allocations return NULL
 bool HeapQueryBaseIsValid( uint32_t thread_id /* = 0 */ );
 
+// Settings used when a thread's heap is created on first use of k_HeapThreadAuto
+void HeapSetAutoInit( uint64_t alloc_size /* = 0 */, uint32_t init_flags /* = k_HeapInitNone */ );
+
+// Size classes of the heaps created on first use of k_HeapThreadAuto, the table is copied ( NULL
+// restores the HEAP_CLASS_... layout )
+void HeapSetAutoConfig( const struct HeapConfig* config );
+
+// Id of the calling thread's own heap ( binds the thread if needed )
+uint32_t HeapGetThreadId();
+
 // hints are an enum : k_HeapHint... | k_HeapLevel...
 void* HeapAllocate( uint64_t byte_size, uint32_t bucket_hints /* = k_HeapHintNone */, uint8_t block_size /* = 0 */, uint64_t debug_hash /* = 0 */, uint32_t thread_id /* = 0 */ );
 
+// Skips the size class lookup : level_idx is the class of byte_size in the heap's config ( Heap::Config
+// resolves it at compile time ). Larger sizes take several bins of the level
+void* HeapAllocateLevel( uint64_t byte_size, uint32_t level_idx, uint64_t debug_hash /* = 0 */, uint32_t thread_id /* = 0 */ );
+
+// Returned address is a multiple of alignment ( power of two, up to the page size ). Release w/ HeapRelease
+void* HeapAllocateAligned( uint64_t byte_size, uint32_t alignment, uint64_t debug_hash /* = 0 */, uint32_t thread_id /* = 0 */ );
+
 bool  HeapRelease( void* data_ptr, uint32_t thread_id /* = 0 */ );
+
+// byte_size is what the block was requested w/. Blocks too large for a slab slot skip the slab range checks
+bool  HeapReleaseSized( void* data_ptr, uint64_t byte_size, uint32_t thread_id /* = 0 */ );
+
+// Carve up to count blocks of byte_size from as few free extents as possible. Returns how many were
+// written to out_ptrs
+uint32_t HeapAllocateBatch( uint64_t byte_size, uint32_t count, void* out_ptrs[], uint32_t thread_id /* = 0 */ );
+
+// Release count blocks, merging them into the tracker in one pass per partition. Contents of ptrs are
+// reordered ( NULL entries are skipped )
+void HeapReleaseBatch( void* ptrs[], uint32_t count, uint32_t thread_id /* = 0 */ );
+
+// Resize a block, growing into the free bins right after it || returning its tail when possible && moving
+// it otherwise ( a moved block loses any extra alignment ). NULL data_ptr allocates, zero byte_size releases
+void* HeapReallocate( void* data_ptr, uint64_t byte_size, uint32_t thread_id /* = 0 */ );
+
+// Bytes the block can hold, bins past the requested size included
+uint64_t HeapUsableSize( void* data_ptr );
+
+// Heaps keep up to high_water released single bin blocks per level (level_idx : 0 -> 32 B class, ...)
+// to hand straight back to the next request. Reaching the mark returns the older half to the tracker
+void HeapSetCacheLimit( uint32_t level_idx, uint32_t high_water, uint32_t thread_id /* = 0 */ );
+
+// Return every cached block to the tracker, unmap cached large regions && empty growth segments
+void HeapFlushCache( uint32_t thread_id /* = 0 */ );
+
+// Requests of at least threshold bytes are mapped directly instead of carved from the partitions
+// ( 0 disables the large path )
+void HeapSetLargeThreshold( uint64_t threshold, uint32_t thread_id /* = 0 */ );
+
+// Hand the pages of large free extents back to the OS ( && unmap cached large regions ). Purged extents
+// stay mapped, a later allocation faults them back in as zeroed pages. Returns bytes purged
+uint64_t HeapPurge( uint32_t thread_id /* = 0 */ );
+
+// Free extents idle for decay_ms get purged as the heap keeps releasing blocks ( 0 disables )
+void HeapSetPurgeDecay( uint32_t decay_ms, uint32_t thread_id /* = 0 */ );
   
 enum
 {
@@ -92,14 +355,15 @@ enum
   k_QueryNoFreeSpace         = 0x2,
   k_QueryExcessFragmentation = 0x4,
 
-  // can only use flags up to and not including 0x20
+  // can only use flags up to and not including 0x8 ( class sizes are multiples of 8 )
 };
     
 struct HeapQueryResult
 {
   uint64_t     m_AllocBins;
-  uint64_t     m_TrackerSelectedIdx;
+  uint64_t     m_TrackerSelectedIdx; // tracker array position, or block index of the extent w/ k_HeapInitTreeTracker
   uint32_t     m_Status;
+  uint32_t     m_PartitionIdx;       // base partition or growth segment holding the extent
 };
 
 // Contains heuristics for what bucket the allocation will take place in
@@ -108,6 +372,62 @@ struct HeapQueryResult HeapCalcAllocPartitionAndSize( uint64_t alloc_size, uint3
 // Dump detailed contents of memory state
 void HeapPrintStatus( uint32_t thread_id );
 
+struct HeapStats
+{
+  struct HeapPartitionStats m_Levels[k_HeapNumLvl];
+  struct HeapPartitionStats m_Large;      // free extent fields describe the mapped regions kept for reuse
+  uint32_t                  m_LevelCount;
+};
+
+// Counters of every level w/o walking the free extents, cheap enough to poll. A heap that isn't shared
+// ( k_HeapInitShared ) may be read a few requests behind from other threads. False for an uninitialized heap
+bool HeapGetStats( uint32_t thread_id, struct HeapStats* stats );
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+enum // trace record ops. A block is identified by the address its allocation returned
+{
+  k_HeapTraceAlloc        = 1, // HeapAllocate && HeapAllocateBatch ( m_Hints : bucket hints )
+  k_HeapTraceAllocLevel   = 2, // HeapAllocateLevel ( m_Hints : level index of the recorded config )
+  k_HeapTraceAllocAligned = 3, // HeapAllocateAligned ( m_Hints : alignment )
+  k_HeapTraceRelease      = 4, // HeapRelease, HeapReleaseSized && HeapReleaseBatch ( m_Size : size passed in || 0 )
+  k_HeapTraceRealloc      = 5, // HeapReallocate ( m_Extra : address passed in )
+
+  k_HeapTraceMagic   = 0x43525448, // "HTRC"
+  k_HeapTraceVersion = 1,
+};
+
+// Front of a trace file, followed by the records
+struct HeapTraceHeader
+{
+  uint32_t m_Magic;
+  uint32_t m_Version;
+  uint32_t m_RecordSize;
+  uint32_t m_Pad;
+};
+
+struct HeapTraceRecord
+{
+  uint64_t m_TimeNs;    // since HeapTraceStart
+  uint64_t m_Ptr;       // block returned || released, 0 for a failed request
+  uint64_t m_Size;
+  uint64_t m_Extra;     // debug_hash of allocations
+  uint32_t m_ThreadId;  // heap the request went to
+  uint32_t m_Hints;
+  uint8_t  m_Op;        // k_HeapTrace...
+  uint8_t  m_BlockSize;
+  uint16_t m_Pad;
+};
+
+// Append a record for every allocation && release of every heap to path. Allocations are recorded once
+// they return && releases before the block is handed back, so addresses reused by other threads keep
+// their order. Needs a build w/ HEAP_TRACE defined, returns false otherwise || when path can't be opened
+bool HeapTraceStart( const char* path );
+
+// Write out the buffered records && close the trace
+void HeapTraceStop();
+
 //----------------------------------------------------------------------------------------------
 //----------------------------------------------------------------------------------------------
   
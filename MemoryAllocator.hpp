@@ -1,12 +1,23 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "DebugLib.h"
 #include "MemoryAllocator.h"
 
-#ifndef HEAP_SCOPED_STACK_DEPTH
-  #define HEAP_SCOPED_STACK_DEPTH 64
-#endif // !HEAP_SCOPED_STACK_DEPTH
+#if __cplusplus >= 201703L && defined( __has_include )
+  #if __has_include( <memory_resource> )
+    #include <memory_resource>
+    #define HEAP_MEMORY_RESOURCE 1
+  #endif
+#endif
+
+#ifndef HEAP_ARENA_CHUNK_SIZE
+  #define HEAP_ARENA_CHUNK_SIZE ( ( 0x1 << 16 ) - 16 ) // stays below the large threshold, chunks are carved from partitions
+#endif // !HEAP_ARENA_CHUNK_SIZE
 
 
 namespace Heap
@@ -28,26 +39,118 @@ namespace Heap
 
   // Over estimate size. Current calculations reduce available size due to the need to
   // create memory management data structures
-  inline void InitBase( uint32_t alloc_size = 0, uint32_t thread_id = 0 )
+  inline void InitBase( uint64_t alloc_size = 0, uint32_t thread_id = 0 )
   {
     HeapInitBase( alloc_size, thread_id );
   }
 
+  enum : uint32_t
+  {
+    k_InitNone        = k_HeapInitNone,
+    k_InitTreeTracker = k_HeapInitTreeTracker,
+    k_InitHugePages   = k_HeapInitHugePages,
+    k_InitFixedSize   = k_HeapInitFixedSize,
+    k_InitSlab        = k_HeapInitSlab,
+    k_InitShared      = k_HeapInitShared,
+  };
+
+  // init_flags are an enum : k_Init...
+  inline void InitBaseEx( uint64_t alloc_size = 0, uint32_t init_flags = k_InitNone, uint32_t thread_id = 0 )
+  {
+    HeapInitBaseEx( alloc_size, init_flags, thread_id );
+  }
+
   inline bool QueryBaseValidity( uint32_t thread_id = 0 )
   {
     return HeapQueryBaseIsValid( thread_id );
   }
 
+  // Pass as thread_id to use the calling thread's own heap, created on first use
+  static const uint32_t k_ThreadAuto = k_HeapThreadAuto;
+
+  inline void SetAutoInit( uint64_t alloc_size = 0, uint32_t init_flags = k_InitNone )
+  {
+    HeapSetAutoInit( alloc_size, init_flags );
+  }
+
+  inline void SetAutoConfig( const HeapConfig* config )
+  {
+    HeapSetAutoConfig( config );
+  }
+
+  inline uint32_t GetThreadId()
+  {
+    return HeapGetThreadId();
+  }
+
   // hints are an enum : k_Hint... | k_Level...
   inline void* Alloc( uint32_t byte_size, uint32_t bucket_hints = k_HintNone, uint8_t block_size = 4, uint64_t debug_hash = 0, uint32_t thread_id = 0 )
   {
     return HeapAllocate( byte_size, bucket_hints, block_size, debug_hash, thread_id );
   }
 
+  // alignment is a power of two up to the page size
+  inline void* AllocAligned( uint64_t byte_size, uint32_t alignment, uint64_t debug_hash = 0, uint32_t thread_id = 0 )
+  {
+    return HeapAllocateAligned( byte_size, alignment, debug_hash, thread_id );
+  }
+
   inline bool Free( void* data_ptr, uint32_t thread_id = 0 )
   {
     return HeapRelease( data_ptr, thread_id );
   }
+
+  // byte_size is the size data_ptr was requested w/
+  inline bool FreeSized( void* data_ptr, uint64_t byte_size, uint32_t thread_id = 0 )
+  {
+    return HeapReleaseSized( data_ptr, byte_size, thread_id );
+  }
+
+  inline uint32_t AllocBatch( uint64_t byte_size, uint32_t count, void* out_ptrs[], uint32_t thread_id = 0 )
+  {
+    return HeapAllocateBatch( byte_size, count, out_ptrs, thread_id );
+  }
+
+  inline void FreeBatch( void* ptrs[], uint32_t count, uint32_t thread_id = 0 )
+  {
+    HeapReleaseBatch( ptrs, count, thread_id );
+  }
+
+  inline void* Realloc( void* data_ptr, uint64_t byte_size, uint32_t thread_id = 0 )
+  {
+    return HeapReallocate( data_ptr, byte_size, thread_id );
+  }
+
+  inline uint64_t UsableSize( void* data_ptr )
+  {
+    return HeapUsableSize( data_ptr );
+  }
+  
+  // Cached single bin blocks per level ( 0 disables the cache for that level )
+  inline void SetCacheLimit( uint32_t level_idx, uint32_t high_water, uint32_t thread_id = 0 )
+  {
+    HeapSetCacheLimit( level_idx, high_water, thread_id );
+  }
+
+  inline void FlushCache( uint32_t thread_id = 0 )
+  {
+    HeapFlushCache( thread_id );
+  }
+
+  inline void SetLargeThreshold( uint64_t threshold, uint32_t thread_id = 0 )
+  {
+    HeapSetLargeThreshold( threshold, thread_id );
+  }
+
+  inline uint64_t Purge( uint32_t thread_id = 0 )
+  {
+    return HeapPurge( thread_id );
+  }
+
+  inline void SetPurgeDecay( uint32_t decay_ms, uint32_t thread_id = 0 )
+  {
+    HeapSetPurgeDecay( decay_ms, thread_id );
+  }
   
   template<typename T>
   T* AllocT( uint32_t count )
@@ -55,6 +158,12 @@ namespace Heap
     return (T*)Alloc( sizeof( T ) * count );
   }
 
+  template<typename T>
+  T* AllocAligned( uint32_t count, uint32_t alignment = alignof( T ), uint32_t thread_id = 0 )
+  {
+    return (T*)AllocAligned( sizeof( T ) * count, alignment, 0, thread_id );
+  }
+
   // Contains heuristics for what bucket the allocation will take place in
   inline HeapQueryResult CalcAllocPartitionAndSize( uint32_t alloc_size, uint32_t bucket_hint = k_HintNone, uint32_t thread_id = 0 )
   {
@@ -66,45 +175,621 @@ namespace Heap
   {
     HeapPrintStatus( thread_id );
   }
-  
+
+  // Counters of every level && the large blocks, O(levels)
+  inline bool GetStats( HeapStats* stats, uint32_t thread_id = 0 )
+  {
+    return HeapGetStats( thread_id, stats );
+  }
+
+  // Record every allocation && release to path ( HEAP_TRACE builds, see mem_alloc_replay )
+  inline bool TraceStart( const char* path )
+  {
+    return HeapTraceStart( path );
+  }
+
+  inline void TraceStop()
+  {
+    HeapTraceStop();
+  }
+
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+  // Size classes of a heap built at compile time. Class 0 is 32 B, every doubling after it holds
+  // ClassSteps evenly spaced classes up to 1 << ClassMaxLog2. Each power of two range gets
+  // min( ShareStep * ( range + 1 ), ShareMax ) of the partition split, spread over its classes.
+  // Heaps set up through Config<...>::InitBase can live next to differently tuned ones ( one per thread id )
+  template< uint32_t ClassSteps = HEAP_CLASS_STEPS, uint32_t ClassMaxLog2 = HEAP_CLASS_MAX_LOG2, uint32_t ShareStep = 5, uint32_t ShareMax = 25 >
+  struct Config
+  {
+    static_assert( ClassSteps == 1 || ClassSteps == 2 || ClassSteps == 4, "ClassSteps must be 1, 2 or 4" );
+    static_assert( ClassMaxLog2 > 5 && ClassMaxLog2 < 32, "ClassMaxLog2 out of range" );
+
+    static constexpr uint32_t k_StepBits   = ClassSteps == 4 ? 2 : ( ClassSteps == 2 ? 1 : 0 );
+    static constexpr uint32_t k_LevelCount = 1 + ( ClassMaxLog2 - 5 ) * ClassSteps;
+
+    static_assert( k_LevelCount <= k_HeapNumLvl, "More classes than base partitions ( raise HEAP_CLASS_STEPS || HEAP_CLASS_MAX_LOG2 )" );
+
+    static constexpr uint32_t LevelSize( uint32_t level_idx )
+    {
+      return level_idx == 0 ? 32 : ( 1u << ( 5 + ( ( level_idx - 1 ) >> k_StepBits ) ) ) + ( ( ( ( level_idx - 1 ) & ( ClassSteps - 1 ) ) + 1 ) << ( 5 + ( ( level_idx - 1 ) >> k_StepBits ) - k_StepBits ) );
+    }
+
+    static constexpr uint32_t LevelShare( uint32_t level_idx )
+    {
+      const uint32_t range  = level_idx == 0 ? 0 : 1 + ( ( level_idx - 1 ) >> k_StepBits );
+      const uint32_t weight = ShareStep * ( range + 1 ) < ShareMax ? ShareStep * ( range + 1 ) : ShareMax;
+
+      return level_idx == 0 ? weight * ClassSteps : weight;
+    }
+
+    // 1st class that holds byte_size, the last one takes anything larger
+    static constexpr uint32_t SelectLevel( uint64_t byte_size )
+    {
+      uint32_t level_idx = 0;
+      while( level_idx + 1 < k_LevelCount && LevelSize( level_idx ) < byte_size )
+      {
+        level_idx++;
+      }
+      return level_idx;
+    }
+
+    static HeapConfig Table()
+    {
+      HeapConfig config = {};
+      config.m_LevelCount = k_LevelCount;
+      for( uint32_t ilvl = 0; ilvl < k_LevelCount; ilvl++ )
+      {
+        config.m_LevelSizes[ilvl]  = LevelSize( ilvl );
+        config.m_LevelShares[ilvl] = LevelShare( ilvl );
+      }
+      return config;
+    }
+
+    // init_flags are an enum : k_Init...
+    static void InitBase( uint64_t alloc_size = 0, uint32_t init_flags = k_InitNone, uint32_t thread_id = 0 )
+    {
+      const HeapConfig config = Table();
+      HeapInitBaseConfig( alloc_size, init_flags, &config, thread_id );
+    }
+
+    // Class of a constant size is folded in, the heap skips its own lookup
+    template< uint64_t ByteSize >
+    static void* Alloc( uint64_t debug_hash = 0, uint32_t thread_id = 0 )
+    {
+      static_assert( ByteSize > 0, "Zero sized allocation" );
+      constexpr uint32_t k_Level = SelectLevel( ( ByteSize + 7 ) & ~(uint64_t)7 );
+      return HeapAllocateLevel( ByteSize, k_Level, debug_hash, thread_id );
+    }
+
+    template< typename T >
+    static T* AllocT( uint32_t thread_id = 0 )
+    {
+      return (T*)Alloc< sizeof( T ) >( 0, thread_id );
+    }
+  };
+
+  using DefaultConfig = Config<>;
+
 
 //----------------------------------------------------------------------------------------------
 //----------------------------------------------------------------------------------------------
 
+  // Bump allocator over chunks taken from a heap. Nothing is released on its own : Reset() && Rollback()
+  // rewind in O(1) && keep the chunks for the next pass, the destructor hands them back to the heap
+  class LinearArena
+  {
+  public:
+    struct Marker
+    {
+      void*    m_Chunk;
+      uint64_t m_Offset;
+    };
+
+    LinearArena( uint64_t chunk_size = HEAP_ARENA_CHUNK_SIZE, uint32_t thread_id = 0 ) : m_ChunkSize( chunk_size ), m_ThreadId( thread_id ) {}
+    LinearArena( const LinearArena& )            = delete;
+    LinearArena& operator=( const LinearArena& ) = delete;
+    ~LinearArena()
+    {
+      while( m_Head )
+      {
+        Chunk* next = m_Head->m_Next;
+        HeapRelease( m_Head, m_ThreadId );
+        m_Head = next;
+      }
+    }
+
+    // alignment is a power of two
+    void* Alloc( uint64_t byte_size, uint32_t alignment = 8 )
+    {
+      uintptr_t data = m_Current ? Align( (uintptr_t)m_Current + m_Offset, alignment ) : 0;
+      if( m_Current == nullptr || data + byte_size > (uintptr_t)m_Current + m_Current->m_Size )
+      {
+        // spare chunk left by a rewind, || a new one chained right after the current chunk
+        const uint64_t min_size = sizeof( Chunk ) + byte_size + alignment;
+        Chunk*         next     = m_Current ? m_Current->m_Next : m_Head;
+        if( next == nullptr || next->m_Size < min_size )
+        {
+          const uint64_t chunk_size = min_size > m_ChunkSize ? min_size : m_ChunkSize;
+
+          Chunk* chunk = (Chunk*)HeapAllocate( chunk_size, k_HintNone, 0, 0, m_ThreadId );
+          if( chunk == nullptr )
+          {
+            return nullptr;
+          }
+          chunk->m_Size = chunk_size;
+          chunk->m_Next = next;
+          ( m_Current ? m_Current->m_Next : m_Head ) = chunk;
+          next = chunk;
+        }
+
+        m_Current = next;
+        data      = Align( (uintptr_t)m_Current + sizeof( Chunk ), alignment );
+      }
+
+      m_Offset = data + byte_size - (uintptr_t)m_Current;
+      return (void*)data;
+    }
+
+    template< typename T >
+    T* AllocT( uint32_t count = 1 )
+    {
+      return (T*)Alloc( sizeof( T ) * count, alignof( T ) );
+    }
+
+    Marker GetMarker() const
+    {
+      return Marker{ m_Current, m_Offset };
+    }
+
+    // Everything allocated after the marker was taken is dropped
+    void Rollback( const Marker& marker )
+    {
+      m_Current = (Chunk*)marker.m_Chunk;
+      m_Offset  = marker.m_Offset;
+    }
+
+    void Reset()
+    {
+      m_Current = nullptr;
+      m_Offset  = 0;
+    }
+
+  private:
+    struct Chunk
+    {
+      Chunk*   m_Next;
+      uint64_t m_Size;
+    };
+
+    static uintptr_t Align( uintptr_t address, uint32_t alignment )
+    {
+      return ( address + alignment - 1 ) & ~( (uintptr_t)alignment - 1 );
+    }
+
+    Chunk*   m_Head      = nullptr;
+    Chunk*   m_Current   = nullptr;
+    uint64_t m_Offset    = 0;
+    uint64_t m_ChunkSize = 0;
+    uint32_t m_ThreadId  = 0;
+  };
+
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+  // Everything allocated through it goes away w/ the scope : requests are bumped out of arena chunks,
+  // which are handed back to the heap at once. Objects from New<T>() are destroyed in reverse order,
+  // trivially destructible ones w/o any bookkeeping. A Scope rewinds the allocator when it exits,
+  // the allocator itself must not be used for allocations that outlive it meanwhile
   class ScopedAllocator
   {
+    struct Finalizer
+    {
+      void       ( *m_Destroy )( void* object, uint32_t count );
+      void*      m_Object;
+      uint32_t   m_Count;
+      Finalizer* m_Prev;
+    };
+
   public:
-    ScopedAllocator( uint32_t thread_id = 0 ) : m_ThreadId( thread_id ) {}
+    class Scope
+    {
+    public:
+      Scope( ScopedAllocator& allocator ) : m_Allocator( allocator ), m_Marker( allocator.m_Arena.GetMarker() ), m_Finalizers( allocator.m_Finalizers ) {}
+      Scope( const Scope& )            = delete;
+      Scope& operator=( const Scope& ) = delete;
+      ~Scope()
+      {
+        m_Allocator.Finalize( m_Finalizers );
+        m_Allocator.m_Arena.Rollback( m_Marker );
+      }
+
+    private:
+      ScopedAllocator&          m_Allocator;
+      const LinearArena::Marker m_Marker;
+      Finalizer* const          m_Finalizers;
+    };
+
+    ScopedAllocator( uint32_t thread_id = 0 ) : m_Arena( HEAP_ARENA_CHUNK_SIZE, thread_id ) {}
+    ScopedAllocator( const ScopedAllocator& )            = delete;
+    ScopedAllocator& operator=( const ScopedAllocator& ) = delete;
     ~ScopedAllocator()
     {
-      for( uint32_t iptr = 0; iptr < m_StackDepth; iptr++ )
+      Finalize( nullptr );
+    }
+
+    void* Alloc( uint64_t byte_size, uint32_t alignment = 8 )
+    {
+      return m_Arena.Alloc( byte_size, alignment );
+    }
+
+    template< typename T >
+    T* AllocT( uint32_t count = 1 )
+    {
+      return (T*)Alloc( sizeof( T ) * count, alignof( T ) < 8 ? 8 : alignof( T ) );
+    }
+
+    // Objects are only tracked once constructed, a throwing constructor leaves nothing to destroy
+    template< typename T, typename... Args >
+    T* New( Args&&... args )
+    {
+      T* object = AllocT<T>();
+      if( object == nullptr )
+      {
+        return nullptr;
+      }
+      new( object ) T( std::forward<Args>( args )... );
+
+      if( !Track<T>( object, 1 ) )
       {
-        HeapRelease( m_PtrStack[iptr], m_ThreadId );
+        object->~T();
+        return nullptr;
       }
+      return object;
     }
 
-    void* Alloc( uint32_t byte_size, uint8_t block_size = 4, uint64_t debug_hash = 0 )
+    // count default constructed objects
+    template< typename T >
+    T* NewArray( uint32_t count )
     {
-      if( m_StackDepth == HEAP_SCOPED_STACK_DEPTH )
+      T* objects = AllocT<T>( count );
+      if( objects == nullptr )
+      {
+        return nullptr;
+      }
+
+      uint32_t built_count = 0;
+      try
+      {
+        for( ; built_count < count; built_count++ )
+        {
+          new( objects + built_count ) T();
+        }
+      }
+      catch( ... )
       {
+        Destroy( objects, built_count );
+        throw;
+      }
+
+      if( !Track<T>( objects, count ) )
+      {
+        Destroy( objects, count );
         return nullptr;
       }
+      return objects;
+    }
 
-      m_PtrStack[m_StackDepth] = HeapAllocate( byte_size, Heap::k_HintNone, block_size, debug_hash, m_ThreadId );
-      m_StackDepth++;
+  private:
+    template< typename T >
+    bool Track( T* objects, uint32_t count )
+    {
+      if( std::is_trivially_destructible<T>::value )
+      {
+        return true;
+      }
 
-      return m_PtrStack[m_StackDepth - 1];
+      Finalizer* finalizer = AllocT<Finalizer>();
+      if( finalizer == nullptr )
+      {
+        return false;
+      }
+      finalizer->m_Destroy = []( void* object, uint32_t object_count )
+      {
+        Destroy( (T*)object, object_count );
+      };
+      finalizer->m_Object = objects;
+      finalizer->m_Count  = count;
+      finalizer->m_Prev   = m_Finalizers;
+      m_Finalizers        = finalizer;
+      return true;
     }
 
+    // In reverse order of construction
     template< typename T >
-    T* AllocT( uint32_t count = 1, uint64_t debug_hash = 0  )
+    static void Destroy( T* objects, uint32_t count )
+    {
+      for( uint32_t iobj = count; iobj > 0; iobj-- )
+      {
+        objects[iobj - 1].~T();
+      }
+    }
+
+    // Destroys the objects created since last_finalizer was the newest
+    void Finalize( Finalizer* last_finalizer )
     {
-      return (T*)Alloc( sizeof( T ) * count, 1, debug_hash );
+      while( m_Finalizers != last_finalizer )
+      {
+        m_Finalizers->m_Destroy( m_Finalizers->m_Object, m_Finalizers->m_Count );
+        m_Finalizers = m_Finalizers->m_Prev;
+      }
     }
+
+    LinearArena m_Arena;
+    Finalizer*  m_Finalizers = nullptr;
+  };
+
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+  // Blocks of byte_size aligned to alignment from the heap of thread_id ( zero sized requests get a byte )
+  inline void* AllocFor( uint64_t byte_size, uint64_t alignment, uint32_t thread_id )
+  {
+    byte_size = byte_size ? byte_size : 1;
+    return alignment > 8 ? HeapAllocateAligned( byte_size, (uint32_t)alignment, 0, thread_id ) : HeapAllocate( byte_size, k_HintNone, 0, 0, thread_id );
+  }
+
+  // Standard allocator over the heap of a thread id, for std:: containers. Copies && rebinds share the heap
+  template< typename T >
+  class StlAllocator
+  {
+  public:
+    using value_type = T;
+
+    StlAllocator( uint32_t thread_id = 0 ) noexcept : m_ThreadId( thread_id ) {}
+
+    template< typename U >
+    StlAllocator( const StlAllocator<U>& other ) noexcept : m_ThreadId( other.ThreadId() ) {}
+
+    T* allocate( size_t count )
+    {
+      if( count > (size_t)-1 / sizeof( T ) )
+      {
+        throw std::bad_array_new_length();
+      }
+
+      void* data = AllocFor( sizeof( T ) * count, alignof( T ), m_ThreadId );
+      if( data == nullptr )
+      {
+        throw std::bad_alloc();
+      }
+      return (T*)data;
+    }
+
+    void deallocate( T* data, size_t count ) noexcept
+    {
+      HeapReleaseSized( data, sizeof( T ) * ( count ? count : 1 ), m_ThreadId );
+    }
+
+    uint32_t ThreadId() const noexcept
+    {
+      return m_ThreadId;
+    }
+
   private:
-    void*    m_PtrStack[HEAP_SCOPED_STACK_DEPTH];
-    uint32_t m_ThreadId   = 0;
-    uint32_t m_StackDepth = 0;
+    uint32_t m_ThreadId;
   };
-};
 
+  template< typename T, typename U >
+  bool operator==( const StlAllocator<T>& lhs, const StlAllocator<U>& rhs ) noexcept
+  {
+    return lhs.ThreadId() == rhs.ThreadId();
+  }
+
+  template< typename T, typename U >
+  bool operator!=( const StlAllocator<T>& lhs, const StlAllocator<U>& rhs ) noexcept
+  {
+    return lhs.ThreadId() != rhs.ThreadId();
+  }
+
+#ifdef HEAP_MEMORY_RESOURCE
+  // Upstream resource for std::pmr containers && pools ( C++17 )
+  class MemoryResource : public std::pmr::memory_resource
+  {
+  public:
+    explicit MemoryResource( uint32_t thread_id = 0 ) noexcept : m_ThreadId( thread_id ) {}
+
+    uint32_t ThreadId() const noexcept
+    {
+      return m_ThreadId;
+    }
+
+  private:
+    void* do_allocate( size_t byte_size, size_t alignment ) override
+    {
+      void* data = AllocFor( byte_size, alignment, m_ThreadId );
+      if( data == nullptr )
+      {
+        throw std::bad_alloc();
+      }
+      return data;
+    }
+
+    void do_deallocate( void* data, size_t byte_size, size_t ) override
+    {
+      HeapReleaseSized( data, byte_size ? byte_size : 1, m_ThreadId );
+    }
+
+    bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override
+    {
+      const MemoryResource* heap_resource = dynamic_cast<const MemoryResource*>( &other );
+      return heap_resource && heap_resource->m_ThreadId == m_ThreadId;
+    }
+
+    uint32_t m_ThreadId;
+  };
+#endif // HEAP_MEMORY_RESOURCE
+
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+  // Fixed size slots for one type, carved out of runs of run_slots slots taken from the heap in one
+  // block each. Free slots form an intrusive list, so Create && Destroy are a pop && a push. Runs are
+  // only handed back by Clear() ( || the destructor ), which also destroys the objects still alive
+  template< typename T >
+  class ObjectPool
+  {
+    union Slot
+    {
+      Slot* m_Next;
+      alignas( T ) unsigned char m_Data[sizeof( T )];
+    };
+
+    struct Run
+    {
+      Run* m_Next;
+    };
+
+    // slots start right after the run link, keeping their alignment
+    static constexpr size_t k_RunHeader = ( sizeof( Run ) + alignof( Slot ) - 1 ) & ~( alignof( Slot ) - 1 );
+
+  public:
+    ObjectPool( uint32_t run_slots = 256, uint32_t thread_id = 0 ) : m_RunSlots( run_slots ? run_slots : 1 ), m_ThreadId( thread_id ) {}
+    ObjectPool( const ObjectPool& )            = delete;
+    ObjectPool& operator=( const ObjectPool& ) = delete;
+    ~ObjectPool()
+    {
+      Clear();
+    }
+
+    template< typename... Args >
+    T* Create( Args&&... args )
+    {
+      if( m_FreeSlots == nullptr && !AddRun() )
+      {
+        return nullptr;
+      }
+
+      // a throwing constructor puts the slot back, it never held an object
+      Slot* slot  = m_FreeSlots;
+      m_FreeSlots = slot->m_Next;
+
+      T* object;
+      try
+      {
+        object = new( slot->m_Data ) T( std::forward<Args>( args )... );
+      }
+      catch( ... )
+      {
+        slot->m_Next = m_FreeSlots;
+        m_FreeSlots  = slot;
+        throw;
+      }
+
+      m_LiveCount++;
+      return object;
+    }
+
+    void Destroy( T* object )
+    {
+      if( object == nullptr )
+      {
+        return;
+      }
+
+      object->~T();
+
+      Slot* slot   = (Slot*)object;
+      slot->m_Next = m_FreeSlots;
+      m_FreeSlots  = slot;
+      m_LiveCount--;
+    }
+
+    // Destroys the live objects && releases every run
+    void Clear()
+    {
+      if( !std::is_trivially_destructible<T>::value && m_LiveCount )
+      {
+        DestroyLive();
+      }
+
+      while( m_Runs )
+      {
+        Run* next = m_Runs->m_Next;
+        HeapRelease( m_Runs, m_ThreadId );
+        m_Runs = next;
+      }
+      m_FreeSlots = nullptr;
+      m_LiveCount = 0;
+    }
+
+    uint64_t LiveCount() const
+    {
+      return m_LiveCount;
+    }
+
+  private:
+    bool AddRun()
+    {
+      Run* run = (Run*)AllocFor( k_RunHeader + sizeof( Slot ) * m_RunSlots, alignof( Slot ), m_ThreadId );
+      if( run == nullptr )
+      {
+        return false; // maybe assert(?)
+      }
+      run->m_Next = m_Runs;
+      m_Runs      = run;
+
+      // lowest address on top of the list
+      Slot* slots = (Slot*)( (unsigned char*)run + k_RunHeader );
+      for( uint32_t islot = m_RunSlots; islot > 0; islot-- )
+      {
+        slots[islot - 1].m_Next = m_FreeSlots;
+        m_FreeSlots             = &slots[islot - 1];
+      }
+      return true;
+    }
+
+    // Slots that aren't on the free list hold objects : tag the free ones, then sweep the runs. Allocation
+    // free, so it can't fail inside a destructor
+    void DestroyLive()
+    {
+      for( Slot* slot = m_FreeSlots; slot; )
+      {
+        Slot* next   = slot->m_Next;
+        slot->m_Next = FreeTag();
+        slot         = next;
+      }
+      m_FreeSlots = nullptr;
+
+      for( Run* run = m_Runs; run; run = run->m_Next )
+      {
+        Slot* slots = (Slot*)( (unsigned char*)run + k_RunHeader );
+        for( uint32_t irun_slot = 0; irun_slot < m_RunSlots; irun_slot++ )
+        {
+          if( slots[irun_slot].m_Next != FreeTag() )
+          {
+            ( (T*)slots[irun_slot].m_Data )->~T();
+          }
+        }
+      }
+    }
+
+    // No object can hold the address of the pool's own static
+    static Slot* FreeTag()
+    {
+      static Slot s_FreeTag;
+      return &s_FreeTag;
+    }
+
+    Slot*    m_FreeSlots = nullptr;
+    Run*     m_Runs      = nullptr;
+    uint64_t m_LiveCount = 0;
+    uint32_t m_RunSlots  = 0;
+    uint32_t m_ThreadId  = 0;
+  };
+};
@@ -0,0 +1,482 @@
+// Allocator workloads timed against the heaps && the system malloc. Every scenario/backend pair prints one
+// JSON line, followed by a heap vs system comparison line per scenario :
+//   mem_alloc_bench [--threads N] [--ops N] [--scenario name] [--flags k_HeapInit...]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+#include "MemoryAllocator.h"
+
+#define BENCH_SAMPLE_EVERY 8  // ops between latency samples
+#define BENCH_RSS_PERIOD_MS 2 // rss sampling period
+
+struct Backend
+{
+  const char* m_Name;
+  void*       ( *m_Alloc )( size_t size, uint32_t thread_id );
+  void        ( *m_Free )( void* ptr, uint32_t thread_id );
+  void*       ( *m_Realloc )( void* ptr, size_t size, uint32_t thread_id );
+};
+
+static void* HeapBackendAlloc( size_t size, uint32_t thread_id ) { return HeapAllocate( size, k_HeapHintNone, 0, 0, thread_id ); }
+static void  HeapBackendFree( void* ptr, uint32_t thread_id ) { HeapRelease( ptr, thread_id ); }
+static void* HeapBackendRealloc( void* ptr, size_t size, uint32_t thread_id ) { return HeapReallocate( ptr, size, thread_id ); }
+
+static void* SystemAlloc( size_t size, uint32_t ) { return malloc( size ); }
+static void  SystemFree( void* ptr, uint32_t ) { free( ptr ); }
+static void* SystemRealloc( void* ptr, size_t size, uint32_t ) { return realloc( ptr, size ); }
+
+static const Backend s_Backends[] =
+{
+  { "heap",   HeapBackendAlloc, HeapBackendFree, HeapBackendRealloc },
+  { "system", SystemAlloc,      SystemFree,      SystemRealloc      },
+};
+
+// Per worker state, one cache line each so the rss sampler can read live bytes w/o contention
+struct alignas( 64 ) Worker
+{
+  const Backend*        m_Backend;
+  uint32_t              m_ThreadId;
+  uint64_t              m_Ops;
+  std::atomic<int64_t>  m_LiveBytes;
+  std::vector<uint32_t> m_Samples; // ns
+
+  void Add( int64_t bytes )
+  {
+    m_LiveBytes.store( m_LiveBytes.load( std::memory_order_relaxed ) + bytes, std::memory_order_relaxed );
+  }
+};
+
+struct Settings
+{
+  uint32_t    m_Threads   = 4;
+  uint64_t    m_Ops       = 200000; // per thread
+  uint32_t    m_InitFlags = k_HeapInitNone;
+  const char* m_Scenario  = nullptr;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t ElapsedNs( Clock::time_point start )
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count();
+}
+
+// Times every BENCH_SAMPLE_EVERY op, the rest run untimed
+template< typename Op >
+static void TimedOp( Worker& worker, uint64_t iop, Op op )
+{
+  if( iop % BENCH_SAMPLE_EVERY )
+  {
+    op();
+    return;
+  }
+
+  const Clock::time_point start = Clock::now();
+  op();
+  worker.m_Samples.push_back( (uint32_t)std::min<uint64_t>( ElapsedNs( start ), UINT32_MAX ) );
+}
+
+static uint64_t ResidentBytes()
+{
+#ifdef __linux__
+  FILE* statm = fopen( "/proc/self/statm", "r" );
+  if( statm == nullptr )
+  {
+    return 0;
+  }
+
+  unsigned long long total_pages = 0, resident_pages = 0;
+  const int read_count = fscanf( statm, "%llu %llu", &total_pages, &resident_pages );
+  fclose( statm );
+  return read_count == 2 ? resident_pages * (uint64_t)sysconf( _SC_PAGESIZE ) : 0;
+#else
+  return 0;
+#endif // __linux__
+}
+
+static uint32_t SizeLogUniform( std::mt19937& rng, uint32_t min_log2, uint32_t max_log2 )
+{
+  const uint32_t range_log2 = min_log2 + rng() % ( max_log2 - min_log2 );
+  return ( 1u << range_log2 ) + rng() % ( 1u << range_log2 );
+}
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+// Same size block freed && allocated again through a ring
+static void FixedChurn( Worker& worker, uint32_t iworker, std::vector<Worker>& )
+{
+  const uint32_t     block_size = 64;
+  std::vector<void*> ring( 4096, nullptr );
+  for( uint64_t iop = 0; iop < worker.m_Ops; iop += 2 )
+  {
+    void*& slot = ring[( iop / 2 ) % ring.size()];
+    if( slot )
+    {
+      TimedOp( worker, iop, [&]() { worker.m_Backend->m_Free( slot, worker.m_ThreadId ); } );
+      worker.Add( -(int64_t)block_size );
+    }
+    TimedOp( worker, iop + 1, [&]() { slot = worker.m_Backend->m_Alloc( block_size, worker.m_ThreadId ); } );
+    memset( slot, (int)iworker, 8 );
+    worker.Add( block_size );
+  }
+  for( void* ptr : ring )
+  {
+    worker.m_Backend->m_Free( ptr, worker.m_ThreadId );
+  }
+}
+
+// Log-uniform sizes from 16 B to 16 kB, random replacement in a window of live blocks
+static void RandomSizes( Worker& worker, uint32_t iworker, std::vector<Worker>& )
+{
+  std::mt19937                             rng( iworker + 1 );
+  std::vector<std::pair<void*, uint32_t> > window( 8192, std::make_pair( nullptr, 0u ) );
+  for( uint64_t iop = 0; iop < worker.m_Ops; iop += 2 )
+  {
+    std::pair<void*, uint32_t>& slot = window[rng() % window.size()];
+    if( slot.first )
+    {
+      TimedOp( worker, iop, [&]() { worker.m_Backend->m_Free( slot.first, worker.m_ThreadId ); } );
+      worker.Add( -(int64_t)slot.second );
+    }
+    slot.second = SizeLogUniform( rng, 4, 14 );
+    TimedOp( worker, iop + 1, [&]() { slot.first = worker.m_Backend->m_Alloc( slot.second, worker.m_ThreadId ); } );
+    memset( slot.first, (int)iworker, 8 );
+    worker.Add( slot.second );
+  }
+  for( const std::pair<void*, uint32_t>& slot : window )
+  {
+    worker.m_Backend->m_Free( slot.first, worker.m_ThreadId );
+  }
+}
+
+// Larson : every round a thread takes over the blocks of its neighbour, so most frees are remote
+static std::vector<std::vector<std::pair<void*, uint32_t> > > s_LarsonSlots;
+static std::atomic<uint32_t>                                   s_LarsonArrived;
+
+static void Larson( Worker& worker, uint32_t iworker, std::vector<Worker>& workers )
+{
+  const uint32_t worker_count = (uint32_t)workers.size();
+  const uint32_t round_count  = 8;
+  const uint64_t round_ops    = worker.m_Ops / round_count;
+
+  std::mt19937 rng( iworker + 1 );
+  uint64_t     iop = 0;
+  for( uint32_t iround = 0; iround < round_count; iround++ )
+  {
+    std::vector<std::pair<void*, uint32_t> >& slots = s_LarsonSlots[( iworker + iround ) % worker_count];
+    for( uint64_t iround_op = 0; iround_op < round_ops; iround_op += 2, iop += 2 )
+    {
+      std::pair<void*, uint32_t>& slot = slots[rng() % slots.size()];
+      if( slot.first )
+      {
+        TimedOp( worker, iop, [&]() { worker.m_Backend->m_Free( slot.first, worker.m_ThreadId ); } );
+        worker.Add( -(int64_t)slot.second );
+      }
+      slot.second = 16 + rng() % 1000;
+      TimedOp( worker, iop + 1, [&]() { slot.first = worker.m_Backend->m_Alloc( slot.second, worker.m_ThreadId ); } );
+      memset( slot.first, (int)iworker, 8 );
+      worker.Add( slot.second );
+    }
+
+    // everyone finishes the round before the arrays rotate
+    s_LarsonArrived.fetch_add( 1 );
+    while( s_LarsonArrived.load() < worker_count * ( iround + 1 ) )
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// Even workers produce, odd ones free what their producer made ( a lone worker does both )
+struct alignas( 64 ) Channel
+{
+  static const uint32_t k_Capacity = 1024;
+
+  std::pair<void*, uint32_t> m_Items[k_Capacity];
+  std::atomic<uint64_t>      m_Head;
+  std::atomic<uint64_t>      m_Tail;
+};
+static std::vector<Channel> s_Channels;
+
+static void ProducerConsumer( Worker& worker, uint32_t iworker, std::vector<Worker>& workers )
+{
+  const bool lone = workers.size() == 1 || ( iworker % 2 == 0 && iworker + 1 == workers.size() );
+  Channel&   channel = s_Channels[iworker / 2];
+
+  std::mt19937 rng( iworker + 1 );
+  for( uint64_t iop = 0; iop < worker.m_Ops; iop++ )
+  {
+    if( lone || iworker % 2 == 0 )
+    {
+      while( channel.m_Tail.load( std::memory_order_acquire ) - channel.m_Head.load( std::memory_order_acquire ) == Channel::k_Capacity )
+      {
+        std::this_thread::yield();
+      }
+
+      std::pair<void*, uint32_t>& item = channel.m_Items[channel.m_Tail.load( std::memory_order_relaxed ) % Channel::k_Capacity];
+      item.second = 16 + rng() % 512;
+      TimedOp( worker, iop, [&]() { item.first = worker.m_Backend->m_Alloc( item.second, worker.m_ThreadId ); } );
+      memset( item.first, (int)iworker, 8 );
+      worker.Add( item.second );
+      channel.m_Tail.store( channel.m_Tail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+
+    if( lone || iworker % 2 == 1 )
+    {
+      while( channel.m_Tail.load( std::memory_order_acquire ) == channel.m_Head.load( std::memory_order_acquire ) )
+      {
+        std::this_thread::yield();
+      }
+
+      std::pair<void*, uint32_t>& item = channel.m_Items[channel.m_Head.load( std::memory_order_relaxed ) % Channel::k_Capacity];
+      TimedOp( worker, iop, [&]() { worker.m_Backend->m_Free( item.first, worker.m_ThreadId ); } );
+      worker.Add( -(int64_t)item.second );
+      channel.m_Head.store( channel.m_Head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+  }
+}
+
+// Buffers grown by 1.5x from 16 B to 1 mB, a few alive at once
+static void ReallocGrowth( Worker& worker, uint32_t iworker, std::vector<Worker>& )
+{
+  void*    buffers[4] = {};
+  uint32_t sizes[4]   = {};
+  for( uint64_t iop = 0; iop < worker.m_Ops; iop++ )
+  {
+    const uint32_t ibuffer  = (uint32_t)( iop % 4 );
+    const uint32_t new_size = sizes[ibuffer] < 16 ? 16 : sizes[ibuffer] + sizes[ibuffer] / 2;
+    if( new_size > ( 0x1 << 20 ) )
+    {
+      worker.m_Backend->m_Free( buffers[ibuffer], worker.m_ThreadId );
+      worker.Add( -(int64_t)sizes[ibuffer] );
+      buffers[ibuffer] = nullptr;
+      sizes[ibuffer]   = 0;
+      continue;
+    }
+
+    TimedOp( worker, iop, [&]() { buffers[ibuffer] = worker.m_Backend->m_Realloc( buffers[ibuffer], new_size, worker.m_ThreadId ); } );
+    ( (unsigned char*)buffers[ibuffer] )[new_size - 1] = (unsigned char)iworker;
+    worker.Add( (int64_t)new_size - sizes[ibuffer] );
+    sizes[ibuffer] = new_size;
+  }
+  for( void* buffer : buffers )
+  {
+    worker.m_Backend->m_Free( buffer, worker.m_ThreadId );
+  }
+}
+
+struct Scenario
+{
+  const char* m_Name;
+  void        ( *m_Run )( Worker& worker, uint32_t iworker, std::vector<Worker>& workers );
+};
+
+static const Scenario s_Scenarios[] =
+{
+  { "fixed_churn",       FixedChurn       },
+  { "random_sizes",      RandomSizes      },
+  { "larson",            Larson           },
+  { "producer_consumer", ProducerConsumer },
+  { "realloc_growth",    ReallocGrowth    },
+};
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+struct Result
+{
+  double   m_OpsPerSec;
+  uint64_t m_Percentiles[5]; // p50, p90, p99, p99.9, max
+  uint64_t m_PeakRss;        // over the rss before the run
+  uint64_t m_LiveAtPeak;     // requested bytes alive when the rss peaked
+};
+
+static Result RunScenario( const Scenario& scenario, const Backend& backend, const Settings& settings )
+{
+  const bool heap_backend = &backend == &s_Backends[0];
+
+  // workers use heap ids 1..threads, re-initialized so earlier runs don't leave blocks behind
+  std::vector<Worker> workers( settings.m_Threads );
+  for( uint32_t iworker = 0; iworker < settings.m_Threads; iworker++ )
+  {
+    workers[iworker].m_Backend  = &backend;
+    workers[iworker].m_ThreadId = iworker + 1;
+    workers[iworker].m_Ops      = settings.m_Ops;
+    workers[iworker].m_LiveBytes.store( 0 );
+    workers[iworker].m_Samples.reserve( settings.m_Ops / BENCH_SAMPLE_EVERY + 16 );
+    if( heap_backend )
+    {
+      HeapInitBaseEx( 0, settings.m_InitFlags, iworker + 1 );
+    }
+  }
+
+  s_LarsonSlots.assign( settings.m_Threads, std::vector<std::pair<void*, uint32_t> >( 4096, std::make_pair( nullptr, 0u ) ) );
+  s_LarsonArrived.store( 0 );
+  s_Channels = std::vector<Channel>( ( settings.m_Threads + 1 ) / 2 );
+  for( Channel& channel : s_Channels )
+  {
+    channel.m_Head.store( 0 );
+    channel.m_Tail.store( 0 );
+  }
+
+  // rss && live bytes sampled together while the workers run
+  const uint64_t    base_rss = ResidentBytes();
+  std::atomic<bool> running( true );
+  uint64_t          peak_rss = 0, live_at_peak = 0;
+  std::thread       sampler( [&]()
+  {
+    while( running.load() )
+    {
+      int64_t live_bytes = 0;
+      for( const Worker& worker : workers )
+      {
+        live_bytes += worker.m_LiveBytes.load( std::memory_order_relaxed );
+      }
+
+      const uint64_t rss = ResidentBytes();
+      if( rss > peak_rss )
+      {
+        peak_rss     = rss;
+        live_at_peak = live_bytes > 0 ? (uint64_t)live_bytes : 0;
+      }
+      std::this_thread::sleep_for( std::chrono::milliseconds( BENCH_RSS_PERIOD_MS ) );
+    }
+  } );
+
+  const Clock::time_point  start = Clock::now();
+  std::vector<std::thread> threads;
+  for( uint32_t iworker = 0; iworker < settings.m_Threads; iworker++ )
+  {
+    threads.emplace_back( [&, iworker]() { scenario.m_Run( workers[iworker], iworker, workers ); } );
+  }
+  for( std::thread& thread : threads )
+  {
+    thread.join();
+  }
+  const uint64_t elapsed_ns = ElapsedNs( start );
+
+  running.store( false );
+  sampler.join();
+
+  // blocks left over by larson are released outside the timing
+  for( uint32_t iworker = 0; iworker < settings.m_Threads; iworker++ )
+  {
+    for( const std::pair<void*, uint32_t>& slot : s_LarsonSlots[iworker] )
+    {
+      backend.m_Free( slot.first, iworker + 1 );
+    }
+  }
+
+  // hand the memory back so the next run starts from a comparable rss
+  if( heap_backend )
+  {
+    for( uint32_t iworker = 0; iworker < settings.m_Threads; iworker++ )
+    {
+      HeapFlushCache( iworker + 1 );
+      HeapPurge( iworker + 1 );
+    }
+  }
+#if defined( __linux__ ) && defined( __GLIBC__ )
+  malloc_trim( 0 );
+#endif
+
+  std::vector<uint32_t> samples;
+  uint64_t              total_ops = 0;
+  for( const Worker& worker : workers )
+  {
+    samples.insert( samples.end(), worker.m_Samples.begin(), worker.m_Samples.end() );
+    total_ops += worker.m_Ops;
+  }
+  std::sort( samples.begin(), samples.end() );
+
+  Result         result  = {};
+  const double   ranks[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+  for( uint32_t irank = 0; irank < 5 && !samples.empty(); irank++ )
+  {
+    result.m_Percentiles[irank] = samples[std::min( samples.size() - 1, (size_t)( ranks[irank] * samples.size() ) )];
+  }
+  result.m_OpsPerSec  = elapsed_ns ? (double)total_ops * 1e9 / (double)elapsed_ns : 0.0;
+  result.m_PeakRss    = peak_rss > base_rss ? peak_rss - base_rss : 0;
+  result.m_LiveAtPeak = live_at_peak;
+  return result;
+}
+
+static void PrintResult( const Scenario& scenario, const Backend& backend, const Settings& settings, const Result& result )
+{
+  printf( "{\"scenario\":\"%s\",\"backend\":\"%s\",\"threads\":%u,\"ops_per_thread\":%llu,\"ops_per_sec\":%.0f,"
+          "\"ns_p50\":%llu,\"ns_p90\":%llu,\"ns_p99\":%llu,\"ns_p999\":%llu,\"ns_max\":%llu,"
+          "\"peak_rss_bytes\":%llu,\"live_bytes_at_peak\":%llu,\"rss_per_live_byte\":%.3f}\n",
+          scenario.m_Name, backend.m_Name, settings.m_Threads, (unsigned long long)settings.m_Ops, result.m_OpsPerSec,
+          (unsigned long long)result.m_Percentiles[0], (unsigned long long)result.m_Percentiles[1], (unsigned long long)result.m_Percentiles[2],
+          (unsigned long long)result.m_Percentiles[3], (unsigned long long)result.m_Percentiles[4],
+          (unsigned long long)result.m_PeakRss, (unsigned long long)result.m_LiveAtPeak,
+          result.m_LiveAtPeak ? (double)result.m_PeakRss / (double)result.m_LiveAtPeak : 0.0 );
+}
+
+int main( const int argc, const char* argv[] )
+{
+  Settings settings;
+  for( int iarg = 1; iarg + 1 < argc; iarg += 2 )
+  {
+    if( strcmp( argv[iarg], "--threads" ) == 0 )
+    {
+      settings.m_Threads = (uint32_t)atoi( argv[iarg + 1] );
+    }
+    else if( strcmp( argv[iarg], "--ops" ) == 0 )
+    {
+      settings.m_Ops = (uint64_t)atoll( argv[iarg + 1] );
+    }
+    else if( strcmp( argv[iarg], "--flags" ) == 0 )
+    {
+      settings.m_InitFlags = (uint32_t)strtoul( argv[iarg + 1], nullptr, 0 );
+    }
+    else if( strcmp( argv[iarg], "--scenario" ) == 0 )
+    {
+      settings.m_Scenario = argv[iarg + 1];
+    }
+    else
+    {
+      fprintf( stderr, "usage : %s [--threads N] [--ops N] [--scenario name] [--flags k_HeapInit...]\n", argv[0] );
+      return 1;
+    }
+  }
+  settings.m_Threads = settings.m_Threads ? settings.m_Threads : 1;
+
+  for( const Scenario& scenario : s_Scenarios )
+  {
+    if( settings.m_Scenario && strcmp( settings.m_Scenario, scenario.m_Name ) )
+    {
+      continue;
+    }
+
+    Result results[2];
+    for( uint32_t ibackend = 0; ibackend < 2; ibackend++ )
+    {
+      results[ibackend] = RunScenario( scenario, s_Backends[ibackend], settings );
+      PrintResult( scenario, s_Backends[ibackend], settings, results[ibackend] );
+    }
+
+    printf( "{\"scenario\":\"%s\",\"compare\":\"heap/system\",\"throughput_ratio\":%.3f,\"p99_ratio\":%.3f,\"peak_rss_ratio\":%.3f}\n",
+            scenario.m_Name,
+            results[1].m_OpsPerSec ? results[0].m_OpsPerSec / results[1].m_OpsPerSec : 0.0,
+            results[1].m_Percentiles[2] ? (double)results[0].m_Percentiles[2] / (double)results[1].m_Percentiles[2] : 0.0,
+            results[1].m_PeakRss ? (double)results[0].m_PeakRss / (double)results[1].m_PeakRss : 0.0 );
+    fflush( stdout );
+  }
+
+  return 0;
+}
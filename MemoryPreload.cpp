@@ -0,0 +1,472 @@
+// Interposes malloc, free && the operator new / delete family so unmodified binaries run on the
+// partitioned heaps :
+//   make preload && LD_PRELOAD=./libmemalloc_preload.so <binary>
+// Every thread gets its own heap ( k_HeapThreadAuto ), released || handed to the next thread once it
+// exits. Requests made while the heap itself is running ( asserts ) || that the heaps can't serve
+// ( out of memory included ) go to glibc && are remembered, so free() can hand them back. The heap's
+// own bookkeeping is mapped, so none of it lands in that range
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include "MemoryAllocator.h"
+
+#ifndef HEAP_PRELOAD_SIZE
+  #define HEAP_PRELOAD_SIZE ( 0x1 << 26 ) // base partitions of each thread's heap, segments grow past it
+#endif
+
+#ifndef HEAP_PRELOAD_INIT_FLAGS
+  #define HEAP_PRELOAD_INIT_FLAGS k_HeapInitSlab
+#endif
+
+#ifndef HEAP_PRELOAD_FOREIGN_SLOTS
+  #define HEAP_PRELOAD_FOREIGN_SLOTS 1024 // glibc blocks alive at once
+#endif
+
+#define HEAP_PRELOAD_MIN_ALIGN 16 // alignof( max_align_t ), every block of the heaps below honours it
+#define HEAP_PRELOAD_EXPORT    __attribute__(( visibility( "default" ) ))
+
+extern "C"
+{
+  void* __libc_malloc( size_t size );
+  void* __libc_memalign( size_t alignment, size_t size );
+  void  __libc_free( void* ptr );
+}
+
+struct ForeignBlock
+{
+  void*  m_Ptr;
+  size_t m_Size;
+};
+
+static ForeignBlock s_ForeignBlocks[HEAP_PRELOAD_FOREIGN_SLOTS];
+static uint32_t     s_ForeignCount = 0;
+static uint32_t     s_ForeignLock  = 0;
+static uintptr_t    s_ForeignLow   = UINTPTR_MAX; // range only ever grows, it keeps lookups off the lock
+static uintptr_t    s_ForeignHigh  = 0;
+static bool         s_Configured   = false;
+
+static thread_local uint32_t s_HeapDepth = 0;
+
+// Marks the heap as running on this thread, allocations it makes go to glibc
+struct HeapScope
+{
+  HeapScope() { s_HeapDepth++; }
+  ~HeapScope() { s_HeapDepth--; }
+};
+
+static void ForeignLock()
+{
+  while( __atomic_exchange_n( &s_ForeignLock, 1, __ATOMIC_ACQUIRE ) )
+  {
+    __builtin_ia32_pause();
+  }
+}
+
+static void ForeignUnlock()
+{
+  __atomic_store_n( &s_ForeignLock, 0, __ATOMIC_RELEASE );
+}
+
+static void* ForeignAllocate( size_t size, size_t alignment )
+{
+  void* ptr = alignment > HEAP_PRELOAD_MIN_ALIGN ? __libc_memalign( alignment, size ) : __libc_malloc( size );
+  if( ptr == NULL )
+  {
+    return NULL;
+  }
+
+  ForeignLock();
+  const bool tracked = s_ForeignCount < HEAP_PRELOAD_FOREIGN_SLOTS;
+  if( tracked )
+  {
+    s_ForeignBlocks[s_ForeignCount].m_Ptr  = ptr;
+    s_ForeignBlocks[s_ForeignCount].m_Size = size;
+    s_ForeignCount++;
+
+    __atomic_store_n( &s_ForeignLow, (uintptr_t)ptr < s_ForeignLow ? (uintptr_t)ptr : s_ForeignLow, __ATOMIC_RELAXED );
+    __atomic_store_n( &s_ForeignHigh, (uintptr_t)ptr >= s_ForeignHigh ? (uintptr_t)ptr + 1 : s_ForeignHigh, __ATOMIC_RELAXED );
+  }
+  ForeignUnlock();
+
+  // an untracked block would be handed to a heap on free()
+  if( !tracked )
+  {
+    __libc_free( ptr );
+    return NULL;
+  }
+  return ptr;
+}
+
+// Size of a block glibc handed out ( false if ptr came from a heap ), release drops it from the table
+static bool ForeignFind( void* ptr, size_t* size, bool release )
+{
+  if( (uintptr_t)ptr < __atomic_load_n( &s_ForeignLow, __ATOMIC_RELAXED ) || (uintptr_t)ptr >= __atomic_load_n( &s_ForeignHigh, __ATOMIC_RELAXED ) )
+  {
+    return false;
+  }
+
+  bool found = false;
+  ForeignLock();
+  for( uint32_t iblock = 0; iblock < s_ForeignCount; iblock++ )
+  {
+    if( s_ForeignBlocks[iblock].m_Ptr == ptr )
+    {
+      *size = s_ForeignBlocks[iblock].m_Size;
+      if( release )
+      {
+        s_ForeignBlocks[iblock] = s_ForeignBlocks[--s_ForeignCount];
+      }
+      found = true;
+      break;
+    }
+  }
+  ForeignUnlock();
+
+  if( found && release )
+  {
+    __libc_free( ptr );
+  }
+  return found;
+}
+
+static size_t GetPageSize()
+{
+  static size_t s_PageSize = 0;
+  if( s_PageSize == 0 )
+  {
+    s_PageSize = (size_t)sysconf( _SC_PAGESIZE );
+  }
+  return s_PageSize;
+}
+
+// HEAP_CLASS_... layout w/o the classes that aren't multiples of 16 B, so every block is 16 B aligned
+static HeapConfig AlignedConfig()
+{
+  static_assert( sizeof( HeapBlockHeader ) % HEAP_PRELOAD_MIN_ALIGN == 0, "Block headers would misalign the data ( TAG_MEMORY )" );
+
+  const uint32_t steps = 0x1 << k_HeapClassStepBits;
+
+  HeapConfig config = {};
+  for( uint32_t ilvl = 0; ilvl < k_HeapNumLvl; ilvl++ )
+  {
+    const uint32_t range      = ilvl == 0 ? 0 : 1 + ( ilvl - 1 ) / steps;
+    const uint32_t level_size = ilvl == 0 ? 32 : ( 0x1u << ( 4 + range ) ) + ( ( ( ilvl - 1 ) % steps + 1 ) << ( 4 + range - k_HeapClassStepBits ) );
+    if( level_size % HEAP_PRELOAD_MIN_ALIGN == 0 )
+    {
+      config.m_LevelSizes[config.m_LevelCount]    = level_size;
+      config.m_LevelShares[config.m_LevelCount++] = ilvl == 0 ? 5 * steps : ( 5 * ( range + 1 ) < 25 ? 5 * ( range + 1 ) : 25 );
+    }
+  }
+  return config;
+}
+
+static void* Allocate( size_t size, size_t alignment )
+{
+  size = size ? size : 1;
+
+  if( s_HeapDepth || alignment > GetPageSize() )
+  {
+    return ForeignAllocate( size, alignment );
+  }
+  if( size > SIZE_MAX / 2 )
+  {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  if( !s_Configured )
+  {
+    const HeapConfig config = AlignedConfig();
+    HeapSetAutoInit( HEAP_PRELOAD_SIZE, HEAP_PRELOAD_INIT_FLAGS );
+    HeapSetAutoConfig( &config );
+    s_Configured = true;
+  }
+
+  HeapScope scope;
+  void*     ptr = alignment > HEAP_PRELOAD_MIN_ALIGN ? HeapAllocateAligned( size, (uint32_t)alignment, 0, k_HeapThreadAuto ) : HeapAllocate( size, k_HeapHintNone, 0, 0, k_HeapThreadAuto );
+  if( ptr == NULL )
+  {
+    ptr = ForeignAllocate( size, alignment );
+  }
+  if( ptr == NULL )
+  {
+    errno = ENOMEM;
+  }
+  return ptr;
+}
+
+// size is the requested size when the caller knows it ( sized delete ), 0 otherwise
+static void Release( void* ptr, size_t size )
+{
+  size_t foreign_size;
+  if( ptr == NULL || ForeignFind( ptr, &foreign_size, true ) )
+  {
+    return;
+  }
+
+  HeapScope scope;
+  if( size )
+  {
+    HeapReleaseSized( ptr, size, k_HeapThreadAuto );
+  }
+  else
+  {
+    HeapRelease( ptr, k_HeapThreadAuto );
+  }
+}
+
+static void* Reallocate( void* ptr, size_t size )
+{
+  if( ptr == NULL )
+  {
+    return Allocate( size, 0 );
+  }
+  if( size == 0 )
+  {
+    Release( ptr, 0 );
+    return NULL;
+  }
+
+  // glibc blocks move onto the heap
+  size_t foreign_size;
+  if( ForeignFind( ptr, &foreign_size, false ) )
+  {
+    void* new_ptr = Allocate( size, 0 );
+    if( new_ptr )
+    {
+      memcpy( new_ptr, ptr, foreign_size < size ? foreign_size : size );
+      Release( ptr, 0 );
+    }
+    return new_ptr;
+  }
+  if( size > SIZE_MAX / 2 )
+  {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  HeapScope scope;
+  void*     new_ptr = HeapReallocate( ptr, size, k_HeapThreadAuto );
+  if( new_ptr == NULL )
+  {
+    new_ptr = ForeignAllocate( size, 0 );
+    if( new_ptr == NULL )
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+    const size_t usable_size = (size_t)HeapUsableSize( ptr );
+    memcpy( new_ptr, ptr, usable_size < size ? usable_size : size );
+    HeapRelease( ptr, k_HeapThreadAuto );
+  }
+  return new_ptr;
+}
+
+static void* AllocateNew( size_t size, size_t alignment )
+{
+  void* ptr;
+  while( ( ptr = Allocate( size, alignment ) ) == NULL )
+  {
+    std::new_handler handler = std::get_new_handler();
+    if( handler == NULL )
+    {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+  return ptr;
+}
+
+//----------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------
+
+extern "C"
+{
+  HEAP_PRELOAD_EXPORT void* malloc( size_t size ) noexcept
+  {
+    return Allocate( size, 0 );
+  }
+
+  HEAP_PRELOAD_EXPORT void free( void* ptr ) noexcept
+  {
+    Release( ptr, 0 );
+  }
+
+  HEAP_PRELOAD_EXPORT void* calloc( size_t count, size_t size ) noexcept
+  {
+    if( size && count > SIZE_MAX / size )
+    {
+      errno = ENOMEM;
+      return NULL;
+    }
+
+    void* ptr = Allocate( count * size, 0 );
+    if( ptr )
+    {
+      memset( ptr, 0, count * size );
+    }
+    return ptr;
+  }
+
+  HEAP_PRELOAD_EXPORT void* realloc( void* ptr, size_t size ) noexcept
+  {
+    return Reallocate( ptr, size );
+  }
+
+  HEAP_PRELOAD_EXPORT int posix_memalign( void** out_ptr, size_t alignment, size_t size ) noexcept
+  {
+    if( alignment < sizeof( void* ) || ( alignment & ( alignment - 1 ) ) )
+    {
+      return EINVAL;
+    }
+
+    void* ptr = Allocate( size, alignment );
+    if( ptr == NULL )
+    {
+      return ENOMEM;
+    }
+    *out_ptr = ptr;
+    return 0;
+  }
+
+  HEAP_PRELOAD_EXPORT void* aligned_alloc( size_t alignment, size_t size ) noexcept
+  {
+    if( alignment == 0 || ( alignment & ( alignment - 1 ) ) )
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+    return Allocate( size, alignment );
+  }
+
+  HEAP_PRELOAD_EXPORT void* memalign( size_t alignment, size_t size ) noexcept
+  {
+    return aligned_alloc( alignment, size );
+  }
+
+  HEAP_PRELOAD_EXPORT void* valloc( size_t size ) noexcept
+  {
+    return Allocate( size, GetPageSize() );
+  }
+
+  HEAP_PRELOAD_EXPORT void* pvalloc( size_t size ) noexcept
+  {
+    return Allocate( ( size + GetPageSize() - 1 ) & ~( GetPageSize() - 1 ), GetPageSize() );
+  }
+
+  HEAP_PRELOAD_EXPORT size_t malloc_usable_size( void* ptr ) noexcept
+  {
+    size_t foreign_size;
+    if( ptr == NULL || ForeignFind( ptr, &foreign_size, false ) )
+    {
+      return ptr ? foreign_size : 0;
+    }
+    return (size_t)HeapUsableSize( ptr );
+  }
+}
+
+HEAP_PRELOAD_EXPORT void* operator new( size_t size )
+{
+  return AllocateNew( size, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new[]( size_t size )
+{
+  return AllocateNew( size, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new( size_t size, const std::nothrow_t& ) noexcept
+{
+  return Allocate( size, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new[]( size_t size, const std::nothrow_t& ) noexcept
+{
+  return Allocate( size, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr, const std::nothrow_t& ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr, const std::nothrow_t& ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr, size_t size ) noexcept
+{
+  Release( ptr, size );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr, size_t size ) noexcept
+{
+  Release( ptr, size );
+}
+
+#ifdef __cpp_aligned_new
+HEAP_PRELOAD_EXPORT void* operator new( size_t size, std::align_val_t alignment )
+{
+  return AllocateNew( size, (size_t)alignment );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new[]( size_t size, std::align_val_t alignment )
+{
+  return AllocateNew( size, (size_t)alignment );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new( size_t size, std::align_val_t alignment, const std::nothrow_t& ) noexcept
+{
+  return Allocate( size, (size_t)alignment );
+}
+
+HEAP_PRELOAD_EXPORT void* operator new[]( size_t size, std::align_val_t alignment, const std::nothrow_t& ) noexcept
+{
+  return Allocate( size, (size_t)alignment );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr, std::align_val_t ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr, std::align_val_t ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept
+{
+  Release( ptr, 0 );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete( void* ptr, size_t size, std::align_val_t ) noexcept
+{
+  Release( ptr, size );
+}
+
+HEAP_PRELOAD_EXPORT void operator delete[]( void* ptr, size_t size, std::align_val_t ) noexcept
+{
+  Release( ptr, size );
+}
+#endif // __cpp_aligned_new
@@ -0,0 +1,435 @@
+// Re-runs a trace recorded w/ HeapTraceStart ( HEAP_TRACE builds ) against a heap configuration of choice.
+// Records replay in file order on a single thread, every recorded heap gets a heap of its own. Prints one
+// JSON line w/ the latency of each kind of request, one w/ the HeapGetStats counters of every heap, then
+// the status of every heap :
+//   mem_alloc_replay trace [--size mB] [--flags k_HeapInit...] [--sizes 32,48,...] [--shares 5,5,...] [--large bytes] [--no-status]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryAllocator.h"
+
+#define REPLAY_READ_COUNT 4096 // records read at once
+
+struct Settings
+{
+  const char* m_TracePath      = nullptr;
+  uint64_t    m_HeapSize       = 0;
+  uint32_t    m_InitFlags      = k_HeapInitNone;
+  int64_t     m_LargeThreshold = -1; // heap default
+  bool        m_PrintStatus    = true;
+  HeapConfig  m_Config         = {}; // no levels keeps the HEAP_CLASS_... layout
+};
+
+// Block of the replay standing in for a recorded address
+struct LiveBlock
+{
+  void*    m_Ptr;
+  uint64_t m_Size;
+};
+
+struct Replay
+{
+  std::unordered_map<uint64_t, LiveBlock> m_Live;       // recorded address -> replayed block
+  std::map<uint32_t, uint32_t>            m_Heaps;      // recorded heap -> replay heap
+  std::vector<uint32_t>                   m_Samples[3]; // ns of allocations, releases && reallocations
+
+  uint64_t m_Records        = 0;
+  uint64_t m_TraceNs        = 0;
+  uint64_t m_LiveBytes      = 0;
+  uint64_t m_PeakLiveBytes  = 0;
+  uint64_t m_Failed         = 0; // requests the replay heaps couldn't serve
+  uint64_t m_RecordedFailed = 0; // requests that already failed while recording, skipped
+  uint64_t m_Untracked      = 0; // releases of blocks allocated before the trace started
+};
+
+enum
+{
+  k_SampleAlloc = 0,
+  k_SampleRelease,
+  k_SampleRealloc,
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static bool ParseList( const char* list, uint32_t values[], uint32_t* value_count )
+{
+  *value_count = 0;
+  while( *list )
+  {
+    if( *value_count == k_HeapNumLvl )
+    {
+      return false;
+    }
+
+    char* end                  = nullptr;
+    values[( *value_count )++] = (uint32_t)strtoul( list, &end, 0 );
+    if( end == list || ( *end != ',' && *end != '\0' ) )
+    {
+      return false;
+    }
+    list = *end ? end + 1 : end;
+  }
+  return *value_count != 0;
+}
+
+static uint32_t ReplayHeap( Replay& replay, const Settings& settings, uint32_t thread_id )
+{
+  std::map<uint32_t, uint32_t>::iterator heap_it = replay.m_Heaps.find( thread_id );
+  if( heap_it != replay.m_Heaps.end() )
+  {
+    return heap_it->second;
+  }
+
+  // replay heaps start at 1, the main thread's heap is left alone
+  const uint32_t heap_id = (uint32_t)replay.m_Heaps.size() + 1;
+  HeapInitBaseConfig( settings.m_HeapSize, settings.m_InitFlags, settings.m_Config.m_LevelCount ? &settings.m_Config : nullptr, heap_id );
+  if( settings.m_LargeThreshold >= 0 )
+  {
+    HeapSetLargeThreshold( (uint64_t)settings.m_LargeThreshold, heap_id );
+  }
+
+  replay.m_Heaps[thread_id] = heap_id;
+  return heap_id;
+}
+
+template< typename Op >
+static void TimedOp( Replay& replay, uint32_t sample_idx, Op op )
+{
+  const Clock::time_point start = Clock::now();
+  op();
+  const uint64_t elapsed_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count();
+  replay.m_Samples[sample_idx].push_back( (uint32_t)std::min<uint64_t>( elapsed_ns, UINT32_MAX ) );
+}
+
+static void AddLive( Replay& replay, uint64_t recorded_ptr, void* data_ptr, uint64_t byte_size )
+{
+  if( data_ptr == nullptr )
+  {
+    replay.m_Failed++;
+    return;
+  }
+
+  const LiveBlock block = { data_ptr, byte_size };
+  replay.m_Live[recorded_ptr] = block;
+  replay.m_LiveBytes         += byte_size;
+  replay.m_PeakLiveBytes      = std::max( replay.m_PeakLiveBytes, replay.m_LiveBytes );
+}
+
+// Takes the block of a recorded address out of the live set, false if the trace never saw it allocated
+static bool TakeLive( Replay& replay, uint64_t recorded_ptr, LiveBlock* block )
+{
+  std::unordered_map<uint64_t, LiveBlock>::iterator live_it = replay.m_Live.find( recorded_ptr );
+  if( live_it == replay.m_Live.end() )
+  {
+    return false;
+  }
+
+  *block              = live_it->second;
+  replay.m_LiveBytes -= block->m_Size;
+  replay.m_Live.erase( live_it );
+  return true;
+}
+
+static void ReplayRecord( Replay& replay, const Settings& settings, const HeapTraceRecord& record )
+{
+  const uint32_t heap_id  = ReplayHeap( replay, settings, record.m_ThreadId );
+  void*          data_ptr = nullptr;
+  LiveBlock      block    = {};
+
+  switch( record.m_Op )
+  {
+    // level indexes belong to the recorded config, the replay picks the level from the size
+    case k_HeapTraceAlloc:
+    case k_HeapTraceAllocLevel:
+    case k_HeapTraceAllocAligned:
+      if( record.m_Ptr == 0 )
+      {
+        replay.m_RecordedFailed++;
+        break;
+      }
+
+      TimedOp( replay, k_SampleAlloc, [&]()
+      {
+        if( record.m_Op == k_HeapTraceAllocAligned )
+        {
+          data_ptr = HeapAllocateAligned( record.m_Size, record.m_Hints, record.m_Extra, heap_id );
+        }
+        else
+        {
+          data_ptr = HeapAllocate( record.m_Size, record.m_Op == k_HeapTraceAlloc ? record.m_Hints : k_HeapHintNone, record.m_BlockSize, record.m_Extra, heap_id );
+        }
+      } );
+      AddLive( replay, record.m_Ptr, data_ptr, record.m_Size );
+      break;
+
+    case k_HeapTraceRelease:
+      if( !TakeLive( replay, record.m_Ptr, &block ) )
+      {
+        replay.m_Untracked++;
+        break;
+      }
+
+      TimedOp( replay, k_SampleRelease, [&]()
+      {
+        if( record.m_Size )
+        {
+          HeapReleaseSized( block.m_Ptr, record.m_Size, heap_id );
+        }
+        else
+        {
+          HeapRelease( block.m_Ptr, heap_id );
+        }
+      } );
+      break;
+
+    case k_HeapTraceRealloc:
+      if( record.m_Ptr == 0 && record.m_Size )
+      {
+        replay.m_RecordedFailed++; // old block stayed valid
+        break;
+      }
+
+      // a block from before the trace started gets a fresh one
+      if( record.m_Extra && !TakeLive( replay, record.m_Extra, &block ) )
+      {
+        replay.m_Untracked++;
+        if( record.m_Size == 0 )
+        {
+          break;
+        }
+      }
+
+      TimedOp( replay, k_SampleRealloc, [&]() { data_ptr = HeapReallocate( block.m_Ptr, record.m_Size, heap_id ); } );
+      if( record.m_Size )
+      {
+        AddLive( replay, record.m_Ptr, data_ptr, record.m_Size );
+      }
+      break;
+
+    default:
+      fprintf( stderr, "Unknown trace op %u in record %llu\n", record.m_Op, (unsigned long long)replay.m_Records );
+      break;
+  }
+
+  replay.m_Records++;
+  replay.m_TraceNs = record.m_TimeNs;
+}
+
+static void PrintPercentiles( const char* name, std::vector<uint32_t>& samples )
+{
+  std::sort( samples.begin(), samples.end() );
+
+  uint64_t     percentiles[5] = {};
+  const double ranks[]        = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+  for( uint32_t irank = 0; irank < 5 && !samples.empty(); irank++ )
+  {
+    percentiles[irank] = samples[std::min( samples.size() - 1, (size_t)( ranks[irank] * samples.size() ) )];
+  }
+
+  printf( ",\"%s\":{\"count\":%llu,\"ns_p50\":%llu,\"ns_p90\":%llu,\"ns_p99\":%llu,\"ns_p999\":%llu,\"ns_max\":%llu}",
+          name, (unsigned long long)samples.size(),
+          (unsigned long long)percentiles[0], (unsigned long long)percentiles[1], (unsigned long long)percentiles[2],
+          (unsigned long long)percentiles[3], (unsigned long long)percentiles[4] );
+}
+
+// Fragmentation is the share of free bytes outside the largest free extent. Slab slots are single bins
+// w/o extents, those levels report the share of their slots in use instead
+static void PrintStats( uint32_t level_idx, const HeapPartitionStats& stats, bool slab )
+{
+  const uint64_t total_bytes = stats.m_LiveBytes + stats.m_FreeBytes;
+
+  printf( "{\"level\":%u,\"bin_size\":%u,\"allocs\":%llu,\"frees\":%llu,\"failed_no_space\":%llu,\"failed_fragmentation\":%llu,"
+          "\"live_bytes\":%llu,\"peak_bytes\":%llu,\"free_bytes\":%llu,\"largest_free\":%llu,\"free_extents\":%llu,\"segments\":%u,",
+          level_idx, stats.m_BinSize, (unsigned long long)stats.m_Allocs, (unsigned long long)stats.m_Frees,
+          (unsigned long long)stats.m_FailedNoFreeSpace, (unsigned long long)stats.m_FailedFragmentation,
+          (unsigned long long)stats.m_LiveBytes, (unsigned long long)stats.m_PeakBytes, (unsigned long long)stats.m_FreeBytes,
+          (unsigned long long)stats.m_LargestFreeExtent, (unsigned long long)stats.m_FreeExtentCount, stats.m_SegmentCount );
+  if( slab )
+  {
+    printf( "\"slot_occupancy\":%.6f}", total_bytes ? (double)stats.m_LiveBytes / (double)total_bytes : 0.0 );
+  }
+  else
+  {
+    printf( "\"fragmentation\":%.4f}", stats.m_FreeBytes ? 1.0 - (double)stats.m_LargestFreeExtent / (double)stats.m_FreeBytes : 0.0 );
+  }
+}
+
+// Slab levels are the leading ones of k_HeapSlabMaxSize || less, their bins carry no header
+static bool IsSlabLevel( const Settings& settings, uint32_t level_idx, const HeapPartitionStats& stats )
+{
+  return ( settings.m_InitFlags & k_HeapInitSlab ) && level_idx < k_HeapSlabLvls && stats.m_BinSize <= k_HeapSlabMaxSize;
+}
+
+// Sizes as HeapInitBaseConfig takes them : ascending multiples of 8 B from 32 B on, shares that don't all weigh 0
+static bool ValidConfig( const HeapConfig& config )
+{
+  uint32_t total_share = 0;
+  for( uint32_t ilvl = 0; ilvl < config.m_LevelCount; ilvl++ )
+  {
+    const uint32_t level_size = config.m_LevelSizes[ilvl];
+    if( level_size < 32 || level_size % 8 || ( ilvl && level_size <= config.m_LevelSizes[ilvl - 1] ) )
+    {
+      fprintf( stderr, "Invalid size for level %u : %u ( sizes ascend, are multiples of 8 && start at 32 || more )\n", ilvl, level_size );
+      return false;
+    }
+    total_share += config.m_LevelShares[ilvl];
+  }
+  if( config.m_LevelCount && total_share == 0 )
+  {
+    fprintf( stderr, "Every level has a zero share\n" );
+    return false;
+  }
+  return true;
+}
+
+static void Usage( const char* program )
+{
+  fprintf( stderr, "usage : %s trace [--size mB] [--flags k_HeapInit...] [--sizes 32,48,...] [--shares 5,5,...] [--large bytes] [--no-status]\n", program );
+}
+
+int main( const int argc, const char* argv[] )
+{
+  Settings settings;
+  uint32_t share_count = 0;
+  for( int iarg = 1; iarg < argc; iarg++ )
+  {
+    const bool has_value = iarg + 1 < argc;
+    if( strcmp( argv[iarg], "--no-status" ) == 0 )
+    {
+      settings.m_PrintStatus = false;
+    }
+    else if( strcmp( argv[iarg], "--size" ) == 0 && has_value )
+    {
+      settings.m_HeapSize = (uint64_t)atoll( argv[++iarg] ) << 20;
+    }
+    else if( strcmp( argv[iarg], "--flags" ) == 0 && has_value )
+    {
+      settings.m_InitFlags = (uint32_t)strtoul( argv[++iarg], nullptr, 0 );
+    }
+    else if( strcmp( argv[iarg], "--large" ) == 0 && has_value )
+    {
+      settings.m_LargeThreshold = atoll( argv[++iarg] );
+    }
+    else if( strcmp( argv[iarg], "--sizes" ) == 0 && has_value )
+    {
+      if( !ParseList( argv[++iarg], settings.m_Config.m_LevelSizes, &settings.m_Config.m_LevelCount ) )
+      {
+        Usage( argv[0] );
+        return 1;
+      }
+    }
+    else if( strcmp( argv[iarg], "--shares" ) == 0 && has_value )
+    {
+      if( !ParseList( argv[++iarg], settings.m_Config.m_LevelShares, &share_count ) )
+      {
+        Usage( argv[0] );
+        return 1;
+      }
+    }
+    else if( argv[iarg][0] != '-' && settings.m_TracePath == nullptr )
+    {
+      settings.m_TracePath = argv[iarg];
+    }
+    else
+    {
+      Usage( argv[0] );
+      return 1;
+    }
+  }
+
+  // every level weighs the same unless told otherwise
+  if( settings.m_TracePath == nullptr || ( share_count && share_count != settings.m_Config.m_LevelCount ) )
+  {
+    Usage( argv[0] );
+    return 1;
+  }
+  for( uint32_t ilvl = share_count; ilvl < settings.m_Config.m_LevelCount; ilvl++ )
+  {
+    settings.m_Config.m_LevelShares[ilvl] = 1;
+  }
+  if( !ValidConfig( settings.m_Config ) )
+  {
+    return 1;
+  }
+
+  FILE* trace_file = fopen( settings.m_TracePath, "rb" );
+  if( trace_file == nullptr )
+  {
+    fprintf( stderr, "Can't open %s\n", settings.m_TracePath );
+    return 1;
+  }
+
+  HeapTraceHeader header = {};
+  if( fread( &header, sizeof( header ), 1, trace_file ) != 1 || header.m_Magic != k_HeapTraceMagic || header.m_Version != k_HeapTraceVersion || header.m_RecordSize != sizeof( HeapTraceRecord ) )
+  {
+    fprintf( stderr, "%s isn't a version %u heap trace\n", settings.m_TracePath, (uint32_t)k_HeapTraceVersion );
+    fclose( trace_file );
+    return 1;
+  }
+
+  Replay                       replay;
+  std::vector<HeapTraceRecord> records( REPLAY_READ_COUNT );
+
+  const Clock::time_point start = Clock::now();
+  for( size_t read_count; ( read_count = fread( records.data(), sizeof( HeapTraceRecord ), records.size(), trace_file ) ) != 0; )
+  {
+    for( size_t irecord = 0; irecord < read_count; irecord++ )
+    {
+      ReplayRecord( replay, settings, records[irecord] );
+    }
+  }
+  const uint64_t replay_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count();
+  fclose( trace_file );
+
+  printf( "{\"trace\":\"%s\",\"records\":%llu,\"heaps\":%u,\"trace_ms\":%.3f,\"replay_ms\":%.3f,\"failed\":%llu,\"recorded_failed\":%llu,\"untracked\":%llu,"
+          "\"live_blocks\":%llu,\"live_bytes\":%llu,\"peak_live_bytes\":%llu",
+          settings.m_TracePath, (unsigned long long)replay.m_Records, (uint32_t)replay.m_Heaps.size(), (double)replay.m_TraceNs / 1e6, (double)replay_ns / 1e6,
+          (unsigned long long)replay.m_Failed, (unsigned long long)replay.m_RecordedFailed, (unsigned long long)replay.m_Untracked,
+          (unsigned long long)replay.m_Live.size(), (unsigned long long)replay.m_LiveBytes, (unsigned long long)replay.m_PeakLiveBytes );
+  PrintPercentiles( "alloc", replay.m_Samples[k_SampleAlloc] );
+  PrintPercentiles( "release", replay.m_Samples[k_SampleRelease] );
+  PrintPercentiles( "realloc", replay.m_Samples[k_SampleRealloc] );
+  printf( "}\n" );
+
+  // blocks still alive stay put, so the stats show the fragmentation the trace ended w/
+  for( const std::pair<const uint32_t, uint32_t>& heap : replay.m_Heaps )
+  {
+    HeapStats stats;
+    HeapGetStats( heap.second, &stats );
+
+    printf( "{\"heap\":%u,\"recorded_heap\":%u,\"levels\":[", heap.second, heap.first );
+    bool first_level = true;
+    for( uint32_t ilvl = 0; ilvl < stats.m_LevelCount; ilvl++ )
+    {
+      if( stats.m_Levels[ilvl].m_Allocs == 0 && stats.m_Levels[ilvl].m_FailedNoFreeSpace == 0 )
+      {
+        continue; // untouched
+      }
+
+      printf( "%s", first_level ? "" : "," );
+      PrintStats( ilvl, stats.m_Levels[ilvl], IsSlabLevel( settings, ilvl, stats.m_Levels[ilvl] ) );
+      first_level = false;
+    }
+    printf( "],\"large\":" );
+    PrintStats( 0, stats.m_Large, false );
+    printf( "}\n" );
+  }
+
+  if( settings.m_PrintStatus )
+  {
+    for( const std::pair<const uint32_t, uint32_t>& heap : replay.m_Heaps )
+    {
+      printf( "o Heap %u ( recorded heap %u ) :\n", heap.second, heap.first );
+      HeapPrintStatus( heap.second );
+    }
+  }
+
+  return 0;
+}
@@ -1,2 +1,2 @@
-cl /O2 /W4 /std:c++14 /EHsc /Fe: memalloc_test_win32 *.c *.cpp Dbghelp.lib
+cl /O2 /W4 /std:c++14 /EHsc /Fe: memalloc_test_win32 main.cpp MemoryAllocator.c DebugLib.c Dbghelp.lib
 del /s *.obj
\ No newline at end of file
@@ -1,5 +1,12 @@
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <random>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <time.h>
 
 #include "DebugLib.h"
@@ -33,6 +40,30 @@ static int32_t Test4();
 static int32_t Test5();
 static int32_t Test6();
 static int32_t Test7();
+static int32_t Test8();
+static int32_t Test9();
+static int32_t Test10();
+static int32_t Test11();
+static int32_t Test12();
+static int32_t Test13();
+static int32_t Test14();
+static int32_t Test15();
+static int32_t Test16();
+static int32_t Test17();
+static int32_t Test18();
+static int32_t Test19();
+static int32_t Test20();
+static int32_t Test21();
+static int32_t Test22();
+static int32_t Test23();
+static int32_t Test24();
+static int32_t Test25();
+static int32_t Test26();
+static int32_t Test27();
+static int32_t Test28();
+static int32_t Test29();
+static int32_t Test30();
+static int32_t Test31();
 
 int main( const int argc, const char* argv[] )
 {
@@ -43,36 +74,132 @@ int main( const int argc, const char* argv[] )
 
   if( argc == 2 )
   {
-    switch ( *argv[1] )
+    switch ( atoi( argv[1] ) )
     {
-      case '1':
+      case 1:
       {
         return Test1();
       }
-      case '2':
+      case 2:
       {
         return Test2();
       }
-      case '3':
+      case 3:
       {
         return Test3();
       }
-      case '4':
+      case 4:
       {
         return Test4();
       }
-      case '5':
+      case 5:
       {
         return Test5();
       }
-      case '6':
+      case 6:
       {
         return Test6();
       }
-      case '7':
+      case 7:
       {
         return Test7();
       }
+      case 8:
+      {
+        return Test8();
+      }
+      case 9:
+      {
+        return Test9();
+      }
+      case 10:
+      {
+        return Test10();
+      }
+      case 11:
+      {
+        return Test11();
+      }
+      case 12:
+      {
+        return Test12();
+      }
+      case 13:
+      {
+        return Test13();
+      }
+      case 14:
+      {
+        return Test14();
+      }
+      case 15:
+      {
+        return Test15();
+      }
+      case 16:
+      {
+        return Test16();
+      }
+      case 17:
+      {
+        return Test17();
+      }
+      case 18:
+      {
+        return Test18();
+      }
+      case 19:
+      {
+        return Test19();
+      }
+      case 20:
+      {
+        return Test20();
+      }
+      case 21:
+      {
+        return Test21();
+      }
+      case 22:
+      {
+        return Test22();
+      }
+      case 23:
+      {
+        return Test23();
+      }
+      case 24:
+      {
+        return Test24();
+      }
+      case 25:
+      {
+        return Test25();
+      }
+      case 26:
+      {
+        return Test26();
+      }
+      case 27:
+      {
+        return Test27();
+      }
+      case 28:
+      {
+        return Test28();
+      }
+      case 29:
+      {
+        return Test29();
+      }
+      case 30:
+      {
+        return Test30();
+      }
+      case 31:
+      {
+        return Test31();
+      }
     }
   }
 
@@ -90,6 +217,54 @@ int main( const int argc, const char* argv[] )
 
   Test7();
 
+  Test8();
+
+  Test9();
+
+  Test10();
+
+  Test11();
+
+  Test12();
+
+  Test13();
+
+  Test14();
+
+  Test15();
+
+  Test16();
+
+  Test17();
+
+  Test18();
+
+  Test19();
+
+  Test20();
+
+  Test21();
+
+  Test22();
+
+  Test23();
+
+  Test24();
+
+  Test25();
+
+  Test26();
+
+  Test27();
+
+  Test28();
+
+  Test29();
+
+  Test30();
+
+  Test31();
+
   return 0;
 }
 
@@ -186,7 +361,7 @@ static int32_t Test2()
   printf( "\n *** Testing CalcAllocPartitionAndSize func *** \n\n" );
 
   srand( (unsigned int)time( nullptr ) );
-  uint32_t byte_request = ( ( rand() % 512 ) * rand() ) % 512;
+  uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 512;
   printf( "Requesting %u bytes \n", byte_request );
 
   PrintAllocCalcResult( byte_request, Heap::k_HintNone );
@@ -200,7 +375,7 @@ static int32_t Test2()
 static int32_t Test3()
 {
   srand( (unsigned int)time( nullptr ) );
-  uint32_t byte_request = ( ( rand() % 512 ) * rand() ) % 512;
+  uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 512;
 
   printf( "\n *** Testing Allocation func ( 4 simple allocations & frees ) *** \n\n" );
 
@@ -231,7 +406,7 @@ static int32_t Test3()
 static int32_t Test4()
 {
   srand( (unsigned int)time( nullptr ) );
-  uint32_t byte_request = ( ( rand() % 512 ) * rand() ) % 512;
+  uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 512;
 
   const uint32_t alloc_count = 1000000;
   printf( "\n *** Testing Allocation func ( %u allocations and random-ordered frees ) *** \n\n", alloc_count );
@@ -246,7 +421,7 @@ static int32_t Test4()
   
   for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
   {
-    byte_request = ( ( rand() % 512 ) * rand() ) % 4096; // randomize sizes
+    byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 4096; // randomize sizes
 
     test_ptrs[irequest]      = Heap::Alloc( byte_request, GenerateHint( byte_request ) ); // randomize hints
     free_idx_flags[irequest] = true;
@@ -271,7 +446,7 @@ static int32_t Test4()
     }
     else if( free_idx % 100 == 0 ) // 1 out of 100 chance of alloc
     {
-      byte_request = ( ( rand() % 512 ) * rand() ) % 4096;
+      byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 4096;
 
       test_ptrs[free_idx]      = Heap::Alloc( byte_request, GenerateHint( byte_request ) );
       free_idx_flags[free_idx] = test_ptrs[free_idx] ? true : false;
@@ -305,7 +480,7 @@ static int32_t Test5()
 static int32_t Test6()
 {
   srand( (unsigned int)time( nullptr ) );
-  uint32_t byte_request = ( ( rand() % 512 ) * rand() ) % 512;
+  uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 512;
 
   const uint32_t alloc_count = 100000 * 100;
   printf( "\n *** Testing Allocation func ( %u allocations and random-ordered frees ) *** \n\n", alloc_count );
@@ -314,7 +489,7 @@ static int32_t Test6()
   void** test_ptrs      = allocator.AllocT<void*>( alloc_count );
   bool*  free_idx_flags = allocator.AllocT<bool>( alloc_count );
 
-  ASSERT_F( *test_ptrs && *free_idx_flags, "Failed to allocate testing containers" );
+  ASSERT_F( test_ptrs && free_idx_flags, "Failed to allocate testing containers" );
 
   printf( "-----------------------State before randomized free & alloc---------------------\n" );
   Heap::PrintStatus();
@@ -322,7 +497,7 @@ static int32_t Test6()
 
   for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
   {
-    byte_request = ( ( rand() % 512 ) * rand() ) % 8192;
+    byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 8192;
 
     // randomize hints
     test_ptrs[irequest]      = Heap::Alloc( byte_request, GenerateHint( byte_request ) );
@@ -360,6 +535,9 @@ static int32_t Test6()
   return 0;
 }
 
+static uint32_t s_Destroyed;
+static uint32_t s_Constructed;
+
 static int32_t Test7()
 {
   srand( (unsigned int)time( nullptr ) );
@@ -389,12 +567,1549 @@ static int32_t Test7()
     Heap::PrintStatus();
     printf( "---------------------------------scope in---------------------------------------\n" );
 
+    // no depth limit, a nested scope destroys its objects && hands its space back on exit
+    struct Tracked
+    {
+      Tracked( uint32_t value = 0 ) : m_Value( value ) {}
+      ~Tracked() { s_Destroyed++; }
+      uint32_t m_Value;
+    };
+
+    s_Destroyed = 0;
+    void* scope_start;
+    {
+      Heap::ScopedAllocator::Scope scope( allocator );
+      scope_start = allocator.AllocT<uint64_t>();
+      for( uint32_t iobj = 0; iobj < 1000; iobj++ )
+      {
+        Tracked* tracked = allocator.New<Tracked>( iobj );
+        ASSERT_F( tracked && tracked->m_Value == iobj, "Scoped object %u not constructed", iobj );
+      }
+      ASSERT_F( allocator.NewArray<Tracked>( 16 ), "Scoped array not constructed" );
+    }
+    ASSERT_F( s_Destroyed == 1000 + 16, "Scope destroyed %u of %u objects", s_Destroyed, 1000 + 16 );
+    ASSERT_F( allocator.AllocT<uint64_t>() == scope_start, "Scope didn't rewind the allocator" );
+
+    // only constructed objects are destroyed, an array that throws part way destroys what it built
+    struct Throwing
+    {
+      Throwing() : Throwing( s_Constructed == 5 ) {}
+      Throwing( bool fail )
+      {
+        if( fail )
+        {
+          throw fail;
+        }
+        s_Constructed++;
+      }
+      ~Throwing() { s_Destroyed++; }
+    };
+
+    s_Destroyed   = 0;
+    s_Constructed = 0;
+    {
+      Heap::ScopedAllocator::Scope scope( allocator );
+      allocator.New<Throwing>( false );
+
+      bool thrown = false;
+      try
+      {
+        allocator.New<Throwing>( true );
+      }
+      catch( bool )
+      {
+        thrown = true;
+      }
+      try
+      {
+        allocator.NewArray<Throwing>( 8 );
+      }
+      catch( bool )
+      {
+        thrown = thrown && s_Destroyed == 4;
+      }
+      ASSERT_F( thrown, "Throwing constructors not reported ( %u destroyed )", s_Destroyed );
+    }
+    ASSERT_F( s_Destroyed == s_Constructed, "Scope destroyed %u of %u constructed objects", s_Destroyed, s_Constructed );
+
+    s_Destroyed = 1000 + 16;
+    allocator.New<Tracked>();
+
     printf( "Exiting scope\n\n" );
   }
 
+  ASSERT_F( s_Destroyed == 1000 + 16 + 1, "Scoped allocator leaked an object" );
+
   printf( "--------------------------------------------------------------------------------\n" );
   Heap::PrintStatus();
   printf( "--------------------------------------------------------------------------------\n" );
 
   return 0;
 }
+
+static int32_t Test8()
+{
+  srand( (unsigned int)time( nullptr ) );
+
+  const uint32_t thread_id   = 1;
+  const uint32_t alloc_count = 100000;
+  printf( "\n *** Testing tree tracker ( %u allocations and random-ordered frees ) *** \n\n", alloc_count );
+
+  Heap::InitBaseEx( 0, Heap::k_InitTreeTracker, thread_id );
+
+  Heap::ScopedAllocator allocator;
+  void** test_ptrs      = allocator.AllocT<void*>( alloc_count );
+  bool*  free_idx_flags = allocator.AllocT<bool>( alloc_count );
+
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 4096;
+
+    test_ptrs[irequest]      = Heap::Alloc( byte_request, GenerateHint( byte_request ), 4, 0, thread_id );
+    free_idx_flags[irequest] = test_ptrs[irequest] ? true : false;
+  }
+
+  for( uint32_t irequest = 0; irequest < alloc_count * 5; ++irequest )
+  {
+    uint32_t free_idx = rand() % alloc_count;
+
+    if( free_idx_flags[free_idx] )
+    {
+      free_idx_flags[free_idx] = false;
+      Heap::Free( test_ptrs[free_idx], thread_id );
+    }
+  }
+
+  printf( "-----------------------------State after randomized free------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  for( uint32_t iptr = 0; iptr < alloc_count; ++iptr )
+  {
+    if( free_idx_flags[iptr] )
+    {
+      Heap::Free( test_ptrs[iptr], thread_id );
+    }
+  }
+
+  printf( "----------------------------------State after dump------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test9()
+{
+  const uint32_t thread_count = 16;
+  const uint32_t alloc_count  = 10000;
+  printf( "\n *** Testing auto-bound thread heaps ( %u threads ) *** \n\n", thread_count );
+
+  std::vector<uint32_t>    thread_ids( thread_count );
+  std::vector<std::thread> threads;
+  std::atomic<uint32_t>    bound_count( 0 );
+
+  for( uint32_t ithread = 0; ithread < thread_count; ithread++ )
+  {
+    threads.emplace_back( [ithread, alloc_count, &thread_ids, &bound_count]()
+    {
+      std::mt19937 rng( ithread );
+      std::vector<void*> ptrs( alloc_count );
+
+      for( uint32_t irequest = 0; irequest < alloc_count; irequest++ )
+      {
+        ptrs[irequest] = Heap::Alloc( ( rng() % 2048 ) + 1, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto );
+        ASSERT_F( ptrs[irequest], "Auto-bound heap allocation failed" );
+      }
+      for( uint32_t irequest = 0; irequest < alloc_count; irequest++ )
+      {
+        Heap::Free( ptrs[irequest], Heap::k_ThreadAuto );
+      }
+
+      thread_ids[ithread] = Heap::GetThreadId();
+      ASSERT_F( Heap::QueryBaseValidity( Heap::k_ThreadAuto ), "Auto-bound heap not initialized" );
+
+      // heaps of exited threads are handed out again, stay alive until every thread is bound
+      bound_count++;
+      while( bound_count != thread_count )
+      {
+        std::this_thread::yield();
+      }
+    } );
+  }
+
+  for( std::thread& thread : threads )
+  {
+    thread.join();
+  }
+
+  for( uint32_t ithread = 0; ithread < thread_count; ithread++ )
+  {
+    printf( "- Thread %2u bound to heap %u\n", ithread, thread_ids[ithread] );
+    for( uint32_t iother = 0; iother < ithread; iother++ )
+    {
+      ASSERT_F( thread_ids[ithread] != thread_ids[iother], "Threads share heap %u", thread_ids[ithread] );
+    }
+  }
+
+  return 0;
+}
+
+static int32_t Test10()
+{
+  const uint32_t alloc_count = 50000;
+  printf( "\n *** Testing cross-thread release ( %u blocks ) *** \n\n", alloc_count );
+
+  std::vector<void*>    ptrs( alloc_count );
+  std::atomic<uint32_t> stage( 0 );
+  uint32_t              producer_id = 0;
+
+  std::thread producer( [&]()
+  {
+    std::mt19937 rng( 10 );
+
+    producer_id = Heap::GetThreadId();
+    for( uint32_t irequest = 0; irequest < alloc_count; irequest++ )
+    {
+      ptrs[irequest] = Heap::Alloc( ( rng() % 4096 ) + 1, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto );
+    }
+    stage = 1;
+
+    while( stage != 2 )
+    {
+      std::this_thread::yield();
+    }
+
+    // next allocation releases everything the consumer queued
+    Heap::Free( Heap::Alloc( 64, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto ), Heap::k_ThreadAuto );
+    Heap::FlushCache( Heap::k_ThreadAuto );
+
+    // the heap is released once the thread exits
+    printf( "--------------------------Producer heap after draining--------------------------\n" );
+    Heap::PrintStatus( producer_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+  } );
+
+  std::thread consumer( [&]()
+  {
+    while( stage != 1 )
+    {
+      std::this_thread::yield();
+    }
+
+    for( uint32_t irequest = 0; irequest < alloc_count; irequest++ )
+    {
+      const bool released = Heap::Free( ptrs[irequest], Heap::k_ThreadAuto );
+      ASSERT_F( released, "Cross-thread release failed" );
+      (void)released;
+    }
+    stage = 2;
+  } );
+
+  producer.join();
+  consumer.join();
+
+  return 0;
+}
+
+static int32_t Test11()
+{
+  const uint32_t thread_id = 2;
+  const uint64_t heap_size = ( 0x1 << 20 ) * 4;
+  printf( "\n *** Testing sized heap ( %" PRIu64 " B, lazily committed ) *** \n\n", heap_size );
+
+  Heap::InitBaseEx( heap_size, Heap::k_InitFixedSize, thread_id );
+
+  printf( "----------------------------------State after init------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  // fill level 0 : a 4 mB heap can't hand out more than its 5% share
+  std::vector<void*> ptrs;
+  while( void* ptr = Heap::Alloc( 32, Heap::k_HintStrictSize | Heap::k_Level0, 4, 0, thread_id ) )
+  {
+    ptrs.push_back( ptr );
+  }
+  ASSERT_F( !ptrs.empty() && ptrs.size() * Heap::k_Level0 <= heap_size / 20, "Level 0 ignored the heap size : %zu blocks", ptrs.size() );
+
+  printf( "- Level 0 filled w/ %zu blocks\n", ptrs.size() );
+
+  for( void* ptr : ptrs )
+  {
+    Heap::Free( ptr, thread_id );
+  }
+  Heap::FlushCache( thread_id );
+
+  printf( "----------------------------------State after dump------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test12()
+{
+  srand( (unsigned int)time( nullptr ) );
+
+  const uint32_t thread_id   = 3;
+  const uint32_t alloc_count = 100000;
+  printf( "\n *** Testing huge page backed partitions ( %u allocations ) *** \n\n", alloc_count );
+
+  Heap::InitBaseEx( 0, Heap::k_InitHugePages, thread_id );
+
+  std::vector<void*> ptrs( alloc_count );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    uint32_t byte_request = ( ( rand() % 512 ) * (uint32_t)rand() ) % 4096;
+
+    ptrs[irequest] = Heap::Alloc( byte_request, GenerateHint( byte_request ), 4, 0, thread_id );
+    if( ptrs[irequest] )
+    {
+      memset( ptrs[irequest], 0xab, byte_request );
+    }
+  }
+
+  printf( "-----------------------------State after allocations----------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  for( void* ptr : ptrs )
+  {
+    Heap::Free( ptr, thread_id );
+  }
+
+  return 0;
+}
+
+static int32_t Test13()
+{
+  srand( (unsigned int)time( nullptr ) );
+
+  const uint32_t thread_id   = 4;
+  const uint32_t alloc_count = 64;
+  printf( "\n *** Testing large allocations ( %u blocks ) *** \n\n", alloc_count );
+
+  Heap::InitBase( 0, thread_id );
+
+  std::vector<void*>    ptrs( alloc_count );
+  std::vector<uint32_t> sizes( alloc_count );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    sizes[irequest] = ( 0x1 << 16 ) + ( rand() % ( 0x1 << 22 ) );
+    ptrs[irequest]  = Heap::Alloc( sizes[irequest], Heap::k_HintNone, 4, 0, thread_id );
+
+    ASSERT_F( ptrs[irequest], "Large allocation failed : %u B", sizes[irequest] );
+    memset( ptrs[irequest], (int)irequest, sizes[irequest] );
+  }
+
+  printf( "-----------------------------State after allocations----------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  // release every other block from another thread, the rest locally
+  std::thread remote( [&]()
+  {
+    for( uint32_t irequest = 0; irequest < alloc_count; irequest += 2 )
+    {
+      ASSERT_F( ( (unsigned char*)ptrs[irequest] )[sizes[irequest] - 1] == (unsigned char)irequest, "Large block %u corrupted", irequest );
+      Heap::Free( ptrs[irequest], Heap::k_ThreadAuto );
+    }
+  } );
+  remote.join();
+
+  for( uint32_t irequest = 1; irequest < alloc_count; irequest += 2 )
+  {
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+
+  // same sizes again are served from the cached regions
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    ptrs[irequest] = Heap::Alloc( sizes[irequest], Heap::k_HintNone, 4, 0, thread_id );
+  }
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+
+  printf( "-----------------------------State after release--------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  Heap::FlushCache( thread_id );
+
+  return 0;
+}
+
+static int32_t Test14()
+{
+  const uint32_t thread_id   = 5;
+  const uint32_t alloc_count = 200000;
+  printf( "\n *** Testing growth segments ( %u allocations on a 1 mB heap ) *** \n\n", alloc_count );
+
+  Heap::InitBase( 0x1 << 20, thread_id );
+
+  // level 0 && level 5 both overflow their base partitions
+  std::vector<void*> ptrs( alloc_count );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    const uint32_t byte_request = irequest % 2 ? 24 : 1000;
+
+    ptrs[irequest] = Heap::Alloc( byte_request, Heap::k_HintNone, 4, 0, thread_id );
+    ASSERT_F( ptrs[irequest], "Growable heap failed allocation %u", irequest );
+    memset( ptrs[irequest], (int)irequest, byte_request );
+  }
+
+  printf( "-----------------------------State after allocations----------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    ASSERT_F( *(unsigned char*)ptrs[irequest] == (unsigned char)irequest, "Block %u corrupted", irequest );
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+  Heap::FlushCache( thread_id );
+
+  printf( "-------------------------State after release ( segments gone )------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test15()
+{
+  const uint32_t thread_id   = 6;
+  const uint32_t alloc_count = 20000;
+  const uint32_t alloc_size  = 2000;
+  printf( "\n *** Testing purging free extents ( %u allocations ) *** \n\n", alloc_count );
+
+  Heap::InitBase( 0, thread_id );
+  Heap::SetPurgeDecay( 0, thread_id );
+
+  std::vector<void*> ptrs( alloc_count );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    ptrs[irequest] = Heap::Alloc( alloc_size, Heap::k_HintNone, 4, 0, thread_id );
+    memset( ptrs[irequest], 0xab, alloc_size );
+  }
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+  Heap::FlushCache( thread_id );
+
+  // the coalesced extent is purged once, the 2nd pass has nothing left to do
+  const uint64_t purged_size = Heap::Purge( thread_id );
+  ASSERT_F( purged_size > 0, "Nothing purged after releasing %u blocks", alloc_count );
+  ASSERT_F( Heap::Purge( thread_id ) == 0, "Purged extents were purged again" );
+
+  // a block carved from the purged extent merges back into it, the larger part keeps it purged
+  void* block = Heap::Alloc( alloc_size, Heap::k_HintNone, 4, 0, thread_id );
+  Heap::Free( block, thread_id );
+  Heap::FlushCache( thread_id );
+  ASSERT_F( Heap::Purge( thread_id ) == 0, "Merge w/ a freed block dropped the purged state" );
+
+  printf( "purged %" PRIu64 " B\n", purged_size );
+  printf( "-----------------------------State after purge----------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  // purged pages fault back in on reuse, then decay purges them while releasing
+  Heap::SetPurgeDecay( 1, thread_id );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    ptrs[irequest] = Heap::Alloc( alloc_size, Heap::k_HintNone, 4, 0, thread_id );
+    memset( ptrs[irequest], (int)irequest, alloc_size );
+  }
+  std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    ASSERT_F( ( (unsigned char*)ptrs[irequest] )[alloc_size - 1] == (unsigned char)irequest, "Block %u corrupted", irequest );
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+  Heap::FlushCache( thread_id );
+
+  return 0;
+}
+
+static int32_t Test16()
+{
+  const uint32_t thread_id = 7;
+  printf( "\n *** Testing reallocation *** \n\n" );
+
+  const uint32_t init_flags[] = { Heap::k_InitNone, Heap::k_InitTreeTracker };
+  for( uint32_t init : init_flags )
+  {
+    Heap::InitBaseEx( 0, init, thread_id );
+
+    // multi bin block in a fresh partition : the bins after it are free, so it grows where it is
+    const uint32_t run_hint = Heap::k_HintStrictSize | Heap::k_Level5;
+    unsigned char* data     = (unsigned char*)Heap::Alloc( 3000, run_hint, 4, 0, thread_id );
+    memset( data, 0x5a, 3000 );
+    ASSERT_F( Heap::UsableSize( data ) >= 3000, "Usable size below request : %" PRIu64 " B", Heap::UsableSize( data ) );
+
+    unsigned char* grown = (unsigned char*)Heap::Realloc( data, 6000, thread_id );
+    ASSERT_F( grown == data, "Growth into free neighbour moved the block" );
+    ASSERT_F( Heap::UsableSize( grown ) >= 6000, "Usable size below request : %" PRIu64 " B", Heap::UsableSize( grown ) );
+    memset( grown + 3000, 0x5a, 3000 );
+
+    // a neighbour in the way forces a move, contents come along
+    void*          blocker = Heap::Alloc( 3000, run_hint, 4, 0, thread_id );
+    unsigned char* moved   = (unsigned char*)Heap::Realloc( grown, 12000, thread_id );
+    ASSERT_F( moved && moved != grown, "Blocked growth didn't move" );
+    for( uint32_t ibyte = 0; ibyte < 6000; ibyte++ )
+    {
+      ASSERT_F( moved[ibyte] == 0x5a, "Moved block lost byte %u", ibyte );
+    }
+
+    // shrinking hands the tail back && stays put
+    unsigned char* shrunk = (unsigned char*)Heap::Realloc( moved, 100, thread_id );
+    ASSERT_F( shrunk == moved && shrunk[99] == 0x5a, "Shrink moved the block" );
+
+    // large blocks shrink in place, grow by moving
+    unsigned char* large = (unsigned char*)Heap::Realloc( nullptr, 0x1 << 18, thread_id );
+    memset( large, 0x3c, 0x1 << 18 );
+    ASSERT_F( Heap::Realloc( large, 0x1 << 17, thread_id ) == large, "Large shrink moved the block" );
+    large = (unsigned char*)Heap::Realloc( large, 0x1 << 20, thread_id );
+    ASSERT_F( large[( 0x1 << 17 ) - 1] == 0x3c, "Large growth lost contents" );
+
+    ASSERT_F( Heap::Realloc( large, 0, thread_id ) == nullptr, "Zero size realloc returned a block" );
+    Heap::Free( shrunk, thread_id );
+    Heap::Free( blocker, thread_id );
+    Heap::FlushCache( thread_id );
+
+    printf( "-----------------------------State after reallocation---------------------------\n" );
+    Heap::PrintStatus( thread_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+  }
+
+  return 0;
+}
+
+struct alignas( 64 ) CacheLine
+{
+  uint64_t m_Values[8];
+};
+
+static int32_t Test17()
+{
+  srand( (unsigned int)time( nullptr ) );
+
+  const uint32_t thread_id   = 7;
+  const uint32_t alloc_count = 4096;
+  printf( "\n *** Testing aligned allocations ( %u blocks ) *** \n\n", alloc_count );
+
+  Heap::InitBase( 0, thread_id );
+
+  std::vector<void*>    ptrs( alloc_count );
+  std::vector<uint32_t> sizes( alloc_count );
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    const uint32_t alignment = 0x1 << ( 3 + irequest % 10 ); // 8 B -> 4 kB
+
+    sizes[irequest] = irequest % 64 ? 1 + (uint32_t)rand() % 3000 : ( 0x1 << 16 ) + (uint32_t)rand() % ( 0x1 << 18 );
+    ptrs[irequest]  = Heap::AllocAligned( sizes[irequest], alignment, 0, thread_id );
+
+    ASSERT_F( ptrs[irequest] && (uintptr_t)ptrs[irequest] % alignment == 0, "Block %u not aligned to %u B : %p", irequest, alignment, ptrs[irequest] );
+    ASSERT_F( Heap::UsableSize( ptrs[irequest] ) >= sizes[irequest], "Usable size below request" );
+    memset( ptrs[irequest], (int)irequest, sizes[irequest] );
+  }
+
+  CacheLine* lines = Heap::AllocAligned<CacheLine>( 16, alignof( CacheLine ), thread_id );
+  ASSERT_F( (uintptr_t)lines % 64 == 0, "Cache lines not aligned : %p", (void*)lines );
+  Heap::Free( lines, thread_id );
+
+  // shifted blocks are released like any other, from the owner && from other threads
+  std::thread remote( [&]()
+  {
+    for( uint32_t irequest = 0; irequest < alloc_count; irequest += 2 )
+    {
+      ASSERT_F( ( (unsigned char*)ptrs[irequest] )[sizes[irequest] - 1] == (unsigned char)irequest, "Aligned block %u corrupted", irequest );
+      Heap::Free( ptrs[irequest], Heap::k_ThreadAuto );
+    }
+  } );
+  remote.join();
+
+  for( uint32_t irequest = 1; irequest < alloc_count; irequest += 2 )
+  {
+    ASSERT_F( ( (unsigned char*)ptrs[irequest] )[sizes[irequest] - 1] == (unsigned char)irequest, "Aligned block %u corrupted", irequest );
+    Heap::Free( ptrs[irequest], thread_id );
+  }
+  Heap::FlushCache( thread_id );
+
+  printf( "-----------------------------State after release--------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test18()
+{
+  const uint32_t thread_id   = 7;
+  const uint32_t batch_count = 2000;
+  printf( "\n *** Testing batch allocate/release ( %u blocks per batch ) *** \n\n", batch_count );
+
+  std::mt19937 rng( (uint32_t)time( nullptr ) );
+
+  const uint32_t init_flags[] = { Heap::k_InitNone, Heap::k_InitTreeTracker };
+  const uint32_t batch_sizes[] = { 24, 100, 700, 3000, 100000 };
+  for( uint32_t init : init_flags )
+  {
+    Heap::InitBaseEx( 0, init, thread_id );
+
+    for( uint32_t byte_size : batch_sizes )
+    {
+      const uint32_t block_count = byte_size < ( 0x1 << 16 ) ? batch_count : 16;
+
+      std::vector<void*> ptrs( block_count );
+      const uint32_t     alloc_count = Heap::AllocBatch( byte_size, block_count, ptrs.data(), thread_id );
+      ASSERT_F( alloc_count == block_count, "Batch of %u B blocks came up short : %u", byte_size, alloc_count );
+
+      for( uint32_t iblock = 0; iblock < block_count; iblock++ )
+      {
+        memset( ptrs[iblock], (int)iblock, byte_size );
+      }
+      for( uint32_t iblock = 0; iblock < block_count; iblock++ )
+      {
+        ASSERT_F( ( (unsigned char*)ptrs[iblock] )[byte_size - 1] == (unsigned char)iblock, "Batch block %u overlaps another", iblock );
+      }
+
+      // release a shuffled half from another thread, the rest in one batch
+      std::shuffle( ptrs.begin(), ptrs.end(), rng );
+      std::thread remote( [&]()
+      {
+        Heap::FreeBatch( ptrs.data(), block_count / 2, Heap::k_ThreadAuto );
+      } );
+      remote.join();
+
+      Heap::FreeBatch( ptrs.data() + block_count / 2, block_count - block_count / 2, thread_id );
+    }
+    Heap::FlushCache( thread_id );
+
+    printf( "-----------------------------State after batches--------------------------------\n" );
+    Heap::PrintStatus( thread_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+  }
+
+  return 0;
+}
+
+static int32_t Test19()
+{
+  srand( (unsigned int)time( nullptr ) );
+
+  const uint32_t thread_id   = 7;
+  const uint32_t alloc_count = 100000;
+  printf( "\n *** Testing slab levels ( %u small allocations on a 4 mB heap ) *** \n\n", alloc_count );
+
+  const uint32_t init_flags[] = { Heap::k_InitSlab, Heap::k_InitSlab | Heap::k_InitTreeTracker };
+  for( uint32_t init : init_flags )
+  {
+    // small heap : the slabs fill up && the levels carry on in headered segments
+    Heap::InitBaseEx( 0x1 << 22, init, thread_id );
+
+    std::vector<void*>    ptrs( alloc_count );
+    std::vector<uint32_t> sizes( alloc_count );
+    for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+    {
+      sizes[irequest] = 1 + (uint32_t)rand() % 64;
+      ptrs[irequest]  = irequest % 8 ? Heap::Alloc( sizes[irequest], Heap::k_HintNone, 4, 0, thread_id ) : Heap::AllocAligned( sizes[irequest], 32, 0, thread_id );
+
+      ASSERT_F( ptrs[irequest], "Small allocation %u failed", irequest );
+      ASSERT_F( Heap::UsableSize( ptrs[irequest] ) >= sizes[irequest], "Usable size below request" );
+      ASSERT_F( irequest % 8 || (uintptr_t)ptrs[irequest] % 32 == 0, "Aligned small block %u at %p", irequest, ptrs[irequest] );
+      memset( ptrs[irequest], (int)irequest, sizes[irequest] );
+    }
+
+    printf( "-----------------------------State after allocations----------------------------\n" );
+    Heap::PrintStatus( thread_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+
+    // slab slots move out when they outgrow their slot
+    ptrs[0] = Heap::Realloc( ptrs[0], 500, thread_id );
+    ASSERT_F( ( (unsigned char*)ptrs[0] )[sizes[0] - 1] == 0, "Realloc out of a slab slot lost contents" );
+    sizes[0] = 500;
+    memset( ptrs[0], 0, sizes[0] );
+
+    // a quarter released by another thread, the rest locally && in a batch
+    std::thread remote( [&]()
+    {
+      for( uint32_t irequest = 0; irequest < alloc_count; irequest += 4 )
+      {
+        ASSERT_F( ( (unsigned char*)ptrs[irequest] )[sizes[irequest] - 1] == (unsigned char)irequest, "Small block %u corrupted", irequest );
+        Heap::Free( ptrs[irequest], Heap::k_ThreadAuto );
+        ptrs[irequest] = nullptr;
+      }
+    } );
+    remote.join();
+
+    for( uint32_t irequest = 1; irequest < alloc_count; irequest += 2 )
+    {
+      ASSERT_F( ( (unsigned char*)ptrs[irequest] )[sizes[irequest] - 1] == (unsigned char)irequest, "Small block %u corrupted", irequest );
+      Heap::Free( ptrs[irequest], thread_id );
+      ptrs[irequest] = nullptr;
+    }
+    Heap::FreeBatch( ptrs.data(), alloc_count, thread_id );
+    Heap::FlushCache( thread_id );
+
+    printf( "-----------------------------State after release--------------------------------\n" );
+    Heap::PrintStatus( thread_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+  }
+
+  return 0;
+}
+
+// old six power of two levels && a finer table, resolved at compile time
+using PowerOfTwoConfig = Heap::Config<1, 10>;
+using QuarterConfig    = Heap::Config<4, 12>;
+
+static_assert( PowerOfTwoConfig::k_LevelCount == 6 && PowerOfTwoConfig::LevelSize( 5 ) == 1024, "Power of two table" );
+static_assert( PowerOfTwoConfig::SelectLevel( 100 ) == 2 && QuarterConfig::SelectLevel( 100 ) == 7, "Compile-time class lookup" );
+static_assert( QuarterConfig::LevelSize( 7 ) == 112 && QuarterConfig::LevelSize( QuarterConfig::k_LevelCount - 1 ) == 4096, "Quarter step table" );
+
+static int32_t Test20()
+{
+  const uint32_t alloc_count = 20000;
+  printf( "\n *** Testing compile-time heap configs ( %u allocations per heap ) *** \n\n", alloc_count );
+
+  // differently tuned heaps side by side
+  const uint32_t pow2_thread    = 6;
+  const uint32_t quarter_thread = 7;
+  const uint32_t custom_thread  = 5;
+  PowerOfTwoConfig::InitBase( 0x1 << 24, Heap::k_InitNone, pow2_thread );
+  QuarterConfig::InitBase( 0x1 << 24, Heap::k_InitSlab, quarter_thread );
+
+  // hand written table w/o a power of two slab class, aligned requests can't use its slots
+  HeapConfig custom = {};
+  custom.m_LevelCount = 5;
+  const uint32_t custom_sizes[] = { 40, 56, 120, 504, 2040 };
+  for( uint32_t ilvl = 0; ilvl < custom.m_LevelCount; ilvl++ )
+  {
+    custom.m_LevelSizes[ilvl]  = custom_sizes[ilvl];
+    custom.m_LevelShares[ilvl] = 1;
+  }
+  HeapInitBaseConfig( 0x1 << 22, Heap::k_InitSlab, &custom, custom_thread );
+
+  void* pow2_block    = PowerOfTwoConfig::Alloc<100>( 0, pow2_thread );
+  void* quarter_block = QuarterConfig::Alloc<100>( 0, quarter_thread );
+  ASSERT_F( Heap::UsableSize( pow2_block ) == 128, "Power of two heap gave %" PRIu64 " B", Heap::UsableSize( pow2_block ) );
+  ASSERT_F( Heap::UsableSize( quarter_block ) == 112, "Quarter heap gave %" PRIu64 " B", Heap::UsableSize( quarter_block ) );
+
+  std::vector<void*> ptrs;
+  for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+  {
+    const uint32_t size = 1 + (uint32_t)rand() % 3000;
+    for( uint32_t thread_id : { pow2_thread, quarter_thread, custom_thread } )
+    {
+      void* ptr = irequest % 4 ? Heap::Alloc( size, Heap::k_HintNone, 4, 0, thread_id ) : Heap::AllocAligned( size, 16 << ( irequest % 3 ), 0, thread_id );
+
+      ASSERT_F( ptr && Heap::UsableSize( ptr ) >= size, "Config heap %u failed a %u B request", thread_id, size );
+      ASSERT_F( irequest % 4 || (uintptr_t)ptr % ( 16 << ( irequest % 3 ) ) == 0, "Aligned block %p", ptr );
+      memset( ptr, (int)irequest, size );
+      ptrs.push_back( ptr );
+    }
+  }
+
+  // the table lookup matches the compile-time class
+  ASSERT_F( HeapCalcAllocPartitionAndSize( 100, k_HeapHintNone, quarter_thread ).m_Status == ( 112 | k_QuerySuccess ), "Runtime class differs from Config" );
+
+  printf( "-----------------------------State of the custom table heap---------------------\n" );
+  Heap::PrintStatus( custom_thread );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  for( size_t iptr = 0; iptr < ptrs.size(); iptr++ )
+  {
+    Heap::Free( ptrs[iptr], iptr % 3 == 0 ? pow2_thread : ( iptr % 3 == 1 ? quarter_thread : custom_thread ) );
+  }
+  Heap::Free( pow2_block, pow2_thread );
+  Heap::Free( quarter_block, quarter_thread );
+  for( uint32_t thread_id : { pow2_thread, quarter_thread, custom_thread } )
+  {
+    Heap::FlushCache( thread_id );
+  }
+
+  return 0;
+}
+
+static int32_t Test21()
+{
+  const uint32_t thread_id    = 3;
+  const uint32_t worker_count = 4;
+  const uint32_t alloc_count  = 20000;
+  printf( "\n *** Testing a heap shared by %u threads ( %u allocations each ) *** \n\n", worker_count, alloc_count );
+
+  for( uint32_t init_flags : { (uint32_t)Heap::k_InitShared, Heap::k_InitShared | Heap::k_InitSlab, Heap::k_InitShared | Heap::k_InitTreeTracker } )
+  {
+    Heap::InitBaseEx( 0x1 << 22, init_flags, thread_id );
+    Heap::SetPurgeDecay( 1, thread_id );
+
+    // blocks handed between the workers, released by whoever picks them up
+    std::mutex         exchange_lock;
+    std::vector<void*> exchange;
+
+    std::vector<std::thread> workers;
+    for( uint32_t iworker = 0; iworker < worker_count; iworker++ )
+    {
+      workers.emplace_back( [&, iworker]()
+      {
+        std::mt19937                             rng( iworker );
+        std::vector<std::pair<void*, uint32_t> > live;
+        for( uint32_t irequest = 0; irequest < alloc_count; ++irequest )
+        {
+          const uint32_t size = irequest % 500 == 0 ? 0x1 << 17 : 1 + rng() % 3000;
+          const uint8_t  tag  = (uint8_t)( iworker * 64 + irequest );
+
+          void* ptr = irequest % 7 ? Heap::Alloc( size, Heap::k_HintNone, 4, 0, thread_id ) : Heap::AllocAligned( size, 64, 0, thread_id );
+          ASSERT_F( ptr && Heap::UsableSize( ptr ) >= size, "Shared heap failed a %u B request", size );
+          memset( ptr, tag, size );
+          live.emplace_back( ptr, size );
+
+          if( irequest % 11 == 0 )
+          {
+            const size_t   pick  = rng() % live.size();
+            const uint32_t grown = live[pick].second + 1 + rng() % 2000;
+            const uint8_t  first = ( (uint8_t*)live[pick].first )[0];
+            live[pick].first     = Heap::Realloc( live[pick].first, grown, thread_id );
+            ASSERT_F( live[pick].first && ( (uint8_t*)live[pick].first )[0] == first, "Shared realloc lost its contents" );
+            memset( live[pick].first, first, grown );
+            live[pick].second = grown;
+          }
+
+          if( live.size() > 256 )
+          {
+            // check && drop half, some go to the other workers
+            for( size_t iptr = 0; iptr < live.size(); iptr += 2 )
+            {
+              const uint8_t* bytes = (const uint8_t*)live[iptr].first;
+              ASSERT_F( bytes[0] == bytes[live[iptr].second - 1], "Shared block corrupted" );
+              if( iptr % 8 == 0 )
+              {
+                std::lock_guard<std::mutex> guard( exchange_lock );
+                exchange.push_back( live[iptr].first );
+              }
+              else
+              {
+                Heap::Free( live[iptr].first, thread_id );
+              }
+              live[iptr].first = nullptr;
+            }
+            live.erase( std::remove_if( live.begin(), live.end(), []( const std::pair<void*, uint32_t>& entry ) { return entry.first == nullptr; } ), live.end() );
+
+            std::vector<void*> picked;
+            {
+              std::lock_guard<std::mutex> guard( exchange_lock );
+              picked.swap( exchange );
+            }
+            Heap::FreeBatch( picked.data(), (uint32_t)picked.size(), thread_id );
+
+            void*          batch[32];
+            const uint32_t batch_count = Heap::AllocBatch( 48, 32, batch, thread_id );
+            ASSERT_F( batch_count == 32, "Shared batch got %u of 32 blocks", batch_count );
+            for( uint32_t iptr = 0; iptr < batch_count; iptr++ )
+            {
+              memset( batch[iptr], tag, 48 );
+            }
+            Heap::FreeBatch( batch, batch_count, thread_id );
+          }
+        }
+
+        for( const std::pair<void*, uint32_t>& entry : live )
+        {
+          Heap::Free( entry.first, thread_id );
+        }
+      } );
+    }
+    for( std::thread& worker : workers )
+    {
+      worker.join();
+    }
+    Heap::FreeBatch( exchange.data(), (uint32_t)exchange.size(), thread_id );
+
+    Heap::FlushCache( thread_id );
+    Heap::Purge( thread_id );
+
+    // every bin is back in the base partitions
+    const HeapQueryResult result = Heap::CalcAllocPartitionAndSize( 2000, Heap::k_HintNone, thread_id );
+    ASSERT_F( result.m_Status & k_QuerySuccess, "Shared heap lost its free space" );
+  }
+
+  printf( "-----------------------------State after release--------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test22()
+{
+  const uint32_t thread_id     = 2;
+  const uint32_t request_count = 5000;
+  printf( "\n *** Testing linear arenas ( %u requests per frame ) *** \n\n", request_count );
+
+  Heap::InitBase( 0, thread_id );
+
+  Heap::LinearArena arena( 0x1 << 14, thread_id );
+
+  // a frame of small mixed requests grows the chunk chain, the next frame reuses it from the start
+  void* frame_start = nullptr;
+  for( uint32_t iframe = 0; iframe < 4; iframe++ )
+  {
+    std::vector<std::pair<uint8_t*, uint32_t> > blocks;
+    for( uint32_t irequest = 0; irequest < request_count; ++irequest )
+    {
+      const uint32_t size      = 1 + (uint32_t)rand() % 200;
+      const uint32_t alignment = 8 << ( irequest % 4 );
+
+      uint8_t* data = (uint8_t*)arena.Alloc( size, alignment );
+      ASSERT_F( data && (uintptr_t)data % alignment == 0, "Arena block %p not %u B aligned", (void*)data, alignment );
+      memset( data, (int)irequest, size );
+      blocks.emplace_back( data, size );
+    }
+    for( uint32_t irequest = 0; irequest < request_count; ++irequest )
+    {
+      ASSERT_F( blocks[irequest].first[blocks[irequest].second - 1] == (uint8_t)irequest, "Arena block %u overlaps another", irequest );
+    }
+
+    ASSERT_F( iframe == 0 || blocks[0].first == frame_start, "Reset arena didn't start over" );
+    frame_start = blocks[0].first;
+    arena.Reset();
+  }
+
+  // rollback drops everything after the marker, chunks past it are picked up again
+  arena.Alloc( 100 );
+  const Heap::LinearArena::Marker marker = arena.GetMarker();
+  uint64_t* first = arena.AllocT<uint64_t>( 4 );
+  arena.Alloc( 0x1 << 15 ); // larger than a chunk
+  arena.Rollback( marker );
+  ASSERT_F( arena.AllocT<uint64_t>( 4 ) == first, "Rollback didn't rewind the arena" );
+
+  // default sized chunks come from the heap's partitions, not from large mappings
+  HeapStats stats;
+  Heap::GetStats( &stats, thread_id );
+  const uint64_t large_allocs = stats.m_Large.m_Allocs;
+  {
+    Heap::LinearArena default_arena( HEAP_ARENA_CHUNK_SIZE, thread_id );
+    default_arena.Alloc( 100 );
+    default_arena.Alloc( HEAP_ARENA_CHUNK_SIZE / 2 );
+  }
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( stats.m_Large.m_Allocs == large_allocs, "Arena chunks were mapped as large blocks" );
+
+  printf( "-----------------------------State w/ the arena chunks--------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test23()
+{
+  const uint32_t thread_id     = 4;
+  const uint32_t element_count = 100000;
+  printf( "\n *** Testing container adapters ( %u elements ) *** \n\n", element_count );
+
+  Heap::InitBaseEx( 0, Heap::k_InitSlab, thread_id );
+
+  struct alignas( 64 ) Line
+  {
+    uint32_t m_Values[16];
+  };
+
+  {
+    const Heap::StlAllocator<uint32_t> allocator( thread_id );
+
+    std::vector<uint32_t, Heap::StlAllocator<uint32_t> > values( allocator );
+    std::vector<Line, Heap::StlAllocator<Line> >         lines( allocator );
+    for( uint32_t ivalue = 0; ivalue < element_count; ivalue++ )
+    {
+      values.push_back( ivalue );
+      if( ivalue % 16 == 0 )
+      {
+        lines.push_back( Line{ { ivalue } } );
+        ASSERT_F( (uintptr_t)lines.data() % alignof( Line ) == 0, "Container storage not %u B aligned", (uint32_t)alignof( Line ) );
+      }
+    }
+
+    // node based container, every node is a small block
+    std::unordered_map<uint32_t, uint32_t, std::hash<uint32_t>, std::equal_to<uint32_t>, Heap::StlAllocator<std::pair<const uint32_t, uint32_t> > > map( 16, std::hash<uint32_t>(), std::equal_to<uint32_t>(), allocator );
+    for( uint32_t ivalue = 0; ivalue < element_count; ivalue++ )
+    {
+      map[ivalue] = values[ivalue] * 2;
+    }
+    for( uint32_t ivalue = 0; ivalue < element_count; ivalue += 7 )
+    {
+      map.erase( ivalue );
+    }
+    for( uint32_t ivalue = 0; ivalue < element_count; ivalue++ )
+    {
+      ASSERT_F( ivalue % 7 == 0 ? map.count( ivalue ) == 0 : map[ivalue] == ivalue * 2, "Map value %u lost", ivalue );
+    }
+    ASSERT_F( lines.back().m_Values[0] == ( element_count - 1 ) / 16 * 16, "Aligned vector lost its contents" );
+
+    printf( "-----------------------------State w/ the containers----------------------------\n" );
+    Heap::PrintStatus( thread_id );
+    printf( "--------------------------------------------------------------------------------\n" );
+  }
+
+#ifdef HEAP_MEMORY_RESOURCE
+  {
+    Heap::MemoryResource                resource( thread_id );
+    std::pmr::unsynchronized_pool_resource pool( &resource );
+
+    std::pmr::vector<std::pmr::vector<uint32_t> > nested( &pool );
+    for( uint32_t ivalue = 0; ivalue < element_count / 100; ivalue++ )
+    {
+      nested.emplace_back( ivalue % 50 + 1, ivalue );
+    }
+    for( uint32_t ivalue = 0; ivalue < element_count / 100; ivalue++ )
+    {
+      ASSERT_F( nested[ivalue].back() == ivalue, "pmr vector %u lost its contents", ivalue );
+    }
+
+    void* aligned = resource.allocate( 100, 256 );
+    ASSERT_F( (uintptr_t)aligned % 256 == 0, "Resource block %p not 256 B aligned", aligned );
+    resource.deallocate( aligned, 100, 256 );
+  }
+#endif // HEAP_MEMORY_RESOURCE
+
+  Heap::FlushCache( thread_id );
+
+  return 0;
+}
+
+static uint32_t s_PoolAlive;
+
+static int32_t Test24()
+{
+  const uint32_t thread_id    = 6;
+  const uint32_t object_count = 100000;
+  printf( "\n *** Testing object pools ( %u objects ) *** \n\n", object_count );
+
+  Heap::InitBase( 0, thread_id );
+
+  struct Node
+  {
+    Node( uint32_t value ) : m_Value( value )
+    {
+      if( value == UINT32_MAX )
+      {
+        throw value;
+      }
+      s_PoolAlive++;
+    }
+    ~Node() { s_PoolAlive--; }
+    uint64_t m_Value;
+    Node*    m_Next = nullptr;
+  };
+
+  struct alignas( 32 ) Vec
+  {
+    float m_Values[5];
+  };
+
+  s_PoolAlive = 0;
+  {
+    Heap::ObjectPool<Node> nodes( 1024, thread_id );
+    Heap::ObjectPool<Vec>  vecs( 64, thread_id );
+
+    std::vector<Node*> live;
+    for( uint32_t iobj = 0; iobj < object_count; iobj++ )
+    {
+      live.push_back( nodes.Create( iobj ) );
+      ASSERT_F( live.back() && live.back()->m_Value == iobj, "Pool object %u not constructed", iobj );
+
+      Vec* vec = vecs.Create();
+      ASSERT_F( (uintptr_t)vec % alignof( Vec ) == 0, "Pool slot %p not %u B aligned", (void*)vec, (uint32_t)alignof( Vec ) );
+      vecs.Destroy( vec );
+    }
+
+    // the last slot freed is handed out next
+    Node* reused = live[object_count / 2];
+    nodes.Destroy( reused );
+    ASSERT_F( nodes.Create( 7u ) == reused, "Pool didn't reuse the freed slot" );
+
+    // a throwing constructor hands its slot back
+    nodes.Destroy( reused );
+    try
+    {
+      nodes.Create( UINT32_MAX );
+    }
+    catch( uint32_t )
+    {
+    }
+    ASSERT_F( s_PoolAlive == nodes.LiveCount(), "Pool counts %" PRIu64 " objects, %u alive", nodes.LiveCount(), s_PoolAlive );
+    ASSERT_F( nodes.Create( 7u ) == reused, "Throwing constructor lost its slot" );
+
+    for( uint32_t iobj = 0; iobj < object_count; iobj += 3 )
+    {
+      ASSERT_F( live[iobj]->m_Value == ( iobj == object_count / 2 ? 7 : iobj ), "Pool object %u overwritten", iobj );
+      nodes.Destroy( live[iobj] );
+    }
+    ASSERT_F( s_PoolAlive == nodes.LiveCount(), "Pool lost track of %u objects", s_PoolAlive );
+
+    // every object left goes away in one pass
+    nodes.Clear();
+    ASSERT_F( s_PoolAlive == 0, "Clear left %u objects alive", s_PoolAlive );
+
+    for( uint32_t iobj = 0; iobj < 100; iobj++ )
+    {
+      nodes.Create( iobj );
+    }
+  }
+  ASSERT_F( s_PoolAlive == 0, "Pool destructor left %u objects alive", s_PoolAlive );
+
+  printf( "-----------------------------State after the pools------------------------------\n" );
+  Heap::PrintStatus( thread_id );
+  printf( "--------------------------------------------------------------------------------\n" );
+
+  return 0;
+}
+
+static int32_t Test25()
+{
+  const uint32_t thread_id  = 5;
+  const char*    trace_path = "memalloc_test.trace";
+  printf( "\n *** Testing allocation traces *** \n\n" );
+
+  Heap::InitBase( 0, thread_id );
+
+  const bool started = Heap::TraceStart( trace_path );
+#ifdef HEAP_TRACE
+  ASSERT_F( started, "Couldn't start a trace in %s", trace_path );
+
+  void* block   = Heap::Alloc( 100, Heap::k_HintNone, 0, 0x1234, thread_id );
+  void* aligned = Heap::AllocAligned( 200, 64, 0, thread_id );
+  void* moved   = Heap::Realloc( block, 50000, thread_id );
+  Heap::Free( aligned, thread_id );
+  Heap::FreeSized( moved, 50000, thread_id );
+  Heap::TraceStop();
+
+  // nothing gets recorded once the trace stops
+  Heap::Free( Heap::Alloc( 100, Heap::k_HintNone, 0, 0, thread_id ), thread_id );
+
+  FILE* trace_file = fopen( trace_path, "rb" );
+  ASSERT_F( trace_file, "Trace %s wasn't written", trace_path );
+
+  HeapTraceHeader header     = {};
+  HeapTraceRecord records[6] = {};
+  const size_t    read_count = fread( &header, sizeof( header ), 1, trace_file ) ? fread( records, sizeof( HeapTraceRecord ), 6, trace_file ) : 0;
+  fclose( trace_file );
+  remove( trace_path );
+
+  ASSERT_F( header.m_Magic == k_HeapTraceMagic && header.m_RecordSize == sizeof( HeapTraceRecord ), "Bad trace header" );
+  ASSERT_F( read_count == 5, "Trace holds %u records instead of 5", (uint32_t)read_count );
+
+  const uint8_t  ops[]   = { k_HeapTraceAlloc, k_HeapTraceAllocAligned, k_HeapTraceRealloc, k_HeapTraceRelease, k_HeapTraceRelease };
+  const void*    ptrs[]  = { block, aligned, moved, aligned, moved };
+  const uint64_t sizes[] = { 100, 200, 50000, 0, 50000 };
+  for( uint32_t irecord = 0; irecord < 5; irecord++ )
+  {
+    ASSERT_F( records[irecord].m_Op == ops[irecord] && records[irecord].m_Ptr == (uintptr_t)ptrs[irecord] && records[irecord].m_Size == sizes[irecord], "Record %u doesn't match its request", irecord );
+    ASSERT_F( records[irecord].m_ThreadId == thread_id, "Record %u went to heap %u", irecord, records[irecord].m_ThreadId );
+    ASSERT_F( irecord == 0 || records[irecord].m_TimeNs >= records[irecord - 1].m_TimeNs, "Record %u out of order", irecord );
+  }
+  ASSERT_F( records[0].m_Extra == 0x1234 && records[1].m_Hints == 64 && records[2].m_Extra == (uintptr_t)block, "Record details lost" );
+
+  printf( "Recorded %u requests\n", (uint32_t)read_count );
+#else
+  ASSERT_F( !started, "Trace started w/o HEAP_TRACE" );
+  (void)started;
+
+  printf( "Built w/o HEAP_TRACE, nothing recorded\n" );
+#endif // HEAP_TRACE
+
+  return 0;
+}
+
+static int32_t Test26()
+{
+  const uint32_t thread_id = 7;
+  printf( "\n *** Testing heap stats *** \n\n" );
+
+  Heap::InitBaseEx( 0x1 << 22, Heap::k_InitFixedSize, thread_id );
+
+  HeapStats stats;
+  Heap::GetStats( &stats, thread_id );
+
+  const HeapPartitionStats& level = stats.m_Levels[0];
+  const uint64_t            total = level.m_FreeBytes;
+  ASSERT_F( level.m_Allocs == 0 && level.m_LiveBytes == 0 && level.m_FreeExtentCount == 1 && level.m_LargestFreeExtent <= total, "Fresh level isn't one free extent" );
+
+  // fill the 32 B level, the last request finds it out of bins
+  std::vector<void*> blocks;
+  for( void* block; ( block = Heap::Alloc( 16, Heap::k_HintNone, 4, 0, thread_id ) ) != nullptr; )
+  {
+    blocks.push_back( block );
+  }
+  Heap::GetStats( &stats, thread_id );
+
+  const uint64_t block_count = blocks.size();
+  ASSERT_F( level.m_Allocs == block_count && level.m_LiveBytes == block_count * level.m_BinSize && level.m_PeakBytes == level.m_LiveBytes, "Level counted %" PRIu64 " allocations of %" PRIu64, level.m_Allocs, block_count );
+  ASSERT_F( level.m_FailedNoFreeSpace == 1 && level.m_FailedFragmentation == 0 && level.m_FreeBytes == 0, "Full level not reported" );
+
+  // every other block goes back, no two free bins touch
+  std::sort( blocks.begin(), blocks.end() );
+  for( uint64_t iblock = 0; iblock < block_count; iblock += 2 )
+  {
+    Heap::Free( blocks[iblock], thread_id );
+  }
+
+  // two bins of the level can't be found anywhere
+  ASSERT_F( HeapAllocateLevel( 40, 0, 0, thread_id ) == nullptr, "Fragmented level served a 2 bin block" );
+  Heap::GetStats( &stats, thread_id );
+
+  const uint64_t freed_count = ( block_count + 1 ) / 2;
+  ASSERT_F( level.m_Frees == freed_count && level.m_FreeExtentCount == freed_count && level.m_LargestFreeExtent == level.m_BinSize, "Level has %" PRIu64 " free extents of up to %" PRIu64 " B", level.m_FreeExtentCount, level.m_LargestFreeExtent );
+  ASSERT_F( level.m_FailedFragmentation == 1 && level.m_LiveBytes + level.m_FreeBytes == total, "Fragmented level not reported" );
+
+  for( uint64_t iblock = 1; iblock < block_count; iblock += 2 )
+  {
+    Heap::Free( blocks[iblock], thread_id );
+  }
+
+  // large blocks are counted on their own, released mappings show as free extents
+  Heap::Free( Heap::Alloc( 0x1 << 20, Heap::k_HintNone, 4, 0, thread_id ), thread_id );
+  Heap::GetStats( &stats, thread_id );
+
+  ASSERT_F( level.m_Frees == block_count && level.m_LiveBytes == 0 && level.m_FreeBytes == total && level.m_PeakBytes == block_count * level.m_BinSize, "Released level keeps %" PRIu64 " live bytes", level.m_LiveBytes );
+  ASSERT_F( stats.m_Large.m_Allocs == 1 && stats.m_Large.m_Frees == 1 && stats.m_Large.m_LiveBytes == 0 && stats.m_Large.m_PeakBytes >= ( 0x1 << 20 ), "Large block not counted" );
+  ASSERT_F( stats.m_Large.m_FreeExtentCount == 1 && stats.m_Large.m_LargestFreeExtent == stats.m_Large.m_PeakBytes, "Cached large region not reported" );
+
+  // a region taken back out of the cache no longer counts
+  const uint64_t small_region = stats.m_Large.m_LargestFreeExtent;
+  Heap::Free( Heap::Alloc( 0x1 << 21, Heap::k_HintNone, 4, 0, thread_id ), thread_id );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( stats.m_Large.m_FreeExtentCount == 2 && stats.m_Large.m_LargestFreeExtent > small_region, "2nd cached large region not reported" );
+
+  void* reused = Heap::Alloc( 0x1 << 21, Heap::k_HintNone, 4, 0, thread_id );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( stats.m_Large.m_FreeExtentCount == 1 && stats.m_Large.m_LargestFreeExtent == small_region, "Reused large region still reported ( %" PRIu64 " B )", stats.m_Large.m_LargestFreeExtent );
+  Heap::Free( reused, thread_id );
+
+  printf( "Level 0 : %" PRIu64 " allocs, %" PRIu64 " frees, %" PRIu64 " B peak, %" PRIu64 " B free in %" PRIu64 " extents\n", level.m_Allocs, level.m_Frees, level.m_PeakBytes, level.m_FreeBytes, level.m_FreeExtentCount );
+
+  return 0;
+}
+
+static int32_t Test27()
+{
+  const uint32_t thread_id = 1;
+  printf( "\n *** Testing the free extent index *** \n\n" );
+
+  const uint32_t init_flags[] = { Heap::k_InitFixedSize, Heap::k_InitFixedSize | Heap::k_InitTreeTracker };
+  for( uint32_t init : init_flags )
+  {
+    Heap::InitBaseEx( 0x1 << 22, init, thread_id );
+    Heap::SetCacheLimit( 0, 0, thread_id ); // single bin blocks go straight back to the index
+
+    // n bins of the 32 B level hold n * bin - header bytes
+    const uint64_t bin_size    = Heap::CalcAllocPartitionAndSize( 1, Heap::k_HintStrictSize | Heap::k_Level0, thread_id ).m_Status & ~0x7u;
+    const uint64_t header_size = sizeof( HeapBlockHeader );
+    const uint64_t bin_bytes   = bin_size + header_size;
+
+    std::vector<void*> blocks;
+    for( void* block; ( block = HeapAllocateLevel( 1, 0, 0, thread_id ) ) != nullptr; )
+    {
+      blocks.push_back( block );
+    }
+    std::sort( blocks.begin(), blocks.end() );
+
+    // free runs of 1, 2, 3, 5 && 7 bins w/ a live block between them, one run of 20 in the middle
+    const uint32_t    run_lengths[] = { 1, 2, 3, 5, 7 };
+    std::vector<bool> freed( blocks.size(), false );
+    uint64_t          free_bins = 0;
+    uint64_t          long_run  = 0;
+    for( uint64_t iblock = 1, irun = 0; iblock < blocks.size(); irun++ )
+    {
+      uint64_t run_length = run_lengths[irun % 5];
+      if( long_run == 0 && iblock > blocks.size() / 2 )
+      {
+        run_length = 20;
+        long_run   = iblock;
+      }
+      for( uint64_t ibin = 0; ibin < run_length && iblock < blocks.size(); ibin++, iblock++ )
+      {
+        Heap::Free( blocks[iblock], thread_id );
+        freed[iblock] = true;
+        free_bins++;
+      }
+      iblock++; // separator stays live
+    }
+    ASSERT_F( long_run && free_bins > 21, "Level too small for the free pattern : %" PRIu64 " bins", free_bins );
+
+    // every request up to the longest run fits in one of the freed runs
+    for( uint64_t bin_count = 1; bin_count <= 21; bin_count++ )
+    {
+      const uint64_t         byte_size = bin_count * bin_bytes - header_size;
+      const HeapQueryResult  result    = Heap::CalcAllocPartitionAndSize( (uint32_t)byte_size, Heap::k_HintStrictSize | Heap::k_Level0, thread_id );
+      ASSERT_F( result.m_AllocBins == bin_count, "Query of %" PRIu64 " B took %" PRIu64 " bins", byte_size, result.m_AllocBins );
+
+      if( bin_count > 20 )
+      {
+        ASSERT_F( ( result.m_Status & k_QueryExcessFragmentation ) && !( result.m_Status & k_QuerySuccess ), "Run of %" PRIu64 " bins found in a level w/ runs of 20", bin_count );
+        ASSERT_F( HeapAllocateLevel( byte_size, 0, 0, thread_id ) == nullptr, "Fragmented level served %" PRIu64 " bins", bin_count );
+        continue;
+      }
+      ASSERT_F( result.m_Status & k_QuerySuccess, "No extent found for %" PRIu64 " bins", bin_count );
+
+      void*          block    = HeapAllocateLevel( byte_size, 0, 0, thread_id );
+      const uint64_t position = std::lower_bound( blocks.begin(), blocks.end(), block ) - blocks.begin();
+      ASSERT_F( position + bin_count <= blocks.size() && blocks[position] == block, "%" PRIu64 " bins placed outside the freed runs", bin_count );
+      for( uint64_t ibin = position; ibin < position + bin_count; ibin++ )
+      {
+        ASSERT_F( freed[ibin], "%" PRIu64 " bin block overlaps live block %" PRIu64, bin_count, ibin );
+      }
+      Heap::Free( block, thread_id );
+    }
+
+    // releasing the separator merges the long run w/ the one after it
+    const uint64_t separator = long_run + 20;
+    uint64_t       merged    = 21;
+    while( separator + merged - 20 < freed.size() && freed[separator + merged - 20] )
+    {
+      merged++;
+    }
+    Heap::Free( blocks[separator], thread_id );
+    freed[separator] = true;
+
+    const HeapQueryResult result = Heap::CalcAllocPartitionAndSize( (uint32_t)( merged * bin_bytes - header_size ), Heap::k_HintStrictSize | Heap::k_Level0, thread_id );
+    ASSERT_F( result.m_Status & k_QuerySuccess, "Merged run of %" PRIu64 " bins not indexed", merged );
+    ASSERT_F( HeapAllocateLevel( merged * bin_bytes - header_size, 0, 0, thread_id ) == blocks[long_run], "Merged run not served from its start" );
+
+    printf( "%s tracker : %" PRIu64 " free bins, runs of up to %" PRIu64 " bins after merging\n", init & Heap::k_InitTreeTracker ? "Tree" : "Array", free_bins, merged );
+  }
+
+  return 0;
+}
+
+static int32_t Test28()
+{
+  const uint32_t thread_id  = 2;
+  const uint32_t high_water = 8;
+  printf( "\n *** Testing the thread cache *** \n\n" );
+
+  Heap::InitBaseEx( 0x1 << 22, Heap::k_InitFixedSize, thread_id );
+
+  // cached blocks show up as free extents of their own, released bins merge back into the level
+  HeapStats stats;
+  Heap::GetStats( &stats, thread_id );
+
+  const HeapPartitionStats& level = stats.m_Levels[0];
+  const uint64_t            total = level.m_FreeBytes;
+
+  // a limit of 0 sends every block straight to the tracker
+  Heap::SetCacheLimit( 0, 0, thread_id );
+  void* block = Heap::Alloc( 16, Heap::k_HintNone, 4, 0, thread_id );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( level.m_FreeExtentCount == 1, "Uncached level refilled a cache ( %" PRIu64 " extents )", level.m_FreeExtentCount );
+
+  Heap::Free( block, thread_id );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( level.m_FreeExtentCount == 1 && level.m_FreeBytes == total, "Uncached block didn't go back to the tracker" );
+
+  // 16 blocks take the front of the level in refills of high_water / 2 bins
+  Heap::SetCacheLimit( 0, high_water, thread_id );
+
+  std::vector<void*> blocks;
+  for( uint32_t iblock = 0; iblock < 2 * high_water; iblock++ )
+  {
+    blocks.push_back( Heap::Alloc( 16, Heap::k_HintNone, 4, 0, thread_id ) );
+  }
+  std::sort( blocks.begin(), blocks.end() );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( level.m_FreeExtentCount == 1, "Refills left %" PRIu64 " blocks cached", level.m_FreeExtentCount - 1 );
+
+  // the last block released is the next one handed out
+  Heap::Free( blocks[0], thread_id );
+  ASSERT_F( Heap::Alloc( 16, Heap::k_HintNone, 4, 0, thread_id ) == blocks[0], "Cached block wasn't reused" );
+
+  // past the high water mark the older half is flushed, the tracker merges it w/ the free tail of the level
+  for( uint32_t iblock = 2 * high_water; iblock > 0; iblock-- )
+  {
+    Heap::Free( blocks[iblock - 1], thread_id );
+  }
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( level.m_FreeExtentCount == 1 + high_water && level.m_LiveBytes == 0 && level.m_FreeBytes == total, "Cache holds %" PRIu64 " blocks past its high water mark of %u", level.m_FreeExtentCount - 1, high_water );
+  ASSERT_F( Heap::Alloc( 16, Heap::k_HintNone, 4, 0, thread_id ) == blocks[0], "Cache didn't keep the newest blocks" );
+  Heap::Free( blocks[0], thread_id );
+
+  // flushing returns every cached bin
+  Heap::FlushCache( thread_id );
+  Heap::GetStats( &stats, thread_id );
+  ASSERT_F( level.m_FreeExtentCount == 1 && level.m_FreeBytes == total, "Flush left %" PRIu64 " blocks cached", level.m_FreeExtentCount - 1 );
+
+  printf( "Level 0 : %" PRIu64 " allocs, %" PRIu64 " frees, %" PRIu64 " B free in %" PRIu64 " extent\n", level.m_Allocs, level.m_Frees, level.m_FreeBytes, level.m_FreeExtentCount );
+
+  return 0;
+}
+
+static int32_t Test29()
+{
+  const uint32_t thread_count = 1024; // far past the 64 ids of a registry chunk
+  const uint32_t wave_size    = 8;
+  printf( "\n *** Testing heap reuse across exiting threads ( %u threads ) *** \n\n", thread_count );
+
+  std::vector<uint32_t> thread_ids( thread_count + 2 * wave_size );
+  std::vector<void*>    kept_blocks;
+  std::mutex            kept_lock;
+
+  // the last thread of a wave hands its blocks to the main thread, its heap is adopted by a later thread
+  auto run_thread = [&]( uint32_t ithread, bool keep_blocks )
+  {
+    void* small = Heap::Alloc( 48, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto );
+    void* large = Heap::Alloc( 0x1 << 20, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto );
+    ASSERT_F( small && large, "Thread %u got no blocks", ithread );
+
+    thread_ids[ithread] = Heap::GetThreadId();
+    if( keep_blocks )
+    {
+      std::lock_guard<std::mutex> lock( kept_lock );
+      kept_blocks.push_back( small );
+      kept_blocks.push_back( large );
+      return;
+    }
+    Heap::Free( small, Heap::k_ThreadAuto );
+    Heap::Free( large, Heap::k_ThreadAuto );
+  };
+
+  for( uint32_t ithread = 0; ithread < thread_count; ithread += wave_size )
+  {
+    std::vector<std::thread> threads;
+    for( uint32_t iwave = 0; iwave < wave_size; iwave++ )
+    {
+      threads.emplace_back( run_thread, ithread + iwave, iwave == wave_size - 1 );
+    }
+    for( std::thread& thread : threads )
+    {
+      thread.join();
+    }
+  }
+
+  // releases queue up on the parked heaps, the threads adopting them drain them && release them on exit
+  std::thread releaser( [&]()
+  {
+    for( void* block : kept_blocks )
+    {
+      const bool released = Heap::Free( block, Heap::k_ThreadAuto );
+      ASSERT_F( released, "Block of an exited thread not released" );
+      (void)released;
+    }
+  } );
+  releaser.join();
+
+  std::vector<std::thread> threads;
+  for( uint32_t ithread = thread_count; ithread < thread_count + 2 * wave_size; ithread++ )
+  {
+    threads.emplace_back( run_thread, ithread, false );
+  }
+  for( std::thread& thread : threads )
+  {
+    thread.join();
+  }
+
+  std::vector<uint32_t> used_ids( thread_ids );
+  std::sort( used_ids.begin(), used_ids.end() );
+  used_ids.erase( std::unique( used_ids.begin(), used_ids.end() ), used_ids.end() );
+
+  ASSERT_F( used_ids.back() < 64, "%u threads took heap ids up to %u", thread_count, used_ids.back() );
+  for( uint32_t thread_id : used_ids )
+  {
+    ASSERT_F( !Heap::QueryBaseValidity( thread_id ), "Heap %u outlived its thread", thread_id );
+  }
+
+  printf( "%u threads shared %u heaps ( ids %u - %u ), every one released\n", (uint32_t)thread_ids.size(), (uint32_t)used_ids.size(), used_ids.front(), used_ids.back() );
+
+  return 0;
+}
+
+static int32_t Test30()
+{
+  const uint32_t thread_id = 3;
+  printf( "\n *** Testing heap init out of memory *** \n\n" );
+
+  // a petabyte of partitions is past any address space : the heap stays invalid && hands out nothing
+  HeapConfig config = {};
+  config.m_LevelCount     = 1;
+  config.m_LevelSizes[0]  = 0x1 << 28;
+  config.m_LevelShares[0] = 1;
+  HeapInitBaseConfig( (uint64_t)0x1 << 50, Heap::k_InitNone, &config, thread_id );
+
+  void* blocks[4];
+  ASSERT_F( !Heap::QueryBaseValidity( thread_id ), "Heap valid w/o its reservation" );
+  ASSERT_F( Heap::Alloc( 64, Heap::k_HintNone, 4, 0, thread_id ) == NULL, "Invalid heap handed out a block" );
+  ASSERT_F( Heap::AllocAligned( 64, 64, 0, thread_id ) == NULL, "Invalid heap handed out an aligned block" );
+  ASSERT_F( Heap::AllocBatch( 64, 4, blocks, thread_id ) == 0, "Invalid heap handed out a batch" );
+
+  // the next init starts over
+  Heap::InitBase( 0x1 << 20, thread_id );
+  void* block = Heap::Alloc( 64, Heap::k_HintNone, 4, 0, thread_id );
+  ASSERT_F( Heap::QueryBaseValidity( thread_id ) && block, "Heap didn't recover from a failed init" );
+  Heap::Free( block, thread_id );
+
+  printf( "Failed init returned NULL, re-init recovered\n" );
+
+  return 0;
+}
+
+static int32_t Test31()
+{
+  const uint32_t thread_id = 4;
+  printf( "\n *** Testing 16 B aligned levels *** \n\n" );
+
+  // multiples of 16 B, as are the block headers
+  HeapConfig config = {};
+  config.m_LevelSizes[config.m_LevelCount++] = 32;
+  config.m_LevelSizes[config.m_LevelCount++] = 48;
+  for( uint32_t level_size = 64; level_size < ( 0x1 << 12 ); level_size *= 2 )
+  {
+    config.m_LevelSizes[config.m_LevelCount++] = level_size;
+  }
+  for( uint32_t ilvl = 0; ilvl < config.m_LevelCount; ilvl++ )
+  {
+    config.m_LevelShares[ilvl] = 1;
+  }
+
+  const uint32_t init_flags[] = { Heap::k_InitNone, Heap::k_InitSlab };
+  for( uint32_t flags : init_flags )
+  {
+    // a small heap, so the runs below spill into segments
+    HeapInitBaseConfig( 0x1 << 18, flags, &config, thread_id );
+
+    std::vector<void*> blocks;
+    for( uint32_t byte_size = 1; byte_size < ( 0x1 << 13 ); byte_size = byte_size * 3 / 2 + 1 )
+    {
+      for( uint32_t iblock = 0; iblock < 256; iblock++ )
+      {
+        blocks.push_back( Heap::Alloc( byte_size, Heap::k_HintNone, 4, 0, thread_id ) );
+        ASSERT_F( blocks.back() && (uintptr_t)blocks.back() % 16 == 0, "%u B block at %p isn't 16 B aligned", byte_size, blocks.back() );
+      }
+    }
+    blocks.push_back( Heap::Alloc( 0x1 << 17, Heap::k_HintNone, 4, 0, thread_id ) );
+    ASSERT_F( blocks.back() && (uintptr_t)blocks.back() % 16 == 0, "Large block at %p isn't 16 B aligned", blocks.back() );
+
+    for( void* block : blocks )
+    {
+      Heap::Free( block, thread_id );
+    }
+  }
+
+  // heaps created on first use take the table too
+  Heap::SetAutoConfig( &config );
+  uintptr_t auto_block = 0;
+  std::thread( [&auto_block]()
+  {
+    void* block = Heap::Alloc( 100, Heap::k_HintNone, 4, 0, Heap::k_ThreadAuto );
+    auto_block  = (uintptr_t)block;
+    Heap::Free( block, Heap::k_ThreadAuto );
+  } ).join();
+  Heap::SetAutoConfig( nullptr );
+  ASSERT_F( auto_block && auto_block % 16 == 0, "Auto heap block at %p isn't 16 B aligned", (void*)auto_block );
+
+  printf( "Blocks of every level, segment && large block were 16 B aligned\n" );
+
+  return 0;
+}